@@ -0,0 +1,544 @@
+#include "binlog.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <algorithm>
+
+namespace lch {
+
+const char BinLog::MAGIC[8] = {'L', 'C', 'H', 'B', 'L', 'O', 'G', 1};
+
+//缓冲区超过这个大小就写文件
+static const size_t s_binlog_flush_size = 64 * 1024;
+
+template<class T>
+static void BinPut(std::string& buf, T v) {
+    buf.append((const char*)&v, sizeof(v));
+}
+
+static void BinPutString(std::string& buf, const char* s, size_t len) {
+    BinPut(buf, (uint32_t)len);
+    buf.append(s, len);
+}
+
+/*******************************BinLogArgs*********************************/
+namespace {
+
+struct BinLogArg {
+    char type = 0;
+    int64_t i = 0;
+    uint64_t u = 0;
+    double d = 0;
+    //字符串指向编码数据，不拷贝
+    const char* s = nullptr;
+    uint32_t sLen = 0;
+
+    int64_t asInt() const {
+        return type == BinLogArgs::DOUBLE ? (int64_t)d : (type == BinLogArgs::INT ? i : (int64_t)u);
+    }
+    uint64_t asUint() const {
+        return type == BinLogArgs::DOUBLE ? (uint64_t)d : (type == BinLogArgs::INT ? (uint64_t)i : u);
+    }
+    double asDouble() const {
+        return type == BinLogArgs::DOUBLE ? d : (type == BinLogArgs::INT ? (double)i : (double)u);
+    }
+};
+
+class BinLogArgReader {
+public:
+    BinLogArgReader(const char* data, size_t len)
+        :m_cur(data)
+        ,m_end(data + len) {
+    }
+
+    bool next(BinLogArg& arg) {
+        if (m_cur >= m_end) {
+            return false;
+        }
+        arg.type = *m_cur++;
+        switch (arg.type) {
+            case BinLogArgs::INT:
+                return read(arg.i);
+            case BinLogArgs::UINT:
+            case BinLogArgs::POINTER:
+                return read(arg.u);
+            case BinLogArgs::DOUBLE:
+                return read(arg.d);
+            case BinLogArgs::STRING: {
+                uint32_t len = 0;
+                if (!read(len) || (size_t)(m_end - m_cur) < len) {
+                    m_cur = m_end;
+                    return false;
+                }
+                arg.s = m_cur;
+                arg.sLen = len;
+                m_cur += len;
+                return true;
+            }
+            default:
+                m_cur = m_end;
+                return false;
+        }
+    }
+private:
+    template<class T>
+    bool read(T& v) {
+        if ((size_t)(m_end - m_cur) < sizeof(T)) {
+            m_cur = m_end;
+            return false;
+        }
+        memcpy(&v, m_cur, sizeof(T));
+        m_cur += sizeof(T);
+        return true;
+    }
+private:
+    const char* m_cur;
+    const char* m_end;
+};
+
+//解码输出到std::string
+struct StringSink {
+    std::string& out;
+
+    void append(const char* p, size_t n) { out.append(p, n); }
+    void push_back(char c) { out.push_back(c); }
+
+    template<class... Args>
+    void format(const char* spec, Args... args) {
+        char buf[128];
+        int n = snprintf(buf, sizeof(buf), spec, args...);
+        if (n < 0) {
+            return;
+        }
+        if ((size_t)n < sizeof(buf)) {
+            out.append(buf, n);
+            return;
+        }
+        std::vector<char> big(n + 1);
+        snprintf(&big[0], big.size(), spec, args...);
+        out.append(&big[0], n);
+    }
+};
+
+//解码输出到定长缓冲区，写满后截断，不分配内存
+struct BufferSink {
+    char* buf;
+    size_t size;
+    size_t len;
+
+    void append(const char* p, size_t n) {
+        n = std::min(n, size - len);
+        memcpy(buf + len, p, n);
+        len += n;
+    }
+    void push_back(char c) { append(&c, 1); }
+
+    template<class... Args>
+    void format(const char* spec, Args... args) {
+        size_t room = size - len;
+        char tmp[128];
+        int n = snprintf(tmp, sizeof(tmp), spec, args...);
+        if (n <= 0) {
+            return;
+        }
+        if ((size_t)n < sizeof(tmp) || room < sizeof(tmp)) {
+            append(tmp, std::min<size_t>(n, sizeof(tmp) - 1));
+            return;
+        }
+        //比临时缓冲区长，直接写进剩余空间，snprintf要留一个字节给'\0'
+        n = snprintf(buf + len, room, spec, args...);
+        len += std::min<size_t>(n, room - 1);
+    }
+};
+
+//按printf格式串把编码的参数还原成文本
+template<class Sink>
+static void DecodeTo(Sink& out, const char* fmt, const char* data, size_t len) {
+    BinLogArgReader reader(data, len);
+    BinLogArg arg;
+    //重新拼出的转换说明，flags和宽度、精度都有上限，超出的部分忽略
+    char spec[64];
+    char conv_spec[72];
+    for (const char* p = fmt; *p; ++p) {
+        if (*p != '%') {
+            out.push_back(*p);
+            continue;
+        }
+        if (p[1] == '%') {
+            out.push_back('%');
+            ++p;
+            continue;
+        }
+        size_t n = 0;
+        spec[n++] = '%';
+        ++p;
+        while (*p && strchr("-+ #0'", *p)) {
+            if (n < 16) {
+                spec[n++] = *p;
+            }
+            ++p;
+        }
+        //精度在spec中开始的位置，字符串参数按长度限制精度时替换掉
+        size_t prec_pos = 0;
+        int prec = -1;
+        for (int part = 0; part < 2; ++part) {
+            if (part == 1) {
+                if (*p != '.') {
+                    break;
+                }
+                prec_pos = n;
+                prec = 0;
+                spec[n++] = *p++;
+            }
+            if (*p == '*') {
+                ++p;
+                long long v = reader.next(arg) ? arg.asInt() : 0;
+                n += snprintf(spec + n, 24, "%lld", v);
+                if (part == 1) {
+                    prec = v < 0 ? -1 : (int)std::min<long long>(v, 1 << 20);
+                }
+            }
+            while (*p >= '0' && *p <= '9') {
+                if (n < 36) {
+                    spec[n++] = *p;
+                    if (part == 1) {
+                        prec = std::min(prec * 10 + (*p - '0'), 1 << 20);
+                    }
+                }
+                ++p;
+            }
+        }
+        while (*p && strchr("hlLqjzt", *p)) {
+            ++p;
+        }
+        char conv = *p;
+        if (!conv) {
+            break;
+        }
+        if (conv == 'n') {
+            continue;
+        }
+        if (!reader.next(arg)) {
+            out.append("<missing>", 9);
+            continue;
+        }
+        auto with = [&](const char* suffix) -> const char* {
+            memcpy(conv_spec, spec, n);
+            strcpy(conv_spec + n, suffix);
+            return conv_spec;
+        };
+        char suffix[4] = {'l', 'l', conv, '\0'};
+        switch (conv) {
+            case 'd':
+            case 'i':
+                if (arg.type == BinLogArgs::STRING) {
+                    out.append(arg.s, arg.sLen);
+                } else {
+                    out.format(with("lld"), (long long)arg.asInt());
+                }
+                break;
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                if (arg.type == BinLogArgs::STRING) {
+                    out.append(arg.s, arg.sLen);
+                } else {
+                    out.format(with(suffix), (unsigned long long)arg.asUint());
+                }
+                break;
+            case 'c':
+                out.format(with("c"), (int)arg.asInt());
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+            case 'a':
+            case 'A':
+                out.format(with(suffix + 2), arg.asDouble());
+                break;
+            case 'p':
+                out.format(with("p"), (void*)(uintptr_t)arg.asUint());
+                break;
+            case 's':
+                if (arg.type == BinLogArgs::STRING) {
+                    //字符串不以'\0'结尾，按长度和原来的精度取较小的一个作为精度
+                    if (prec_pos) {
+                        n = prec_pos;
+                    }
+                    int len = prec >= 0 ? std::min<int>(prec, arg.sLen) : (int)arg.sLen;
+                    out.format(with(".*s"), len, arg.s);
+                } else if (arg.type == BinLogArgs::DOUBLE) {
+                    out.format("%g", arg.d);
+                } else if (arg.type == BinLogArgs::INT) {
+                    out.format("%lld", (long long)arg.i);
+                } else {
+                    out.format("%lld", (long long)(int64_t)arg.u);
+                }
+                break;
+            default:
+                out.push_back('%');
+                out.push_back(conv);
+                break;
+        }
+    }
+}
+
+}
+
+std::string BinLogArgs::Decode(const char* fmt, const char* data, size_t len) {
+    std::string out;
+    StringSink sink = {out};
+    DecodeTo(sink, fmt, data, len);
+    return out;
+}
+
+size_t BinLogArgs::Decode(const char* fmt, const char* data, size_t len, char* buf, size_t size) {
+    BufferSink sink = {buf, size, 0};
+    DecodeTo(sink, fmt, data, len);
+    return sink.len;
+}
+
+/*******************************BinLogWriter*********************************/
+BinLogWriter::BinLogWriter(const std::string& filename)
+    :m_filename(filename)
+    ,m_fd(-1) {
+    m_buf.reserve(s_binlog_flush_size * 2);
+    reopen();
+}
+
+BinLogWriter::~BinLogWriter() {
+    Mutex::Lock lock(m_mutex);
+    flushUnlocked();
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool BinLogWriter::reopen() {
+    Mutex::Lock lock(m_mutex);
+    flushUnlocked();
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+    m_fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        return false;
+    }
+    //新的文件头之后要重新写出所有定义
+    m_sites.clear();
+    m_loggers.clear();
+    m_threads.clear();
+    m_buf.append(BinLog::MAGIC, sizeof(BinLog::MAGIC));
+    return true;
+}
+
+uint32_t BinLogWriter::getSiteId(const LogEvent::ptr& event) {
+    if (event->getCallSite()) {
+        return event->getCallSite()->getId();
+    }
+    auto key = std::make_pair(std::string(event->getFile() ? event->getFile() : ""), event->getLine());
+    auto it = m_anonSites.find(key);
+    if (it != m_anonSites.end()) {
+        return it->second;
+    }
+    uint32_t id = LogCallSite::NextId();
+    m_anonSites[key] = id;
+    return id;
+}
+
+void BinLogWriter::write(Logger& logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    Mutex::Lock lock(m_mutex);
+    if (m_fd < 0) {
+        return;
+    }
+    uint32_t site = getSiteId(event);
+    if (m_sites.insert(site).second) {
+        const char* file = event->getFile() ? event->getFile() : "";
+        const char* fmt = event->getBinaryFormat() ? event->getBinaryFormat() : "";
+        BinPut(m_buf, (uint8_t)BinLog::SITE);
+        BinPut(m_buf, site);
+        BinPut(m_buf, (int32_t)event->getLine());
+        BinPutString(m_buf, file, strlen(file));
+        BinPutString(m_buf, fmt, strlen(fmt));
+    }
+    uint32_t logger_id = logger.getId();
+    if (m_loggers.insert(logger_id).second) {
+        BinPut(m_buf, (uint8_t)BinLog::LOGGER);
+        BinPut(m_buf, logger_id);
+        BinPutString(m_buf, logger.getName().c_str(), logger.getName().size());
+    }
+
+    auto it = m_threads.find(event->getThreadId());
+    if (it == m_threads.end() || it->second != event->getThreadName()) {
+        m_threads[event->getThreadId()] = event->getThreadName();
+        BinPut(m_buf, (uint8_t)BinLog::THREAD);
+        BinPut(m_buf, (uint32_t)event->getThreadId());
+        BinPutString(m_buf, event->getThreadName().c_str(), event->getThreadName().size());
+    }
+
+    BinPut(m_buf, (uint8_t)BinLog::EVENT);
+    BinPut(m_buf, site);
+    BinPut(m_buf, logger_id);
+    BinPut(m_buf, (uint8_t)level);
+    BinPut(m_buf, (uint8_t)(event->getBinaryFormat() ? BinLog::ARGS : 0));
+    BinPut(m_buf, (uint64_t)event->getTime());
+    BinPut(m_buf, (uint32_t)event->getNanosecond());
+    BinPut(m_buf, (uint32_t)event->getElapse());
+    BinPut(m_buf, (uint32_t)event->getThreadId());
+    BinPut(m_buf, (uint32_t)event->getFiberId());
+    BinPutString(m_buf, event->getContentData(), event->getContentSize());
+
+    //错误日志之后进程可能马上退出，立即落盘
+    if (m_buf.size() >= s_binlog_flush_size || level >= LogLevel::ERROR) {
+        flushUnlocked();
+    }
+}
+
+void BinLogWriter::flush() {
+    Mutex::Lock lock(m_mutex);
+    flushUnlocked();
+}
+
+void BinLogWriter::flushUnlocked() {
+    size_t offset = 0;
+    while (m_fd >= 0 && offset < m_buf.size()) {
+        ssize_t n = ::write(m_fd, m_buf.data() + offset, m_buf.size() - offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        offset += n;
+    }
+    m_buf.clear();
+}
+
+/*******************************BinLogReader*********************************/
+template<class T>
+static bool BinGet(std::istream& in, T& v) {
+    return !!in.read((char*)&v, sizeof(v));
+}
+
+static bool BinGetString(std::istream& in, std::string& v) {
+    uint32_t len = 0;
+    if (!BinGet(in, len)) {
+        return false;
+    }
+    v.resize(len);
+    return len == 0 || !!in.read(&v[0], len);
+}
+
+BinLogReader::BinLogReader(std::istream& in)
+    :m_in(in) {
+}
+
+bool BinLogReader::next(LogEvent::ptr& event) {
+    while (!m_error) {
+        bool has_event = false;
+        if (!readRecord(event, has_event)) {
+            return false;
+        }
+        if (has_event) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool BinLogReader::readRecord(LogEvent::ptr& event, bool& has_event) {
+    uint8_t type = 0;
+    if (!BinGet(m_in, type)) {
+        return false;
+    }
+    //文件头的第一个字节
+    if (type == (uint8_t)BinLog::MAGIC[0]) {
+        char magic[sizeof(BinLog::MAGIC) - 1];
+        if (!m_in.read(magic, sizeof(magic))
+                || memcmp(magic, BinLog::MAGIC + 1, sizeof(magic))) {
+            m_error = true;
+            return false;
+        }
+        m_sites.clear();
+        m_loggers.clear();
+        m_threads.clear();
+        return true;
+    }
+
+    if (type == BinLog::SITE) {
+        uint32_t id = 0;
+        Site site;
+        if (!BinGet(m_in, id) || !BinGet(m_in, site.line)
+                || !BinGetString(m_in, site.file) || !BinGetString(m_in, site.fmt)) {
+            m_error = true;
+            return false;
+        }
+        m_sites[id] = site;
+        return true;
+    }
+
+    if (type == BinLog::LOGGER) {
+        uint32_t id = 0;
+        std::string name;
+        if (!BinGet(m_in, id) || !BinGetString(m_in, name)) {
+            m_error = true;
+            return false;
+        }
+        m_loggers[id].reset(new Logger(name));
+        return true;
+    }
+
+    if (type == BinLog::THREAD) {
+        uint32_t id = 0;
+        std::string name;
+        if (!BinGet(m_in, id) || !BinGetString(m_in, name)) {
+            m_error = true;
+            return false;
+        }
+        m_threads[id] = name;
+        return true;
+    }
+
+    if (type != BinLog::EVENT) {
+        m_error = true;
+        return false;
+    }
+    uint32_t site_id = 0, logger_id = 0, nsec = 0, elapse = 0, thread_id = 0, fiber_id = 0;
+    uint8_t level = 0, flags = 0;
+    uint64_t sec = 0;
+    std::string payload;
+    if (!BinGet(m_in, site_id) || !BinGet(m_in, logger_id) || !BinGet(m_in, level)
+            || !BinGet(m_in, flags) || !BinGet(m_in, sec) || !BinGet(m_in, nsec)
+            || !BinGet(m_in, elapse) || !BinGet(m_in, thread_id) || !BinGet(m_in, fiber_id)
+            || !BinGetString(m_in, payload)) {
+        m_error = true;
+        return false;
+    }
+    auto sit = m_sites.find(site_id);
+    auto lit = m_loggers.find(logger_id);
+    if (sit == m_sites.end() || lit == m_loggers.end()) {
+        m_error = true;
+        return false;
+    }
+    const Site& site = sit->second;
+    event.reset(new LogEvent(lit->second, (LogLevel::Level)level, site.file.c_str(), site.line
+                , elapse, thread_id, fiber_id, sec, nsec));
+    auto tit = m_threads.find(thread_id);
+    event->setThreadName(tit != m_threads.end() ? tit->second : "");
+    if (flags & BinLog::ARGS) {
+        std::string content = BinLogArgs::Decode(site.fmt.c_str(), payload.data(), payload.size());
+        event->getSS().append(content.data(), content.size());
+    } else {
+        event->getSS().append(payload.data(), payload.size());
+    }
+    has_event = true;
+    return true;
+}
+
+}
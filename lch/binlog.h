@@ -0,0 +1,97 @@
+#ifndef __LCH_BINLOG_H__
+#define __LCH_BINLOG_H__
+
+#include <string>
+#include <memory>
+#include <map>
+#include <set>
+#include <istream>
+#include "log.h"
+#include "mutex.h"
+
+namespace lch {
+
+//二进制日志文件格式(本机字节序)
+//  文件头: "LCHBLOG\x01"，每次打开文件都会写一次，解码时遇到文件头就清空已知的调用点和Logger
+//  记录:   1字节类型 + 内容
+//    SITE   调用点 u32 id, i32 line, u32 len + file, u32 len + fmt(流式宏为空)
+//    LOGGER 日志器 u32 id, u32 len + name
+//    THREAD 线程名 u32 threadId, u32 len + name，线程名变化时重新写
+//    EVENT  日志   u32 site, u32 logger, u8 level, u8 flags, u64 sec, u32 nsec,
+//                  u32 elapse, u32 threadId, u32 fiberId, u32 len + payload
+//  同一个写入者只在第一次遇到某个调用点、Logger或线程时写出它的定义
+class BinLog {
+public:
+    enum RecordType {
+        SITE = 1,
+        LOGGER = 2,
+        EVENT = 3,
+        THREAD = 4
+    };
+
+    enum EventFlag {
+        //payload是BinLogArgs编码的参数，否则是文本
+        ARGS = 1
+    };
+
+    static const char MAGIC[8];
+};
+
+//二进制日志写入者 日志先攒在缓冲区里，满了或者遇到ERROR以上级别时才写文件
+class BinLogWriter {
+public:
+    typedef std::shared_ptr<BinLogWriter> ptr;
+    BinLogWriter(const std::string& filename);
+    ~BinLogWriter();
+
+    void write(Logger& logger, LogLevel::Level level, const LogEvent::ptr& event);
+    void flush();
+
+    //重新打开文件(追加写)，成功返回true
+    bool reopen();
+    bool isOpen() const { return m_fd >= 0; }
+    const std::string& getFilename() const { return m_filename; }
+private:
+    uint32_t getSiteId(const LogEvent::ptr& event);
+    void flushUnlocked();
+private:
+    std::string m_filename;
+    int m_fd;
+    std::string m_buf;
+    //已经写出定义的调用点和Logger
+    std::set<uint32_t> m_sites;
+    std::set<uint32_t> m_loggers;
+    std::map<uint32_t, std::string> m_threads;
+    //不是由日志宏产生的事件按 文件:行号 分配调用点编号
+    std::map<std::pair<std::string, int32_t>, uint32_t> m_anonSites;
+    Mutex m_mutex;
+};
+
+//二进制日志读取者 把记录还原成LogEvent，交给LogFormatter输出
+class BinLogReader {
+public:
+    BinLogReader(std::istream& in);
+
+    //读取下一条日志，文件结束或者数据损坏时返回false
+    //返回的LogEvent引用的文件名在读取下一条之前有效
+    bool next(LogEvent::ptr& event);
+    //数据损坏时为true
+    bool isError() const { return m_error; }
+private:
+    bool readRecord(LogEvent::ptr& event, bool& has_event);
+private:
+    struct Site {
+        std::string file;
+        int32_t line = 0;
+        std::string fmt;
+    };
+    std::istream& m_in;
+    std::map<uint32_t, Site> m_sites;
+    std::map<uint32_t, Logger::ptr> m_loggers;
+    std::map<uint32_t, std::string> m_threads;
+    bool m_error = false;
+};
+
+}
+
+#endif // !__LCH_BINLOG_H__
@@ -0,0 +1,668 @@
+#include "compress_appender.h"
+#include "config.h"
+#include "thread.h"
+#include "util.h"
+#include <zlib.h>
+#ifdef LCH_HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef LCH_HAVE_LZ4
+#include <lz4.h>
+#endif
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <algorithm>
+
+namespace lch {
+
+const char CompressedLog::MAGIC[4] = {'L', 'C', 'Z', 1};
+
+const char* CompressedLog::ToString(Codec codec) {
+    switch (codec) {
+        case NONE:
+            return "none";
+        case ZSTD:
+            return "zstd";
+        case LZ4:
+            return "lz4";
+        default:
+            return "zlib";
+    }
+}
+
+CompressedLog::Codec CompressedLog::FromString(const std::string& str) {
+    if (str == "none") {
+        return NONE;
+    }
+    if (str == "zstd") {
+        return ZSTD;
+    }
+    if (str == "lz4") {
+        return LZ4;
+    }
+    return ZLIB;
+}
+
+bool CompressedLog::IsSupported(Codec codec) {
+    switch (codec) {
+        case NONE:
+        case ZLIB:
+            return true;
+#ifdef LCH_HAVE_ZSTD
+        case ZSTD:
+            return true;
+#endif
+#ifdef LCH_HAVE_LZ4
+        case LZ4:
+            return true;
+#endif
+        default:
+            return false;
+    }
+}
+
+//块头和压缩数据的crc，计算时块头的crc字段为0
+static uint32_t BlockCrc(const CompressedLogBlock& block, const char* data) {
+    CompressedLogBlock h = block;
+    h.crc = 0;
+    uLong crc = crc32(0, (const Bytef*)&h, sizeof(h));
+    return crc32(crc, (const Bytef*)data, block.size);
+}
+
+static bool Decompress(const CompressedLogBlock& block, const char* data, char* out) {
+    switch (block.codec) {
+        case CompressedLog::NONE:
+            if (block.size != block.rawSize) {
+                return false;
+            }
+            memcpy(out, data, block.size);
+            return true;
+        case CompressedLog::ZLIB: {
+            uLongf len = block.rawSize;
+            return uncompress((Bytef*)out, &len, (const Bytef*)data, block.size) == Z_OK
+                   && len == block.rawSize;
+        }
+#ifdef LCH_HAVE_ZSTD
+        case CompressedLog::ZSTD:
+            return ZSTD_decompress(out, block.rawSize, data, block.size) == block.rawSize;
+#endif
+#ifdef LCH_HAVE_LZ4
+        case CompressedLog::LZ4:
+            return LZ4_decompress_safe(data, out, block.size, block.rawSize) == (int)block.rawSize;
+#endif
+        default:
+            return false;
+    }
+}
+
+/*******************************BlockCompressor*********************************/
+namespace {
+
+//只由后台线程使用，压缩状态在块之间复用
+class BlockCompressor {
+public:
+    BlockCompressor(CompressedLog::Codec codec, int level)
+        :m_codec(codec)
+        ,m_level(level) {
+        if (m_codec == CompressedLog::ZLIB) {
+            memset(&m_zs, 0, sizeof(m_zs));
+            m_zinit = deflateInit(&m_zs, level < 0 ? Z_DEFAULT_COMPRESSION : std::min(level, 9)) == Z_OK;
+        }
+#ifdef LCH_HAVE_ZSTD
+        if (m_codec == CompressedLog::ZSTD) {
+            m_zstd = ZSTD_createCCtx();
+        }
+#endif
+    }
+
+    ~BlockCompressor() {
+        if (m_zinit) {
+            deflateEnd(&m_zs);
+        }
+#ifdef LCH_HAVE_ZSTD
+        if (m_zstd) {
+            ZSTD_freeCCtx(m_zstd);
+        }
+#endif
+    }
+
+    //压缩in到out，失败或者没有变小时返回false，由调用者原样存储
+    bool compress(const std::string& in, std::string& out) {
+        switch (m_codec) {
+            case CompressedLog::ZLIB: {
+                if (!m_zinit || deflateReset(&m_zs) != Z_OK) {
+                    return false;
+                }
+                out.resize(deflateBound(&m_zs, in.size()));
+                m_zs.next_in = (Bytef*)in.data();
+                m_zs.avail_in = in.size();
+                m_zs.next_out = (Bytef*)&out[0];
+                m_zs.avail_out = out.size();
+                if (deflate(&m_zs, Z_FINISH) != Z_STREAM_END) {
+                    return false;
+                }
+                out.resize(m_zs.total_out);
+                break;
+            }
+#ifdef LCH_HAVE_ZSTD
+            case CompressedLog::ZSTD: {
+                if (!m_zstd) {
+                    return false;
+                }
+                out.resize(ZSTD_compressBound(in.size()));
+                size_t n = ZSTD_compressCCtx(m_zstd, &out[0], out.size(), in.data(), in.size()
+                                             , m_level < 0 ? ZSTD_CLEVEL_DEFAULT : m_level);
+                if (ZSTD_isError(n)) {
+                    return false;
+                }
+                out.resize(n);
+                break;
+            }
+#endif
+#ifdef LCH_HAVE_LZ4
+            case CompressedLog::LZ4: {
+                //lz4的级别作为加速参数，越大越快
+                out.resize(LZ4_compressBound(in.size()));
+                int n = LZ4_compress_fast(in.data(), &out[0], in.size(), out.size(), m_level > 0 ? m_level : 1);
+                if (n <= 0) {
+                    return false;
+                }
+                out.resize(n);
+                break;
+            }
+#endif
+            default:
+                return false;
+        }
+        return out.size() < in.size();
+    }
+private:
+    CompressedLog::Codec m_codec;
+    int m_level;
+    z_stream m_zs;
+    bool m_zinit = false;
+#ifdef LCH_HAVE_ZSTD
+    ZSTD_CCtx* m_zstd = nullptr;
+#endif
+};
+
+//把iov中的内容全部写出
+bool WriteFull(int fd, struct iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+}
+
+/*******************************CompressedFileLogAppender::Writer*********************************/
+struct CompressedFileLogAppender::Writer {
+    //一块还没压缩的日志
+    struct Block {
+        std::string data;
+        uint32_t count = 0;
+        uint64_t minTime = 0;
+        uint64_t maxTime = 0;
+    };
+
+    Writer(const std::string& name, CompressedLog::Codec c, int level, uint32_t block_size
+            , uint32_t flush_ms, uint32_t max_blocks)
+        :filename(name)
+        ,codec(c)
+        ,compressLevel(level)
+        ,blockSize(std::max<uint32_t>(block_size, 4096))
+        ,flushInterval(flush_ms)
+        ,maxBlocks(std::max<uint32_t>(max_blocks, 1))
+        ,sleeping(false)
+        ,stopping(false)
+        ,flushRequests(0)
+        ,flushDone(0)
+        ,blocks(0)
+        ,rawBytes(0)
+        ,compressedBytes(0) {
+        openFile();
+    }
+
+    ~Writer() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool openFile() {
+        //每块一次writev追加写，崩溃时只有最后一块可能不完整
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cout << "CompressedFileLogAppender open " << filename << " failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void start(std::shared_ptr<Writer> self) {
+        thread.reset(new Thread([self]() { self->run(); }, "log_compress"));
+    }
+
+    void stop() {
+        stopping = true;
+        notify();
+        if (thread) {
+            thread->join();
+            thread.reset();
+        }
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+            sem.notify();
+        }
+    }
+
+    //把当前块交给后台线程，调用者持有mutex
+    void pushCurrent() {
+        ready.push_back(Block());
+        std::swap(ready.back(), cur);
+        if (!spare.empty()) {
+            cur.data.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+
+    //写日志的线程调用，只拷贝，块写满时才唤醒后台线程
+    void append(const char* data, size_t len, uint64_t time) {
+        bool wake = false;
+        int spins = 0;
+        Mutex::Lock lock(mutex);
+        //放不下时先把当前块交出去，等待压缩的块太多时等后台线程
+        while (!cur.data.empty() && cur.data.size() + len > blockSize) {
+            if (ready.size() < maxBlocks || (stopping && !thread)) {
+                pushCurrent();
+                wake = true;
+                break;
+            }
+            lock.unlock();
+            notify();
+            if (++spins < 64) {
+                sched_yield();
+            } else {
+                usleep(100);
+            }
+            lock.lock();
+        }
+        if (cur.data.empty()) {
+            cur.data.reserve(blockSize);
+            cur.minTime = time;
+            cur.maxTime = time;
+            curSince = GetMonotonicNS();
+        } else {
+            cur.minTime = std::min(cur.minTime, time);
+            cur.maxTime = std::max(cur.maxTime, time);
+        }
+        cur.data.append(data, len);
+        ++cur.count;
+        if (cur.data.size() >= blockSize) {
+            //等待压缩的块太多时留给后台线程交出去
+            if (ready.size() < maxBlocks) {
+                pushCurrent();
+            }
+            wake = true;
+        }
+        lock.unlock();
+        if (wake) {
+            notify();
+        }
+    }
+
+    //请求后台线程把当前块压缩写出，等待完成
+    void flush() {
+        if (!thread) {
+            return;
+        }
+        uint64_t req = ++flushRequests;
+        while (flushDone.load() < req && thread) {
+            notify();
+            usleep(100);
+        }
+    }
+
+    bool reopen() {
+        Mutex::Lock lock(ioMutex);
+        int old = fd;
+        if (!openFile()) {
+            fd = old;
+            return false;
+        }
+        if (old >= 0) {
+            close(old);
+        }
+        return true;
+    }
+
+    //压缩一块并写出，只由后台线程调用
+    void write(BlockCompressor& compressor, Block& b) {
+        CompressedLogBlock h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, CompressedLog::MAGIC, sizeof(h.magic));
+        h.rawSize = b.data.size();
+        h.count = b.count;
+        h.minTime = b.minTime;
+        h.maxTime = b.maxTime;
+        const std::string* payload = &b.data;
+        if (codec != CompressedLog::NONE && compressor.compress(b.data, out)) {
+            h.codec = codec;
+            payload = &out;
+        } else {
+            h.codec = CompressedLog::NONE;
+        }
+        h.size = payload->size();
+        h.crc = BlockCrc(h, payload->data());
+
+        struct iovec iov[2];
+        iov[0].iov_base = &h;
+        iov[0].iov_len = sizeof(h);
+        iov[1].iov_base = (void*)payload->data();
+        iov[1].iov_len = payload->size();
+        Mutex::Lock lock(ioMutex);
+        if (fd >= 0 && !WriteFull(fd, iov, 2)) {
+            std::cout << "CompressedFileLogAppender write " << filename << " failed: " << strerror(errno) << std::endl;
+        }
+        lock.unlock();
+        ++blocks;
+        rawBytes += h.rawSize;
+        compressedBytes += sizeof(h) + h.size;
+    }
+
+    void run() {
+        BlockCompressor compressor(codec, compressLevel);
+        std::vector<Block> batch;
+        while (true) {
+            bool stop = stopping;
+            uint64_t req = flushRequests.load();
+            uint64_t now = GetMonotonicNS();
+            {
+                Mutex::Lock lock(mutex);
+                //没写满的块超过flush_interval或者被要求刷新时也写出去
+                if (!cur.data.empty() && (stop || req != flushDone || cur.data.size() >= blockSize
+                            || now - curSince >= (uint64_t)flushInterval * 1000000)) {
+                    pushCurrent();
+                }
+                batch.swap(ready);
+            }
+            for (auto& b : batch) {
+                write(compressor, b);
+            }
+            if (!batch.empty()) {
+                Mutex::Lock lock(mutex);
+                for (auto& b : batch) {
+                    if (spare.size() < maxBlocks) {
+                        b.data.clear();
+                        spare.push_back(std::string());
+                        spare.back().swap(b.data);
+                    }
+                }
+                lock.unlock();
+                batch.clear();
+            }
+            flushDone = req;
+            if (stop) {
+                break;
+            }
+
+            //有没写满的块时最多睡到该刷新的时候
+            uint32_t timeout = 1000;
+            {
+                Mutex::Lock lock(mutex);
+                if (!ready.empty()) {
+                    continue;
+                }
+                if (!cur.data.empty()) {
+                    uint64_t due = curSince + (uint64_t)flushInterval * 1000000;
+                    timeout = due > now ? std::min<uint64_t>((due - now) / 1000000, timeout) : 0;
+                }
+            }
+            sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (hasReady() || stopping || flushRequests.load() != flushDone) {
+                if (sleeping.exchange(false)) {
+                    continue;
+                }
+            }
+            if (!sem.wait(std::max<uint32_t>(timeout, 1))) {
+                sleeping = false;
+            }
+        }
+    }
+
+    bool hasReady() {
+        Mutex::Lock lock(mutex);
+        return !ready.empty();
+    }
+
+    std::string filename;
+    CompressedLog::Codec codec;
+    int compressLevel;
+    uint32_t blockSize;
+    uint32_t flushInterval;
+    uint32_t maxBlocks;
+    int fd = -1;
+
+    //写日志的线程和后台线程共用，保护下面的块
+    Mutex mutex;
+    Block cur;
+    uint64_t curSince = 0;      //当前块第一次写入的时间
+    std::vector<Block> ready;
+    //写完的块留下内存给后面的块用
+    std::vector<std::string> spare;
+
+    //写文件和reopen互斥
+    Mutex ioMutex;
+    //只由后台线程访问，压缩结果
+    std::string out;
+
+    Thread::ptr thread;
+    Semaphore sem;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> flushRequests;
+    std::atomic<uint64_t> flushDone;
+    std::atomic<uint64_t> blocks;
+    std::atomic<uint64_t> rawBytes;
+    std::atomic<uint64_t> compressedBytes;
+};
+
+/*******************************CompressedFileLogAppender*********************************/
+CompressedFileLogAppender::CompressedFileLogAppender(const std::string& filename, CompressedLog::Codec codec
+        , int level, uint32_t block_size, uint32_t flush_interval, uint32_t max_blocks)
+    :LogAppender(true)
+    ,m_filename(filename)
+    ,m_codec(codec)
+    ,m_compressLevel(level)
+    ,m_blockSize(block_size)
+    ,m_flushInterval(flush_interval)
+    ,m_maxBlocks(max_blocks) {
+    if (!CompressedLog::IsSupported(m_codec)) {
+        std::cout << "CompressedFileLogAppender codec " << CompressedLog::ToString(m_codec)
+                  << " is not available, use zlib" << std::endl;
+        m_codec = CompressedLog::ZLIB;
+        m_compressLevel = -1;
+    }
+    m_writer.reset(new Writer(filename, m_codec, m_compressLevel, block_size, flush_interval, max_blocks));
+    m_writer->start(m_writer);
+}
+
+CompressedFileLogAppender::~CompressedFileLogAppender() {
+    m_writer->stop();
+}
+
+void CompressedFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void CompressedFileLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    m_writer->append(text.data(), text.size(), event->getTime() * 1000000 + event->getNanosecond() / 1000);
+}
+
+void CompressedFileLogAppender::flush() {
+    m_writer->flush();
+}
+
+bool CompressedFileLogAppender::reopen() {
+    return m_writer->reopen();
+}
+
+uint64_t CompressedFileLogAppender::getBlocks() const {
+    return m_writer->blocks;
+}
+
+uint64_t CompressedFileLogAppender::getRawBytes() const {
+    return m_writer->rawBytes;
+}
+
+uint64_t CompressedFileLogAppender::getCompressedBytes() const {
+    return m_writer->compressedBytes;
+}
+
+std::string CompressedFileLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "CompressedFileLogAppender";
+    node["file"] = m_filename;
+    node["codec"] = CompressedLog::ToString(m_codec);
+    if (m_compressLevel >= 0) {
+        node["compress_level"] = m_compressLevel;
+    }
+    node["block_size"] = m_blockSize;
+    node["flush_interval"] = m_flushInterval;
+    node["buffers"] = m_maxBlocks;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if( m_hasFormatter && fmt ) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/*******************************CompressedLogReader*********************************/
+CompressedLogReader::CompressedLogReader(const std::string& filename)
+    :m_filename(filename)
+    ,m_data(nullptr)
+    ,m_size(0)
+    ,m_pos(0)
+    ,m_hasBlock(false)
+    ,m_skipped(0)
+    ,m_truncated(false)
+    ,m_valid(false) {
+    memset(&m_block, 0, sizeof(m_block));
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    m_size = st.st_size;
+    if (m_size) {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return;
+        }
+        madvise(data, m_size, MADV_SEQUENTIAL);
+        m_data = (const char*)data;
+    }
+    close(fd);
+    m_valid = true;
+}
+
+CompressedLogReader::~CompressedLogReader() {
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+}
+
+bool CompressedLogReader::next(CompressedLogBlock& block, uint64_t& offset) {
+    m_hasBlock = false;
+    while (m_pos < m_size) {
+        CompressedLogBlock h;
+        bool partial = false;
+        if (m_size - m_pos < sizeof(h)) {
+            partial = memcmp(m_data + m_pos, CompressedLog::MAGIC
+                             , std::min<uint64_t>(m_size - m_pos, sizeof(h.magic))) == 0;
+        } else {
+            memcpy(&h, m_data + m_pos, sizeof(h));
+            if (memcmp(h.magic, CompressedLog::MAGIC, sizeof(h.magic)) == 0) {
+                uint64_t end = m_pos + sizeof(h) + h.size;
+                if (end > m_size) {
+                    partial = true;
+                } else if (BlockCrc(h, m_data + m_pos + sizeof(h)) == h.crc) {
+                    m_block = h;
+                    m_hasBlock = true;
+                    block = h;
+                    offset = m_pos;
+                    m_pos = end;
+                    return true;
+                }
+            }
+        }
+        //从下一个字节开始找块头
+        const char* found = (const char*)memmem(m_data + m_pos + 1, m_size - m_pos - 1
+                                                , CompressedLog::MAGIC, sizeof(CompressedLog::MAGIC));
+        uint64_t skip = found ? found - m_data : m_size;
+        if (!found && partial) {
+            //最后一块没写完
+            m_truncated = true;
+        } else {
+            m_skipped += skip - m_pos;
+        }
+        m_pos = skip;
+    }
+    return false;
+}
+
+bool CompressedLogReader::read(std::string& out) {
+    if (!m_hasBlock) {
+        return false;
+    }
+    const char* data = m_data + m_pos - m_block.size;
+    size_t old = out.size();
+    out.resize(old + m_block.rawSize);
+    if (!Decompress(m_block, data, &out[old])) {
+        out.resize(old);
+        return false;
+    }
+    return true;
+}
+
+}
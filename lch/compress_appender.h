@@ -0,0 +1,120 @@
+#ifndef __LCH_COMPRESS_APPENDER_H__
+#define __LCH_COMPRESS_APPENDER_H__
+
+#include <string>
+#include <memory>
+#include "log.h"
+
+namespace lch {
+
+//分块压缩的日志文件格式(本机字节序)
+//  文件由互相独立的块组成，每块是 CompressedLogBlock + size字节的压缩数据，解压后是格式化好的日志
+//  一块里的日志都是完整的，任何一块都可以单独解压；按块头中的时间可以不解压就跳过整块
+//  crc覆盖块头(crc字段为0)和压缩数据，损坏的块被跳过，从后面找下一个块头继续读；
+//  进程崩溃时只有最后没写完的一块会丢失
+struct CompressedLogBlock {
+    char magic[4];          //"LCZ\x01"
+    uint8_t codec;          //CompressedLog::Codec
+    uint8_t reserved[3];
+    uint32_t rawSize;       //解压后的字节数
+    uint32_t size;          //压缩数据的字节数
+    uint32_t count;         //日志条数
+    uint32_t crc;
+    uint64_t minTime;       //块中最早的日志时间(微秒)
+    uint64_t maxTime;       //块中最晚的日志时间(微秒)
+};
+
+class CompressedLog {
+public:
+    //zstd和lz4在配置时找到对应的库才可用，否则退回zlib
+    enum Codec {
+        NONE = 0,           //不压缩，压缩后没有变小的块也这样存
+        ZLIB = 1,
+        ZSTD = 2,
+        LZ4 = 3
+    };
+    static const char MAGIC[4];
+    static const char* ToString(Codec codec);
+    static Codec FromString(const std::string& str);
+    static bool IsSupported(Codec codec);
+};
+
+//分块压缩写文件的Appender
+//写日志的线程只把格式化好的内容追加到当前块，块满了或者超过flush_interval毫秒后交给后台线程压缩并写出，
+//写日志的线程不做压缩和系统调用；等待压缩的块超过max_blocks时写日志的线程等待后台线程
+class CompressedFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<CompressedFileLogAppender> ptr;
+    //level为压缩级别，-1表示使用算法的默认级别
+    CompressedFileLogAppender(const std::string& filename, CompressedLog::Codec codec = CompressedLog::ZLIB
+                              , int level = -1, uint32_t block_size = 256 * 1024
+                              , uint32_t flush_interval = 1000, uint32_t max_blocks = 8);
+    //压缩并写出剩余的内容后停止后台线程
+    ~CompressedFileLogAppender();
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+
+    //把已经写入的日志全部压缩写出，等待完成
+    void flush();
+    //关闭当前文件后重新打开(追加写)，成功返回true
+    bool reopen();
+
+    //写出的块数，压缩前和压缩后的总字节数
+    uint64_t getBlocks() const;
+    uint64_t getRawBytes() const;
+    uint64_t getCompressedBytes() const;
+
+    const std::string& getFilename() const { return m_filename; }
+    //实际使用的压缩算法
+    CompressedLog::Codec getCodec() const { return m_codec; }
+    int getCompressLevel() const { return m_compressLevel; }
+    uint32_t getBlockSize() const { return m_blockSize; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+    uint32_t getMaxBlocks() const { return m_maxBlocks; }
+private:
+    //后台线程和Appender共享的状态
+    struct Writer;
+private:
+    std::string m_filename;
+    CompressedLog::Codec m_codec;
+    int m_compressLevel;
+    uint32_t m_blockSize;
+    uint32_t m_flushInterval;
+    uint32_t m_maxBlocks;
+    std::shared_ptr<Writer> m_writer;
+};
+
+//分块压缩日志的读取者，文件用mmap读取
+class CompressedLogReader {
+public:
+    CompressedLogReader(const std::string& filename);
+    ~CompressedLogReader();
+
+    bool isValid() const { return m_valid; }
+    //读取下一个完好的块头，offset为块在文件中的偏移，没有更多的块时返回false
+    bool next(CompressedLogBlock& block, uint64_t& offset);
+    //解压next刚返回的块，追加到out
+    bool read(std::string& out);
+
+    //因为损坏跳过的字节数
+    uint64_t getSkipped() const { return m_skipped; }
+    //文件末尾有没写完的块
+    bool isTruncated() const { return m_truncated; }
+private:
+    std::string m_filename;
+    const char* m_data;
+    uint64_t m_size;
+    uint64_t m_pos;
+    //next刚返回的块
+    CompressedLogBlock m_block;
+    bool m_hasBlock;
+    uint64_t m_skipped;
+    bool m_truncated;
+    bool m_valid;
+};
+
+}
+
+#endif // !__LCH_COMPRESS_APPENDER_H__
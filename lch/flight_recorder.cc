@@ -0,0 +1,382 @@
+#include "flight_recorder.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <string.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace lch {
+
+//关闭时的级别，大于任何日志级别
+static const int s_recorder_off = LogLevel::FATAL + 1;
+
+std::atomic<int> FlightRecorder::s_level(s_recorder_off);
+
+namespace {
+
+//一条日志的快照，全部是定长字段，可以直接拷贝
+struct RecordData {
+    uint64_t sec;
+    uint32_t nsec;
+    uint32_t threadId;
+    int32_t line;
+    uint8_t level;
+    uint16_t msgLen;
+    char logger[FlightRecorder::NAME_SIZE];
+    char thread[FlightRecorder::NAME_SIZE];
+    char file[FlightRecorder::FILE_SIZE];
+    char msg[FlightRecorder::MSG_SIZE];
+};
+
+//seq为奇数表示正在写，读者前后两次读到的seq相同且为偶数时数据才完整
+struct RecordSlot {
+    std::atomic<uint32_t> seq;
+    RecordData data;
+};
+
+//每个线程一个环，只由所属线程写入，线程退出后留给新线程复用
+//分配后不释放，信号处理函数中可以随时遍历
+struct RecordRing {
+    std::atomic<uint64_t> head;     //已经写入的条数
+    std::atomic<bool> owned;
+    uint32_t capacity;
+    RecordSlot* slots;
+    RecordRing* next;
+};
+
+static std::atomic<RecordRing*> s_rings(nullptr);
+static std::atomic<size_t> s_capacity(256);
+static char s_dump_file[PATH_MAX] = {0};
+static std::atomic<bool> s_dumping(false);
+
+static const int s_signals[] = {SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL};
+static const int s_signal_count = sizeof(s_signals) / sizeof(s_signals[0]);
+static struct sigaction s_old_actions[s_signal_count];
+static bool s_signal_installed = false;
+//栈溢出时在备用栈上执行信号处理函数，只给调用Enable的线程设置
+static char s_alt_stack[64 * 1024];
+
+static RecordRing* AcquireRing() {
+    size_t capacity = s_capacity.load(std::memory_order_relaxed);
+    for (RecordRing* r = s_rings.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (r->capacity == capacity && !r->owned.load(std::memory_order_relaxed)
+                && r->owned.compare_exchange_strong(expected, true)) {
+            return r;
+        }
+    }
+    RecordRing* r = new RecordRing;
+    r->head = 0;
+    r->owned = true;
+    r->capacity = capacity ? capacity : 1;
+    r->slots = new RecordSlot[r->capacity];
+    for (uint32_t i = 0; i < r->capacity; ++i) {
+        r->slots[i].seq = 0;
+    }
+    r->next = s_rings.load(std::memory_order_relaxed);
+    while (!s_rings.compare_exchange_weak(r->next, r));
+    return r;
+}
+
+//线程退出时把环交还，内容保留到被复用为止
+struct RingHolder {
+    RecordRing* ring = nullptr;
+    ~RingHolder() {
+        if (ring) {
+            ring->owned.store(false, std::memory_order_release);
+        }
+    }
+};
+
+static void CopyName(char* dst, size_t size, const char* src, size_t len) {
+    if (len >= size) {
+        len = size - 1;
+    }
+    memcpy(dst, src, len);
+    dst[len] = '\0';
+}
+
+/**************************异步信号安全的输出**************************/
+class SafeWriter {
+public:
+    SafeWriter(int fd) : m_fd(fd), m_pos(0) {}
+    ~SafeWriter() { flush(); }
+
+    void append(const char* s, size_t len) {
+        while (len) {
+            if (m_pos == sizeof(m_buf)) {
+                flush();
+            }
+            size_t n = std::min(len, sizeof(m_buf) - m_pos);
+            memcpy(m_buf + m_pos, s, n);
+            m_pos += n;
+            s += n;
+            len -= n;
+        }
+    }
+    void append(const char* s) { append(s, strlen(s)); }
+    void append(char c) { append(&c, 1); }
+
+    //固定宽度时左边补0
+    void appendUint(uint64_t v, int width = 0) {
+        char tmp[24];
+        char* p = tmp + sizeof(tmp);
+        do {
+            *--p = '0' + v % 10;
+            v /= 10;
+            --width;
+        } while (v || width > 0);
+        append(p, tmp + sizeof(tmp) - p);
+    }
+    void appendInt(int64_t v) {
+        if (v < 0) {
+            append('-');
+            appendUint(-(uint64_t)v);
+        } else {
+            appendUint(v);
+        }
+    }
+
+    //UTC时间，localtime_r不是异步信号安全的
+    void appendTime(uint64_t sec, uint32_t nsec) {
+        int64_t days = sec / 86400;
+        uint64_t rem = sec % 86400;
+        //days_from_civil的逆运算
+        days += 719468;
+        int64_t era = days / 146097;
+        uint64_t doe = days - era * 146097;
+        uint64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+        int64_t year = yoe + era * 400;
+        uint64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+        uint64_t mp = (5 * doy + 2) / 153;
+        uint64_t day = doy - (153 * mp + 2) / 5 + 1;
+        uint64_t month = mp < 10 ? mp + 3 : mp - 9;
+        if (month <= 2) {
+            ++year;
+        }
+        appendUint(year, 4);
+        append('-');
+        appendUint(month, 2);
+        append('-');
+        appendUint(day, 2);
+        append(' ');
+        appendUint(rem / 3600, 2);
+        append(':');
+        appendUint(rem / 60 % 60, 2);
+        append(':');
+        appendUint(rem % 60, 2);
+        append('.');
+        appendUint(nsec / 1000, 6);
+        append('Z');
+    }
+
+    void flush() {
+        size_t off = 0;
+        while (off < m_pos) {
+            ssize_t n = write(m_fd, m_buf + off, m_pos - off);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            off += n;
+        }
+        m_pos = 0;
+    }
+private:
+    int m_fd;
+    size_t m_pos;
+    char m_buf[4096];
+};
+
+static void SignalHandler(int sig) {
+    FlightRecorder::Dump();
+    //恢复原来的处理方式后重新触发，保留core dump和退出码
+    for (int i = 0; i < s_signal_count; ++i) {
+        if (s_signals[i] == sig) {
+            sigaction(sig, &s_old_actions[i], nullptr);
+            break;
+        }
+    }
+    raise(sig);
+}
+
+static void InstallSignal() {
+    if (s_signal_installed) {
+        return;
+    }
+    stack_t ss;
+    memset(&ss, 0, sizeof(ss));
+    ss.ss_sp = s_alt_stack;
+    ss.ss_size = sizeof(s_alt_stack);
+    sigaltstack(&ss, nullptr);
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SignalHandler;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_ONSTACK;
+    for (int i = 0; i < s_signal_count; ++i) {
+        sigaction(s_signals[i], &sa, &s_old_actions[i]);
+    }
+    s_signal_installed = true;
+}
+
+static void UninstallSignal() {
+    if (!s_signal_installed) {
+        return;
+    }
+    for (int i = 0; i < s_signal_count; ++i) {
+        sigaction(s_signals[i], &s_old_actions[i], nullptr);
+    }
+    s_signal_installed = false;
+}
+
+}
+
+void FlightRecorder::Enable(const std::string& dump_file, size_t events, LogLevel::Level level, bool install_signal) {
+    CopyName(s_dump_file, sizeof(s_dump_file), dump_file.c_str(), dump_file.size());
+    s_capacity = events;
+    if (install_signal) {
+        InstallSignal();
+    } else {
+        UninstallSignal();
+    }
+    s_level = level;
+    //调用点缓存的开关要把记录器的级别算进去
+    LogCallSite::Invalidate();
+}
+
+void FlightRecorder::Disable() {
+    s_level = s_recorder_off;
+    UninstallSignal();
+    LogCallSite::Invalidate();
+}
+
+void FlightRecorder::Record(LogLevel::Level level, const LogEvent& event) {
+    if (level < GetLevel()) {
+        return;
+    }
+    static thread_local RingHolder s_holder;
+    RecordRing* ring = s_holder.ring;
+    if (!ring) {
+        ring = s_holder.ring = AcquireRing();
+    }
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    RecordSlot& slot = ring->slots[head % ring->capacity];
+    uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+    slot.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    RecordData& d = slot.data;
+    d.sec = event.getTime();
+    d.nsec = event.getNanosecond();
+    d.threadId = event.getThreadId();
+    d.line = event.getLine();
+    d.level = level;
+    const std::string& logger = event.getLogger()->getName();
+    CopyName(d.logger, sizeof(d.logger), logger.c_str(), logger.size());
+    CopyName(d.thread, sizeof(d.thread), event.getThreadName().c_str(), event.getThreadName().size());
+    const char* file = event.getFile() ? event.getFile() : "";
+    size_t flen = strlen(file);
+    if (flen >= sizeof(d.file)) {
+        file += flen - sizeof(d.file) + 1;
+        flen = sizeof(d.file) - 1;
+    }
+    CopyName(d.file, sizeof(d.file), file, flen);
+    if (event.getBinaryFormat()) {
+        //直接解码到槽位里，记录时不分配内存
+        d.msgLen = BinLogArgs::Decode(event.getBinaryFormat(), event.getContentData()
+                , event.getContentSize(), d.msg, sizeof(d.msg));
+    } else {
+        d.msgLen = std::min(event.getContentSize(), sizeof(d.msg));
+        memcpy(d.msg, event.getContentData(), d.msgLen);
+    }
+
+    slot.seq.store(seq + 2, std::memory_order_release);
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+int FlightRecorder::Dump() {
+    if (!s_dump_file[0]) {
+        return -1;
+    }
+    bool expected = false;
+    if (!s_dumping.compare_exchange_strong(expected, true)) {
+        return -1;
+    }
+    int rt = -1;
+    int fd = open(s_dump_file, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd >= 0) {
+        rt = Dump(fd);
+        close(fd);
+    }
+    s_dumping = false;
+    return rt;
+}
+
+int FlightRecorder::Dump(int fd) {
+    int count = 0;
+    SafeWriter w(fd);
+    w.append("==== lch flight recorder ====\n");
+    for (RecordRing* r = s_rings.load(std::memory_order_acquire); r; r = r->next) {
+        uint64_t head = r->head.load(std::memory_order_acquire);
+        if (!head) {
+            continue;
+        }
+        uint64_t begin = head > r->capacity ? head - r->capacity : 0;
+        //环可能被退出的线程交还后复用，线程变化时重新输出标题
+        bool title = false;
+        uint32_t tid = 0;
+        for (uint64_t i = begin; i < head; ++i) {
+            RecordSlot& slot = r->slots[i % r->capacity];
+            uint32_t seq = slot.seq.load(std::memory_order_acquire);
+            if (seq & 1) {
+                continue;
+            }
+            RecordData d;
+            memcpy(&d, &slot.data, sizeof(d));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slot.seq.load(std::memory_order_relaxed) != seq) {
+                continue;
+            }
+            d.logger[sizeof(d.logger) - 1] = '\0';
+            d.thread[sizeof(d.thread) - 1] = '\0';
+            d.file[sizeof(d.file) - 1] = '\0';
+            if (d.msgLen > sizeof(d.msg)) {
+                d.msgLen = sizeof(d.msg);
+            }
+            if (!title || d.threadId != tid) {
+                w.append("---- thread ");
+                w.appendUint(d.threadId);
+                w.append(' ');
+                w.append(d.thread);
+                w.append(" ----\n");
+                title = true;
+                tid = d.threadId;
+            }
+            w.appendTime(d.sec, d.nsec);
+            w.append(" [");
+            w.append(LogLevel::ToString((LogLevel::Level)d.level));
+            w.append("] [");
+            w.append(d.logger);
+            w.append("] ");
+            w.appendUint(d.threadId);
+            w.append(' ');
+            w.append(d.file);
+            w.append(':');
+            w.appendInt(d.line);
+            w.append(' ');
+            w.append(d.msg, d.msgLen);
+            w.append('\n');
+            ++count;
+        }
+    }
+    return count;
+}
+
+}
@@ -0,0 +1,46 @@
+#ifndef __LCH_FLIGHT_RECORDER_H__
+#define __LCH_FLIGHT_RECORDER_H__
+
+#include <string>
+#include <atomic>
+#include "log.h"
+
+namespace lch {
+
+//飞行记录器 每个线程在内存里保留最近的若干条日志，包括低于Logger级别、没有输出的日志，
+//进程崩溃(SIGSEGV SIGABRT SIGBUS SIGFPE SIGILL)或者输出FATAL日志时写到文件里
+//记录时只拷贝到线程第一次记录时分配好的槽中，不格式化；
+//写文件只用open/write和栈上的缓冲区，不分配内存，可以在信号处理函数中调用
+//开启后日志宏对level以上的语句都会生成事件，LCH_LOG_ENABLED也随之返回true
+class FlightRecorder {
+public:
+    enum {
+        MSG_SIZE = 256,     //每条日志保留的消息长度，超出部分截断
+        NAME_SIZE = 32,     //Logger名和线程名保留的长度
+        FILE_SIZE = 64      //文件名保留的长度，超出时保留末尾
+    };
+
+    //开启记录 events为每个线程保留的条数，install_signal为true时接管崩溃信号
+    //重复调用时更新文件名和级别，已经分配的线程缓冲区大小不变
+    static void Enable(const std::string& dump_file, size_t events = 256
+                       , LogLevel::Level level = LogLevel::DEBUG, bool install_signal = true);
+    //停止记录并恢复原来的信号处理函数，已记录的内容保留
+    static void Disable();
+    static bool IsEnabled() { return GetLevel() <= LogLevel::FATAL; }
+    //需要记录的最低级别，关闭时大于FATAL
+    static int GetLevel() { return s_level.load(std::memory_order_relaxed); }
+
+    //记录一条日志，由日志宏在交给Logger之前调用
+    static void Record(LogLevel::Level level, const LogEvent& event);
+    //把所有线程的记录按线程写到开启时指定的文件(截断重写)，异步信号安全
+    //返回写出的条数，失败或者另一个线程正在写时返回-1
+    static int Dump();
+    //写到已经打开的fd
+    static int Dump(int fd);
+private:
+    static std::atomic<int> s_level;
+};
+
+}
+
+#endif // !__LCH_FLIGHT_RECORDER_H__
@@ -3,7 +3,15 @@
 
 #include "lch/config.h"
 #include "lch/log.h"
+#include "lch/binlog.h"
+#include "lch/log_index.h"
+#include "lch/flight_recorder.h"
+#include "lch/socket_appender.h"
+#include "lch/shm_log.h"
+#include "lch/uring_appender.h"
+#include "lch/compress_appender.h"
 #include "lch/util.h"
+#include "lch/macros.h"
 #include "lch/thread.h"
 
 
@@ -1,6 +1,30 @@
 #include "log.h"
+#include "binlog.h"
+#include "log_index.h"
+#include "flight_recorder.h"
+#include "socket_appender.h"
+#include "shm_log.h"
+#include "uring_appender.h"
+#include "compress_appender.h"
 
 #include "config.h"
+#include "thread.h"
+#include <sched.h>
+#include <string.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <list>
+#include <cmath>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 namespace lch{
 
@@ -43,26 +67,141 @@ LogLevel::Level LogLevel::FromString(const std::string& str) {
 #undef XX
 }
 
+/*******************************LogCallSite*********************************/
+//从1开始，保证未初始化的调用点(m_state为0)不会命中
+std::atomic<uint32_t> LogCallSite::s_generation(1);
+
+bool LogCallSite::refresh(const std::shared_ptr<Logger>& logger, LogLevel::Level level) {
+    //先取代数再读级别，读到的级别不会比代数旧
+    uint32_t gen = s_generation.load(std::memory_order_acquire);
+    //飞行记录器要记下低于Logger级别的日志
+    bool enabled = logger->getLevel() <= level || FlightRecorder::GetLevel() <= level;
+    Logger* expected = nullptr;
+    if (m_logger.compare_exchange_strong(expected, logger.get()) || expected == logger.get()) {
+        m_state.store(MakeState(gen, level, enabled), std::memory_order_release);
+    }
+    return enabled;
+}
+
+//0保留给未分配的调用点
+static std::atomic<uint32_t> s_site_id(1);
+
+uint32_t LogCallSite::NextId() {
+    return s_site_id.fetch_add(1);
+}
+
+uint32_t LogCallSite::allocId() {
+    uint32_t expected = 0;
+    uint32_t id = NextId();
+    //多个线程同时分配时只有一个能写入，其余的编号作废
+    if (m_id.compare_exchange_strong(expected, id)) {
+        return id;
+    }
+    return expected;
+}
+
+/*******************************LogRateLimiter*********************************/
+uint64_t LogRateLimiter::everyMs(uint64_t ms) {
+    //加1保证第一次一定输出
+    uint64_t now = GetMonotonicNS() + 1;
+    uint64_t last = m_last.load(std::memory_order_relaxed);
+    if (last && now - last < ms * 1000000) {
+        return drop();
+    }
+    //同一时刻只有一个线程能抢到
+    if (!m_last.compare_exchange_strong(last, now, std::memory_order_relaxed)) {
+        return drop();
+    }
+    return pass();
+}
+
+uint64_t LogRateLimiter::tokenBucket(double rate, uint64_t burst) {
+    if (rate <= 0) {
+        return drop();
+    }
+    uint64_t interval = 1e9 / rate;
+    uint64_t tolerance = interval * (burst ? burst : 1);
+    uint64_t now = GetMonotonicNS();
+    uint64_t tat = m_last.load(std::memory_order_relaxed);
+    while (true) {
+        uint64_t next = std::max(tat, now) + interval;
+        if (next - now > tolerance) {
+            return drop();
+        }
+        if (m_last.compare_exchange_weak(tat, next, std::memory_order_relaxed)) {
+            return pass();
+        }
+    }
+}
+
 /*******************************LogEventWrap*********************************/
 LogEventWrap::LogEventWrap(LogEvent::ptr e) 
-    :m_event(e){
+    :m_event(std::move(e)){
 
 }
 LogEventWrap::~LogEventWrap() {
-    m_event->getLogger()->log(m_event->getLevel(), m_event);
+    LogLevel::Level level = m_event->getLevel();
+    if (FlightRecorder::GetLevel() <= level) {
+        FlightRecorder::Record(level, *m_event);
+    }
+    m_event->getLogger()->log(level, m_event);
+    if (level == LogLevel::FATAL && FlightRecorder::IsEnabled()) {
+        FlightRecorder::Dump();
+    }
 }
-std::stringstream& LogEventWrap::getSS() {
+LogStream& LogEventWrap::getSS() {
     return m_event->getSS();
 }
 
+LogStream& LogEventWrap::getSS(uint64_t suppressed) {
+    LogStream& ss = m_event->getSS();
+    if (suppressed) {
+        ss << "[" << suppressed << " suppressed] ";
+    }
+    return ss;
+}
+
+bool LogEventWrap::isBinary() const {
+    return m_event->getLogger()->isBinary();
+}
+
+
+
+static void AppendUint(std::string& buf, uint64_t v) {
+    char tmp[24];
+    char* p = tmp + sizeof(tmp);
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    buf.append(p, tmp + sizeof(tmp) - p);
+}
+
+static void AppendInt(std::string& buf, int64_t v) {
+    if (v < 0) {
+        buf.push_back('-');
+        AppendUint(buf, -(uint64_t)v);
+    } else {
+        AppendUint(buf, v);
+    }
+}
 
+//尽量短地输出double，%.15g不能还原时才用%.17g
+static void AppendDouble(std::string& buf, double v) {
+    char tmp[32];
+    int n = snprintf(tmp, sizeof(tmp), "%.15g", v);
+    if (strtod(tmp, nullptr) != v) {
+        n = snprintf(tmp, sizeof(tmp), "%.17g", v);
+    }
+    buf.append(tmp, n);
+}
 
 /*******************************FormatItem*********************************/
 class MessageFormatItem : public LogFormatter::FormatItem {
 public:
     MessageFormatItem(const std::string& str = "") {}
     void format(Logger::ptr logger, std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << event->getContent();
+        os.write(event->getContentData(), event->getContentSize());
     }
 };
 
@@ -98,6 +237,24 @@ public:
     }
 };
 
+class ThreadNameFormatItem : public LogFormatter::FormatItem {
+public:
+    ThreadNameFormatItem(const std::string& str = "") {}
+    void format(Logger::ptr logger, std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
+        os << event->getThreadName();
+    }
+};
+
+class FieldsFormatItem : public LogFormatter::FormatItem {
+public:
+    FieldsFormatItem(const std::string& str = "") {}
+    void format(Logger::ptr logger, std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
+        std::string buf;
+        event->getFields().appendText(buf);
+        os << buf;
+    }
+};
+
 class FiberIdFormatItem : public LogFormatter::FormatItem {
 public:
     FiberIdFormatItem(const std::string& str = "") {}
@@ -108,23 +265,118 @@ public:
 
 class DateTimeFormatItem : public LogFormatter::FormatItem {
 public:
+    //除strftime的格式外，支持%3 %6 %9 分别输出毫秒、微秒、纳秒
     DateTimeFormatItem(const std::string& format = "%Y:%m:%d %H:%M:%S")
         :m_format(format) {
         if (m_format.empty()) {
             m_format = "%Y:%m:%d %H:%M:%S";
         }
+        static std::atomic<uint64_t> s_id(0);
+        m_id = ++s_id;
+        parse();
     }
     void format(Logger::ptr logger, std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
+        std::string buf;
+        append(buf, event);
+        os << buf;
+    }
+
+    void append(std::string& out, const LogEvent::ptr& event) {
+        //同一秒内的日志只渲染一次strftime部分，秒以下的部分每次现算
+        Cache& cache = GetCache(m_id);
+        time_t sec = event->getTime();
+        if (cache.id != m_id || cache.sec != sec) {
+            render(cache, sec);
+        }
+        size_t offset = 0;
+        for (size_t i = 0; i < m_segments.size(); ++i) {
+            const Segment& seg = m_segments[i];
+            if (seg.digits == 0) {
+                out.append(cache.text.data() + offset, cache.lens[i]);
+                offset += cache.lens[i];
+            } else {
+                uint32_t v = event->getNanosecond();
+                for (int d = seg.digits; d < 9; ++d) {
+                    v /= 10;
+                }
+                char tmp[9];
+                for (int d = seg.digits - 1; d >= 0; --d) {
+                    tmp[d] = '0' + v % 10;
+                    v /= 10;
+                }
+                out.append(tmp, seg.digits);
+            }
+        }
+    }
+
+private:
+    struct Segment {
+        std::string format;   //strftime格式
+        int digits = 0;       //非0时表示秒以下的位数
+    };
+
+    struct Cache {
+        uint64_t id = 0;
+        time_t sec = 0;
+        std::string text;             //各strftime段渲染结果首尾相接
+        std::vector<size_t> lens;     //每段的长度
+    };
+
+    //每个线程缓存几个格式的渲染结果，按m_id直接映射
+    static Cache& GetCache(uint64_t id) {
+        static thread_local Cache s_caches[4];
+        return s_caches[id & 3];
+    }
+
+    void parse() {
+        Segment cur;
+        for (size_t i = 0; i < m_format.size(); ++i) {
+            if (m_format[i] == '%' && i + 1 < m_format.size()) {
+                char c = m_format[i + 1];
+                if (c == '3' || c == '6' || c == '9') {
+                    if (!cur.format.empty()) {
+                        m_segments.push_back(cur);
+                        cur = Segment();
+                    }
+                    Segment sub;
+                    sub.digits = c - '0';
+                    m_segments.push_back(sub);
+                    ++i;
+                    continue;
+                }
+                //%%等两个字符一起交给strftime
+                cur.format.append(m_format, i, 2);
+                ++i;
+                continue;
+            }
+            cur.format.push_back(m_format[i]);
+        }
+        if (!cur.format.empty()) {
+            m_segments.push_back(cur);
+        }
+    }
+
+    void render(Cache& cache, time_t sec) {
         struct tm tm;
-        time_t time = event->getTime();
-        localtime_r(&time, &tm);
+        localtime_r(&sec, &tm);
+        cache.id = m_id;
+        cache.sec = sec;
+        cache.text.clear();
+        cache.lens.assign(m_segments.size(), 0);
         char buf[64];
-        strftime(buf, sizeof(buf), m_format.c_str(), &tm);
-        os << buf;
+        for (size_t i = 0; i < m_segments.size(); ++i) {
+            if (m_segments[i].digits == 0) {
+                size_t len = strftime(buf, sizeof(buf), m_segments[i].format.c_str(), &tm);
+                cache.text.append(buf, len);
+                cache.lens[i] = len;
+            }
+        }
     }
 
 private:
     std::string m_format;
+    uint64_t m_id = 0;
+    std::vector<Segment> m_segments;
 };
 
 class FilenameFormatItem : public LogFormatter::FormatItem {
@@ -147,7 +399,8 @@ class NewLineFormatItem : public LogFormatter::FormatItem {
 public:
     NewLineFormatItem(const std::string& str = "") {}
     void format(Logger::ptr logger, std::ostream& os, LogLevel::Level level, LogEvent::ptr event) override {
-        os << std::endl;
+        //不用std::endl，是否刷新由appender决定
+        os << '\n';
     }
 };
 
@@ -175,22 +428,82 @@ public:
 /*******************************LogEvent*********************************/
 
 LogEvent::LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level,const char* file, int32_t line, uint32_t elapse
-    , uint32_t threadId, uint32_t fiberId, uint64_t time)
+    , uint32_t threadId, uint32_t fiberId, uint64_t time, uint32_t nsec)
     :m_file(file)
     ,m_line(line)
     ,m_elapse(elapse)
     ,m_threadId(threadId)
     ,m_fiberId(fiberId)
+    ,m_threadName(Thread::GetName())
     ,m_time(time) 
+    ,m_nsec(nsec)
     ,m_logger(logger) 
     ,m_level(level) {
-
+    m_ss.setFields(&m_fields);
 }
 
 LogEvent::~LogEvent() {
 
 }
 
+//每个线程缓存的LogEvent个数，异步模式下队列里还没输出的事件会占住池中的对象
+static const size_t s_event_pool_size = 8;
+
+LogEvent::ptr LogEvent::Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file
+    , int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, LogCallSite* site) {
+    static thread_local LogEvent::ptr s_pool[s_event_pool_size];
+    struct timespec ts;
+    GetRealTime(ts);
+    LogEvent::ptr* slot = nullptr;
+    for (size_t i = 0; i < s_event_pool_size; ++i) {
+        LogEvent::ptr& e = s_pool[i];
+        if (!e) {
+            e.reset(new LogEvent(logger, level, file, line, elapse, threadId, fiberId, ts.tv_sec, ts.tv_nsec));
+            slot = &e;
+            break;
+        }
+        //引用计数为1说明只有池自己持有，其他线程已经用完了
+        if (e.use_count() == 1) {
+            std::atomic_thread_fence(std::memory_order_acquire);
+            e->reset(logger, level, file, line, elapse, threadId, fiberId, ts.tv_sec, ts.tv_nsec);
+            slot = &e;
+            break;
+        }
+    }
+    if (!slot) {
+        LogEvent::ptr e(new LogEvent(logger, level, file, line, elapse, threadId, fiberId, ts.tv_sec, ts.tv_nsec));
+        e->m_site = site;
+        return e;
+    }
+    (*slot)->m_site = site;
+    return *slot;
+}
+
+void LogEvent::reset(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file, int32_t line
+    , uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time, uint32_t nsec) {
+    m_file = file;
+    m_line = line;
+    m_elapse = elapse;
+    m_threadId = threadId;
+    m_fiberId = fiberId;
+    //池中的事件只被同一个线程复用，线程名一般不变，相同时省掉拷贝
+    const std::string& name = Thread::GetName();
+    if (m_threadName != name) {
+        m_threadName = name;
+    }
+    m_time = time;
+    m_nsec = nsec;
+    m_level = level;
+    //同一个Logger时跳过shared_ptr赋值，省掉一次原子加减
+    if (m_logger != logger) {
+        m_logger = logger;
+    }
+    m_site = nullptr;
+    m_binaryFormat = nullptr;
+    m_ss.reset();
+    m_fields.clear();
+}
+
 void LogEvent::format(const char* fmt, ...) {
     va_list al;
     va_start(al, fmt);
@@ -198,164 +511,1851 @@ void LogEvent::format(const char* fmt, ...) {
     va_end(al);
 }
 void LogEvent::format(const char* fmt, va_list al) {
-    char* buf = nullptr;
-    int len = vasprintf(&buf, fmt, al);
-    if (len != -1) {
-        m_ss << std::string(buf, len);
-        free(buf);
+    m_ss.vformat(fmt, al);
+}
+
+/*******************************LogFields*********************************/
+LogFields::Field& LogFields::push(const char* key, Type type) {
+    size_t len = strlen(key);
+    m_fields.emplace_back();
+    Field& f = m_fields.back();
+    f.type = type;
+    f.key = m_data.size();
+    f.keyLen = len;
+    f.str = 0;
+    f.strLen = 0;
+    f.u = 0;
+    m_data.append(key, len);
+    m_data.push_back('\0');
+    return f;
+}
+
+void LogFields::addString(const char* key, const char* v, size_t len) {
+    Field& f = push(key, STRING);
+    f.str = m_data.size();
+    f.strLen = len;
+    m_data.append(v, len);
+    m_data.push_back('\0');
+}
+
+void LogFields::appendText(std::string& buf) const {
+    for (size_t i = 0; i < m_fields.size(); ++i) {
+        const Field& f = m_fields[i];
+        if (i) {
+            buf.push_back(' ');
+        }
+        buf.append(getKey(f), f.keyLen);
+        buf.push_back('=');
+        switch (f.type) {
+        case INT:
+            AppendInt(buf, f.i);
+            break;
+        case UINT:
+            AppendUint(buf, f.u);
+            break;
+        case DOUBLE:
+            AppendDouble(buf, f.d);
+            break;
+        case BOOL:
+            buf.append(f.b ? "true" : "false");
+            break;
+        case STRING:
+            buf.append(getString(f), f.strLen);
+            break;
+        }
+    }
+}
+
+/*******************************LogStream*********************************/
+LogStreamBuf::LogStreamBuf() {
+    setp(m_inline, m_inline + INLINE_SIZE);
+}
+
+void LogStreamBuf::reset() {
+    //超大的日志扩展出来的空间不长期占用
+    if (m_heap.capacity() > 64 * 1024) {
+        std::vector<char>().swap(m_heap);
+    }
+    setp(m_inline, m_inline + INLINE_SIZE);
+}
+
+void LogStreamBuf::reserve(size_t n) {
+    size_t used = size();
+    size_t cap = epptr() - pbase();
+    if (used + n <= cap) {
+        return;
+    }
+    size_t new_cap = cap * 2;
+    if (new_cap < used + n) {
+        new_cap = used + n;
+    }
+    if (pbase() == m_inline) {
+        m_heap.resize(new_cap);
+        memcpy(&m_heap[0], m_inline, used);
+    } else {
+        m_heap.resize(new_cap);
+    }
+    setp(&m_heap[0], &m_heap[0] + m_heap.size());
+    pbump(used);
+}
+
+LogStreamBuf::int_type LogStreamBuf::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    reserve(1);
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+    return c;
+}
+
+std::streamsize LogStreamBuf::xsputn(const char* s, std::streamsize n) {
+    reserve(n);
+    memcpy(pptr(), s, n);
+    pbump(n);
+    return n;
+}
+
+void LogStreamBuf::vformat(const char* fmt, va_list al) {
+    va_list copy;
+    va_copy(copy, al);
+    size_t room = epptr() - pptr();
+    int len = vsnprintf(pptr(), room, fmt, copy);
+    va_end(copy);
+    if (len < 0) {
+        return;
+    }
+    if ((size_t)len >= room) {
+        //vsnprintf需要额外一个字节写'\0'
+        reserve(len + 1);
+        vsnprintf(pptr(), len + 1, fmt, al);
+    }
+    pbump(len);
+}
+
+void LogStream::reset() {
+    m_buf.reset();
+    clear();
+    flags(std::ios_base::dec | std::ios_base::skipws);
+    precision(6);
+    width(0);
+    fill(' ');
+}
+
+/*******************************Logger*********************************/
+static std::atomic<uint32_t> s_logger_id(1);
+
+Logger::Logger(const std::string& name)
+    : m_name(name) 
+    , m_level(LogLevel::DEBUG)
+    , m_appenders(new AppenderList)
+    , m_async(nullptr)
+    , m_binary(nullptr)
+    , m_dedup(nullptr)
+    , m_id(s_logger_id.fetch_add(1))
+    , m_levelSet(false)
+    , m_managed(false)
+    , m_parent(nullptr) {
+    //shareptr的reset函数
+    m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+    //新Logger可能复用了已析构Logger的地址
+    LogCallSite::Invalidate();
+}
+
+Logger::~Logger() {
+    //已经没有其他线程能访问到这个Logger，不需要等待读者
+    if (m_asyncHolder) {
+        m_asyncHolder->stop();
+    }
+    if (m_dedupHolder) {
+        m_dedupHolder->stop();
+    }
+    delete m_appenders.load();
+}
+
+void Logger::publish(AppenderList* appenders) {
+    const AppenderList* old = m_appenders.exchange(appenders);
+    Rcu::Retire([old](){ delete old; });
+}
+
+void Logger::startAsync(size_t capacity, AsyncLogDispatcher::OverflowPolicy policy) {
+    {
+        Mutex::Lock lock(m_mutex);
+        if (m_asyncHolder && m_asyncHolder->getCapacity() >= capacity
+                && m_asyncHolder->getPolicy() == policy) {
+            return;
+        }
+    }
+    stopAsync();
+    AsyncLogDispatcher::ptr async(new AsyncLogDispatcher(shared_from_this(), capacity, policy));
+    async->start();
+    Mutex::Lock lock(m_mutex);
+    m_asyncHolder = async;
+    m_async = async.get();
+}
+
+void Logger::stopAsync() {
+    AsyncLogDispatcher::ptr async;
+    {
+        Mutex::Lock lock(m_mutex);
+        async.swap(m_asyncHolder);
+        m_async = nullptr;
+    }
+    if (async) {
+        //等还拿着旧指针的生产者push完，再把队列输出干净
+        Rcu::Synchronize();
+        async->stop();
+    }
+}
+
+AsyncLogDispatcher::ptr Logger::getAsync() {
+    Mutex::Lock lock(m_mutex);
+    return m_asyncHolder;
+}
+
+void Logger::startDedup(uint32_t timeout) {
+    {
+        Mutex::Lock lock(m_mutex);
+        if (m_dedupHolder && m_dedupHolder->getTimeout() == timeout) {
+            return;
+        }
+    }
+    stopDedup();
+    LogDeduplicator::ptr dedup(new LogDeduplicator(shared_from_this(), timeout));
+    dedup->start();
+    Mutex::Lock lock(m_mutex);
+    m_dedupHolder = dedup;
+    m_dedup = dedup.get();
+}
+
+void Logger::stopDedup() {
+    LogDeduplicator::ptr dedup;
+    {
+        Mutex::Lock lock(m_mutex);
+        dedup.swap(m_dedupHolder);
+        m_dedup = nullptr;
+    }
+    if (dedup) {
+        //等还拿着旧指针的写者离开，再输出没报告的重复次数
+        Rcu::Synchronize();
+        dedup->stop();
+    }
+}
+
+LogDeduplicator::ptr Logger::getDedup() {
+    Mutex::Lock lock(m_mutex);
+    return m_dedupHolder;
+}
+
+bool Logger::startBinary(const std::string& file) {
+    {
+        Mutex::Lock lock(m_mutex);
+        if (m_binaryHolder && m_binaryHolder->getFilename() == file) {
+            return true;
+        }
+    }
+    BinLogWriter::ptr writer(new BinLogWriter(file));
+    if (!writer->isOpen()) {
+        return false;
+    }
+    stopBinary();
+    Mutex::Lock lock(m_mutex);
+    m_binaryHolder = writer;
+    m_binary = writer.get();
+    return true;
+}
+
+void Logger::stopBinary() {
+    BinLogWriter::ptr writer;
+    {
+        Mutex::Lock lock(m_mutex);
+        writer.swap(m_binaryHolder);
+        m_binary = nullptr;
+    }
+    if (writer) {
+        //等还在写的线程离开，析构时把缓冲区刷到文件
+        Rcu::Synchronize();
+    }
+}
+
+std::string Logger::getBinaryFile() {
+    Mutex::Lock lock(m_mutex);
+    return m_binaryHolder ? m_binaryHolder->getFilename() : "";
+}
+
+void Logger::setFormatter(LogFormatter::ptr val) {
+    Mutex::Lock lock(m_mutex);
+    m_formatter = val;
+
+    for(auto& i : *m_appenders.load()) {
+        i->updateFormatter(m_formatter);
+    }
+}
+void Logger::setFormatter(const std::string& val) {
+    LogFormatter::ptr new_val(new LogFormatter(val));
+    if (new_val->isError()) {
+        std::cout << "Logger setFormatter name=" << m_name
+                  << " value = " << val << " invalid formatter" << std::endl;
+        return;
+    }
+    setFormatter(new_val);
+}
+
+LogFormatter::ptr Logger::getFormatter() {
+    Mutex::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+std::string Logger::toYamlString() {
+    Mutex::Lock lock(m_mutex);
+    YAML::Node node;
+    node["name"] = m_name;
+    if(getLevel() != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(getLevel());
+    }
+    if(m_formatter) {
+        node["formatter"] = m_formatter->getPattern();
+    }
+    if(m_asyncHolder) {
+        node["async"] = true;
+        node["queue_size"] = m_asyncHolder->getCapacity();
+        node["overflow"] = AsyncLogDispatcher::ToString(m_asyncHolder->getPolicy());
+    }
+    if(m_binaryHolder) {
+        node["binary"] = m_binaryHolder->getFilename();
+    }
+    if(m_dedupHolder) {
+        node["dedup"] = m_dedupHolder->getTimeout();
+    }
+
+    for(auto& i : *m_appenders.load()) {
+        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+
+void Logger::setLevel(LogLevel::Level level) {
+    //先写级别再增加代数，读到新代数的调用点一定读到新级别
+    m_level.store(level, std::memory_order_relaxed);
+    m_levelSet.store(true, std::memory_order_relaxed);
+    LogCallSite::Invalidate();
+    changed();
+}
+
+void Logger::inheritLevel() {
+    m_levelSet.store(false, std::memory_order_relaxed);
+    changed();
+}
+
+void Logger::changed() {
+    if (m_managed) {
+        LoggerMgr::GetInstance()->resolve();
+    }
+}
+
+void Logger::addAppender(LogAppender::ptr appender) {
+    {
+        Mutex::Lock lock(m_mutex);
+        if (!appender->getFormatter()) {
+            appender->setFormatter(m_formatter);
+        }
+        AppenderList* appenders = new AppenderList(*m_appenders.load());
+        appenders->push_back(appender);
+        publish(appenders);
+    }
+    changed();
+}
+void Logger::delAppender(LogAppender::ptr appender) {
+    {
+        Mutex::Lock lock(m_mutex);
+        AppenderList* appenders = new AppenderList(*m_appenders.load());
+        for (auto it = appenders->begin() ; it != appenders->end(); it ++) {
+            if (*it == appender) {
+                appenders->erase(it);
+                break;
+            }
+        }
+        publish(appenders);
+    }
+    changed();
+}
+
+void Logger::clearAppender() {
+    {
+        Mutex::Lock lock(m_mutex);
+        publish(new AppenderList);
+    }
+    changed();
+}
+
+void Logger::setAppenders(const AppenderList& appenders) {
+    {
+        Mutex::Lock lock(m_mutex);
+        for (auto& i : appenders) {
+            if (!i->getFormatter()) {
+                i->setFormatter(m_formatter);
+            }
+        }
+        publish(new AppenderList(appenders));
+    }
+    changed();
+}
+
+void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level.load(std::memory_order_relaxed)) {
+        Rcu::ReadGuard guard;
+        LogDeduplicator* dedup = m_dedup.load();
+        if (dedup) {
+            LogEvent::ptr summary;
+            if (!dedup->check(level, event, summary)) {
+                return;
+            }
+            if (summary) {
+                dispatch(summary->getLevel(), summary);
+            }
+        }
+        dispatch(level, event);
+    }
+}
+
+void Logger::dispatch(LogLevel::Level level, LogEvent::ptr event) {
+    Rcu::ReadGuard guard;
+    AsyncLogDispatcher* async = m_async.load();
+    if (async) {
+        async->push(level, event);
+        return;
     }
+    doLog(level, event);
 }
 
-/*******************************Logger*********************************/
-Logger::Logger(const std::string& name)
-    : m_name(name) 
-    , m_level(LogLevel::DEBUG){
-    //shareptr的reset函数
-    m_formatter.reset(new LogFormatter("%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n"));
+//一条日志最多缓存几种格式化结果，超出的appender各自格式化
+static const size_t s_shared_formats = 4;
+
+void Logger::doLog(LogLevel::Level level, LogEvent::ptr event) {
+    Rcu::ReadGuard guard;
+    BinLogWriter* binary = m_binary.load();
+    if (binary) {
+        binary->write(*this, level, event);
+        return;
+    }
+    if (event->getBinaryFormat()) {
+        //编码参数之后二进制模式被关掉了，在这里补上格式化
+        std::string content = BinLogArgs::Decode(event->getBinaryFormat()
+                , event->getContentData(), event->getContentSize());
+        event->setBinaryFormat(nullptr);
+        event->getSS().reset();
+        event->getSS().append(content.c_str(), content.size());
+    }
+    const AppenderList* appenders = m_appenders.load();
+
+    if (!appenders->empty()) {
+        auto self = shared_from_this();
+        //同一个格式器对一条日志只格式化一次，结果交给所有使用它的appender
+        //格式化结果放在线程本地的缓冲区里，appender里再写日志时(嵌套)不共享
+        static thread_local std::string s_bufs[s_shared_formats];
+        static thread_local int s_depth = 0;
+        LogFormatter* formats[s_shared_formats];
+        size_t nformats = 0;
+        ++s_depth;
+        for (auto& i : *appenders) {
+            if (level < i->m_level) {
+                continue;
+            }
+            LogFormatter* fmt = i->m_shareFormatted && s_depth == 1 ? i->formatter() : nullptr;
+            if (!fmt) {
+                i->log(self, level, event);
+                continue;
+            }
+            size_t idx = 0;
+            while (idx < nformats && formats[idx] != fmt) {
+                ++idx;
+            }
+            if (idx == nformats) {
+                if (nformats == s_shared_formats) {
+                    i->log(self, level, event);
+                    continue;
+                }
+                formats[nformats++] = fmt;
+                s_bufs[idx].clear();
+                fmt->format(s_bufs[idx], self, level, event);
+            }
+            i->logFormatted(self, level, event, s_bufs[idx]);
+        }
+        --s_depth;
+    } else {
+        //级别已经在创建或配置时继承过了，上级不再判断级别
+        Logger* parent = m_parent.load();
+        if (parent) {
+            parent->dispatch(level, event);
+        }
+    }
+}
+
+void Logger::debug(LogEvent::ptr event) {
+    log(LogLevel::DEBUG, event);
+}
+void Logger::info(LogEvent::ptr event) {
+    log(LogLevel::INFO, event); 
+}
+void Logger::warn(LogEvent::ptr event) {
+    log(LogLevel::WARN, event);
+}
+void Logger::error(LogEvent::ptr event) {
+    log(LogLevel::ERROR, event);
+}
+void Logger::fatal(LogEvent::ptr event) {
+    log(LogLevel::FATAL, event);
+}
+
+
+/*******************************AsyncLogDispatcher*********************************/
+const char* AsyncLogDispatcher::ToString(OverflowPolicy policy) {
+    switch (policy) {
+    case BLOCK:
+        return "block";
+    case DROP_NEWEST:
+        return "drop_newest";
+    case DROP_COUNT:
+        return "drop_count";
+    }
+    return "block";
+}
+
+AsyncLogDispatcher::OverflowPolicy AsyncLogDispatcher::FromString(const std::string& str) {
+    if (str == "drop_newest" || str == "DROP_NEWEST") {
+        return DROP_NEWEST;
+    }
+    if (str == "drop_count" || str == "DROP_COUNT") {
+        return DROP_COUNT;
+    }
+    return BLOCK;
+}
+
+AsyncLogDispatcher::AsyncLogDispatcher(std::shared_ptr<Logger> logger, size_t capacity, OverflowPolicy policy)
+    :m_logger(logger)
+    ,m_queue(capacity)
+    ,m_policy(policy)
+    ,m_sleeping(false)
+    ,m_stopping(false)
+    ,m_dropped(0) {
+}
+
+AsyncLogDispatcher::~AsyncLogDispatcher() {
+    stop();
+}
+
+void AsyncLogDispatcher::start() {
+    if (m_thread) {
+        return;
+    }
+    //线程回调持有自身的引用，保证Logger在后台线程中析构时对象依然有效
+    AsyncLogDispatcher::ptr self = shared_from_this();
+    std::string name = "log_";
+    auto logger = m_logger.lock();
+    if (logger) {
+        name += logger->getName();
+    }
+    m_thread.reset(new Thread([self](){ self->run(); }, name));
+}
+
+void AsyncLogDispatcher::stop() {
+    if (!m_thread || m_stopping.exchange(true)) {
+        return;
+    }
+    m_sem.notify();
+    //Logger可能在后台线程中析构，此时只设置标志，由线程自己退出
+    if (Thread::GetThis() != m_thread.get()) {
+        m_thread->join();
+    }
+}
+
+bool AsyncLogDispatcher::push(LogLevel::Level level, LogEvent::ptr event) {
+    Item item;
+    item.level = level;
+    item.event = event;
+    int spins = 0;
+    while (!m_queue.push(item)) {
+        if (m_policy != BLOCK || m_stopping) {
+            ++m_dropped;
+            return false;
+        }
+        notify();
+        if (++spins < 64) {
+            sched_yield();
+        } else {
+            usleep(100);
+        }
+    }
+    notify();
+    return true;
+}
+
+void AsyncLogDispatcher::notify() {
+    //与run中的m_sleeping、队列检查配对，保证不会丢失唤醒
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed) && m_sleeping.exchange(false)) {
+        m_sem.notify();
+    }
+}
+
+size_t AsyncLogDispatcher::drain() {
+    Logger::ptr logger = m_logger.lock();
+    size_t count = 0;
+    Item item;
+    while (m_queue.pop(item)) {
+        if (logger) {
+            logger->doLog(item.level, item.event);
+        }
+        item.event.reset();
+        ++count;
+    }
+
+    uint64_t dropped = m_dropped;
+    if (logger && m_policy == DROP_COUNT && dropped != m_reported) {
+        LogEvent::ptr event = LogEvent::Create(logger, LogLevel::WARN, __FILE__, __LINE__, GetElapsedMS(),
+                    GetThreadId(), GetFiberId());
+        event->getSS() << "async log queue full, dropped " << (dropped - m_reported) << " events";
+        m_reported = dropped;
+        logger->doLog(LogLevel::WARN, event);
+    }
+    return count;
+}
+
+void AsyncLogDispatcher::run() {
+    while (true) {
+        if (drain()) {
+            continue;
+        }
+        if (m_stopping) {
+            drain();
+            break;
+        }
+        m_sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!m_queue.empty() || m_stopping) {
+            //生产者已经把标志清掉的话，它一定会notify，要把这次notify消耗掉
+            if (m_sleeping.exchange(false)) {
+                continue;
+            }
+        }
+        m_sem.wait();
+    }
+}
+
+/*******************************LogDeduplicator*********************************/
+LogDeduplicator::LogDeduplicator(std::shared_ptr<Logger> logger, uint32_t timeout)
+    :m_logger(logger)
+    ,m_timeout(timeout)
+    ,m_stopping(false)
+    ,m_suppressed(0) {
+}
+
+LogDeduplicator::~LogDeduplicator() {
+    stop();
+}
+
+uint64_t LogDeduplicator::Hash(LogLevel::Level level, const LogEvent& event) {
+    //调用点用文件名指针代替文件名，内容按8字节一组混合
+    uint64_t h = (uint64_t)(uintptr_t)event.getFile() * 0x9E3779B97F4A7C15ull;
+    h ^= ((uint64_t)(uint32_t)event.getLine() << 8) | level;
+    const char* p = event.getContentData();
+    size_t n = event.getContentSize();
+    h ^= n * 0xC2B2AE3D27D4EB4Full;
+    while (n >= 8) {
+        uint64_t k;
+        memcpy(&k, p, 8);
+        h = (h ^ k) * 0xFF51AFD7ED558CCDull;
+        h ^= h >> 29;
+        p += 8;
+        n -= 8;
+    }
+    if (n) {
+        uint64_t k = 0;
+        memcpy(&k, p, n);
+        h = (h ^ k) * 0xFF51AFD7ED558CCDull;
+    }
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h ? h : 1;
+}
+
+void LogDeduplicator::start() {
+    if (m_thread) {
+        return;
+    }
+    //线程回调持有自身的引用，保证Logger在后台线程中析构时对象依然有效
+    LogDeduplicator::ptr self = shared_from_this();
+    std::string name = "dedup_";
+    auto logger = m_logger.lock();
+    if (logger) {
+        name += logger->getName();
+    }
+    m_thread.reset(new Thread([self](){ self->run(); }, name));
+}
+
+void LogDeduplicator::stop() {
+    if (!m_thread || m_stopping.exchange(true)) {
+        return;
+    }
+    m_sem.notify();
+    //Logger可能在后台线程中析构，此时只设置标志，由线程自己退出
+    if (Thread::GetThis() != m_thread.get()) {
+        m_thread->join();
+    }
+    flush();
+}
+
+bool LogDeduplicator::check(LogLevel::Level level, const LogEvent::ptr& event, LogEvent::ptr& summary) {
+    uint64_t h = Hash(level, *event);
+    Mutex::Lock lock(m_mutex);
+    if (h == m_hash) {
+        ++m_suppressed;
+        if (m_repeats++ == 0) {
+            //记下第一次重复的位置，由后台线程按时输出
+            m_firstRepeat = GetMonotonicNS();
+            m_level = level;
+            m_file = event->getFile();
+            m_line = event->getLine();
+            m_threadId = event->getThreadId();
+            m_fiberId = event->getFiberId();
+            m_threadName = event->getThreadName();
+            lock.unlock();
+            m_sem.notify();
+        }
+        return false;
+    }
+    m_hash = h;
+    if (m_repeats) {
+        Logger::ptr logger = m_logger.lock();
+        if (logger) {
+            summary = takeSummary(logger);
+        }
+        m_repeats = 0;
+    }
+    return true;
+}
+
+void LogDeduplicator::flush() {
+    Logger::ptr logger = m_logger.lock();
+    if (!logger) {
+        return;
+    }
+    Mutex::Lock lock(m_mutex);
+    if (!m_repeats) {
+        return;
+    }
+    LogEvent::ptr summary = takeSummary(logger);
+    lock.unlock();
+    logger->dispatch(summary->getLevel(), summary);
+}
+
+LogEvent::ptr LogDeduplicator::takeSummary(const std::shared_ptr<Logger>& logger) {
+    LogEvent::ptr event = LogEvent::Create(logger, m_level, m_file, m_line, GetElapsedMS()
+                , m_threadId, m_fiberId);
+    event->setThreadName(m_threadName);
+    event->getSS() << "last message repeated " << m_repeats << " times";
+    m_repeats = 0;
+    return event;
+}
+
+void LogDeduplicator::run() {
+    while (!m_stopping) {
+        //有没报告的重复时睡到该输出的时候，否则等第一次重复
+        uint32_t timeout = 0;
+        bool due = false;
+        {
+            Mutex::Lock lock(m_mutex);
+            if (m_repeats) {
+                uint64_t now = GetMonotonicNS();
+                uint64_t deadline = m_firstRepeat + (uint64_t)m_timeout * 1000000;
+                if (now < deadline) {
+                    timeout = (deadline - now) / 1000000 + 1;
+                } else {
+                    due = true;
+                }
+            }
+        }
+        if (due) {
+            flush();
+        } else if (timeout) {
+            m_sem.wait(timeout);
+        } else {
+            m_sem.wait();
+        }
+    }
+}
+
+/*******************************LogAppender*********************************/
+void LogAppender::setFormatter(LogFormatter::ptr val) {
+    Mutex::Lock lock(m_mutex);
+    m_hasFormatter = !!val;
+    lock.unlock();
+    updateFormatter(val);
+}
+
+LogFormatter::ptr LogAppender::getFormatter() {
+    Mutex::Lock lock(m_mutex);
+    return m_formatter;
+}
+
+void LogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    log(logger, level, event);
+}
+
+void LogAppender::updateFormatter(LogFormatter::ptr val) {
+    Mutex::Lock lock(m_mutex);
+    LogFormatter::ptr old = m_formatter;
+    m_formatter = val;
+    m_formatterPtr = val.get();
+    if (old) {
+        Rcu::Retire([old](){});
+    }
+}
+
+FileLogAppender::FileLogAppender(const std::string& filename, uint32_t index_records, uint64_t index_bytes)
+    :LogAppender(true)
+    ,m_filename(filename)
+    ,m_indexRecords(index_records)
+    ,m_indexBytes(index_bytes) {
+    if (index_records || index_bytes) {
+        m_index.reset(new LogIndexWriter(LogIndex::IndexFile(filename), index_records, index_bytes));
+    }
+    reopen();
+}
+
+void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void FileLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    //多个线程共用一个ofstream，写入要加锁，索引里的偏移也要和写入的顺序一致
+    Mutex::Lock lock(m_mutex);
+    //每条日志写完都flush，进程崩溃时已经返回的日志不会留在缓冲区里丢失
+    m_filestream.write(text.data(), text.size());
+    m_filestream.flush();
+    if (!m_index) {
+        return;
+    }
+    m_index->append(m_offset, text.size(), event->getTime() * 1000000 + event->getNanosecond() / 1000
+                    , level, event->getLogger()->getName());
+    m_offset += text.size();
+}
+
+
+std::string FileLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "FileLogAppender";
+    node["file"] = m_filename;
+    if (m_indexRecords) {
+        node["index_records"] = m_indexRecords;
+    }
+    if (m_indexBytes) {
+        node["index_bytes"] = m_indexBytes;
+    }
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if( m_hasFormatter && fmt ) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/*******************************ConsoleLogAppender*********************************/
+//写满整块数据，被信号打断或者只写了一部分时继续写
+static void WriteFull(int fd, struct iovec* iov, int cnt) {
+    while (cnt > 0) {
+        ssize_t n = writev(fd, iov, cnt);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+}
+
+struct ConsoleLogAppender::Buffer {
+    Buffer(int f, size_t cap, uint32_t ival)
+        :fd(f)
+        ,capacity(cap)
+        ,interval(ival)
+        ,lastFlush(GetMonotonicNS() / 1000000) {
+        data.reserve(capacity);
+    }
+
+    ~Buffer() {
+        flush();
+    }
+
+    //now为true时连同缓冲区中已有的内容立即写出
+    void append(const std::string& line, bool now) {
+        Mutex::Lock lock(mutex);
+        if (now || data.size() + line.size() > capacity) {
+            struct iovec iov[2];
+            int cnt = 0;
+            if (!data.empty()) {
+                iov[cnt].iov_base = (void*)data.data();
+                iov[cnt++].iov_len = data.size();
+            }
+            iov[cnt].iov_base = (void*)line.data();
+            iov[cnt++].iov_len = line.size();
+            WriteFull(fd, iov, cnt);
+            data.clear();
+            lastFlush = GetMonotonicNS() / 1000000;
+        } else {
+            data.append(line);
+        }
+    }
+
+    void flush() {
+        Mutex::Lock lock(mutex);
+        flushUnlocked();
+    }
+
+    void flushUnlocked() {
+        if (!data.empty()) {
+            struct iovec iov;
+            iov.iov_base = (void*)data.data();
+            iov.iov_len = data.size();
+            WriteFull(fd, &iov, 1);
+            data.clear();
+        }
+        lastFlush = GetMonotonicNS() / 1000000;
+    }
+
+    //由刷新线程调用
+    void tick(uint64_t now_ms) {
+        Mutex::Lock lock(mutex);
+        if (now_ms - lastFlush >= interval) {
+            flushUnlocked();
+        }
+    }
+
+    int fd;
+    size_t capacity;
+    uint32_t interval;
+    uint64_t lastFlush;
+    std::string data;
+    Mutex mutex;
+};
+
+namespace {
+
+//按时间刷新控制台缓冲区的后台线程，精度为s_flush_tick_ms
+//不析构，进程退出时由appender自己的析构刷新
+static const uint32_t s_flush_tick_ms = 50;
+
+class LogFlushTicker {
+public:
+    static LogFlushTicker* GetInstance() {
+        static LogFlushTicker* s_ticker = new LogFlushTicker;
+        return s_ticker;
+    }
+
+    void add(std::weak_ptr<ConsoleLogAppender::Buffer> buffer) {
+        Mutex::Lock lock(m_mutex);
+        m_buffers.push_back(buffer);
+    }
+private:
+    LogFlushTicker() {
+        m_thread.reset(new Thread(std::bind(&LogFlushTicker::run, this), "log_flush"));
+    }
+
+    void run() {
+        std::vector<std::shared_ptr<ConsoleLogAppender::Buffer> > buffers;
+        while (true) {
+            usleep(s_flush_tick_ms * 1000);
+            {
+                Mutex::Lock lock(m_mutex);
+                for (auto it = m_buffers.begin(); it != m_buffers.end();) {
+                    auto buffer = it->lock();
+                    if (buffer) {
+                        buffers.push_back(buffer);
+                        ++it;
+                    } else {
+                        it = m_buffers.erase(it);
+                    }
+                }
+            }
+            uint64_t now = GetMonotonicNS() / 1000000;
+            for (auto& i : buffers) {
+                i->tick(now);
+            }
+            //appender可能已经被删掉，最后一个引用在这里释放
+            buffers.clear();
+        }
+    }
+private:
+    Mutex m_mutex;
+    std::list<std::weak_ptr<ConsoleLogAppender::Buffer> > m_buffers;
+    Thread::ptr m_thread;
+};
+
+}
+
+const char* ConsoleLogAppender::ToString(FlushPolicy policy) {
+    switch (policy) {
+        case LINE:
+            return "line";
+        case BLOCK:
+            return "block";
+        default:
+            return "auto";
+    }
+}
+
+ConsoleLogAppender::FlushPolicy ConsoleLogAppender::FromString(const std::string& str) {
+    if (str == "line") {
+        return LINE;
+    }
+    if (str == "block") {
+        return BLOCK;
+    }
+    return AUTO;
+}
+
+ConsoleLogAppender::ConsoleLogAppender(int fd, FlushPolicy policy, size_t buffer_size
+        , uint32_t flush_interval, LogLevel::Level flush_level)
+    :LogAppender(true)
+    ,m_fd(fd)
+    ,m_policy(policy)
+    ,m_bufferSize(buffer_size)
+    ,m_flushInterval(flush_interval)
+    ,m_flushLevel(flush_level) {
+    m_lineBuffered = policy == LINE || (policy == AUTO && isatty(fd));
+    m_buffer.reset(new Buffer(fd, buffer_size, flush_interval));
+    if (!m_lineBuffered && flush_interval) {
+        LogFlushTicker::GetInstance()->add(m_buffer);
+    }
+}
+
+ConsoleLogAppender::~ConsoleLogAppender() {
+    m_buffer->flush();
+}
+
+void ConsoleLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void ConsoleLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    m_buffer->append(text, m_lineBuffered || level >= m_flushLevel);
+}
+
+void ConsoleLogAppender::flush() {
+    m_buffer->flush();
+}
+
+std::string ConsoleLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "ConsoleLogAppender";
+    node["target"] = m_fd == STDERR_FILENO ? "stderr" : "stdout";
+    node["flush"] = ToString(m_policy);
+    node["buffer_size"] = m_bufferSize;
+    node["flush_interval"] = m_flushInterval;
+    node["flush_level"] = LogLevel::ToString(m_flushLevel);
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+bool FileLogAppender::reopen() {
+    Mutex::Lock lock(m_mutex);
+    if (m_filestream) {
+        m_filestream.close();
+    }
+    m_filestream.open(m_filename, std::ios::app);
+    if (!m_index) {
+        return !!m_filestream;
+    }
+    struct stat st;
+    m_offset = stat(m_filename.c_str(), &st) == 0 ? st.st_size : 0;
+    m_index->reopen(m_offset);
+    return !!m_filestream;
+}
+
+void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void StdoutLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    //%n不再刷新，这里保持每条都刷新的行为，abort之前的日志不会留在缓冲区里
+    //需要缓冲时用ConsoleLogAppender
+    std::cout.write(text.data(), text.size());
+    std::cout.flush();
+}
+
+std::string StdoutLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "StdoutLogAppender";
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/*******************************LogFileWorker*********************************/
+namespace {
+
+//文件类Appender共用的后台线程，执行改名、映射、删除文件这类不适合放在写日志路径上的操作
+//不析构，进程退出时还没执行的任务直接丢弃
+class LogFileWorker {
+public:
+    static LogFileWorker* GetInstance() {
+        static LogFileWorker* s_worker = new LogFileWorker;
+        return s_worker;
+    }
+
+    void submit(std::function<void()> cb) {
+        {
+            Mutex::Lock lock(m_mutex);
+            m_tasks.push_back(cb);
+        }
+        m_sem.notify();
+    }
+private:
+    LogFileWorker() {
+        m_thread.reset(new Thread(std::bind(&LogFileWorker::run, this), "log_file"));
+    }
+
+    void run() {
+        while (true) {
+            m_sem.wait();
+            std::function<void()> cb;
+            {
+                Mutex::Lock lock(m_mutex);
+                if (m_tasks.empty()) {
+                    continue;
+                }
+                cb.swap(m_tasks.front());
+                m_tasks.pop_front();
+            }
+            cb();
+        }
+    }
+private:
+    Mutex m_mutex;
+    Semaphore m_sem;
+    std::list<std::function<void()> > m_tasks;
+    Thread::ptr m_thread;
+};
+
+}
+
+/*******************************RotatingFileLogAppender*********************************/
+struct RotatingFileLogAppender::File {
+    File(const std::string& name, uint64_t max_size, Interval ival, uint32_t max_files)
+        :filename(name)
+        ,maxSize(max_size)
+        ,interval(ival)
+        ,maxFiles(max_files)
+        ,fd(-1)
+        ,size(0)
+        ,nextTime(0)
+        ,rotating(false) {
+    }
+
+    ~File() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    int openFile() {
+        return ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    }
+
+    //下一个整点或者零点，不按时间切分时为最大值
+    uint64_t nextRotateTime(time_t now) const {
+        if (interval == NONE) {
+            return UINT64_MAX;
+        }
+        struct tm tm;
+        localtime_r(&now, &tm);
+        tm.tm_sec = 0;
+        tm.tm_min = 0;
+        if (interval == DAILY) {
+            tm.tm_hour = 0;
+            ++tm.tm_mday;
+        } else {
+            ++tm.tm_hour;
+        }
+        tm.tm_isdst = -1;
+        return mktime(&tm);
+    }
+
+    bool open() {
+        int f = openFile();
+        if (f < 0) {
+            return false;
+        }
+        struct stat st;
+        size = fstat(f, &st) == 0 ? st.st_size : 0;
+        nextTime = nextRotateTime(GetCurrentMS() / 1000);
+        fd = f;
+        return true;
+    }
+
+    //在后台线程执行 旧fd在所有写者离开后才关闭，这期间的日志仍写入归档文件
+    void rotate() {
+        time_t now = GetCurrentMS() / 1000;
+        struct tm tm;
+        localtime_r(&now, &tm);
+        char buf[64];
+        strftime(buf, sizeof(buf), ".%Y%m%d-%H%M%S", &tm);
+        std::string archive = filename + buf;
+        for (int i = 1; access(archive.c_str(), F_OK) == 0; ++i) {
+            archive = filename + buf + "." + std::to_string(i);
+        }
+        if (rename(filename.c_str(), archive.c_str()) && errno != ENOENT) {
+            std::cout << "log rotate rename " << filename << " to " << archive
+                      << " failed: " << strerror(errno) << std::endl;
+        }
+        int f = openFile();
+        if (f >= 0) {
+            size = 0;
+            int old = fd.exchange(f);
+            Rcu::Synchronize();
+            if (old >= 0) {
+                close(old);
+            }
+        } else {
+            std::cout << "log rotate open " << filename << " failed: "
+                      << strerror(errno) << std::endl;
+        }
+        nextTime = nextRotateTime(now);
+        removeExpired();
+        rotating = false;
+    }
+
+    //归档文件名为 文件名.年月日-时分秒[.序号]，删除最旧的
+    void removeExpired() {
+        if (maxFiles == 0) {
+            return;
+        }
+        std::string dir = ".";
+        std::string base = filename;
+        size_t pos = filename.rfind('/');
+        if (pos != std::string::npos) {
+            dir = pos ? filename.substr(0, pos) : "/";
+            base = filename.substr(pos + 1);
+        }
+        DIR* d = opendir(dir.c_str());
+        if (!d) {
+            return;
+        }
+        std::string prefix = base + ".";
+        std::vector<std::string> archives;
+        while (struct dirent* e = readdir(d)) {
+            std::string name = e->d_name;
+            if (name.size() >= prefix.size() + 15 && name.compare(0, prefix.size(), prefix) == 0
+                    && isdigit(name[prefix.size()])) {
+                archives.push_back(name);
+            }
+        }
+        closedir(d);
+        if (archives.size() <= maxFiles) {
+            return;
+        }
+        //同一秒内的归档带有.1 .2后缀，后缀按数字比较
+        std::sort(archives.begin(), archives.end(), [&prefix](const std::string& a, const std::string& b) {
+            int c = a.compare(prefix.size(), 15, b, prefix.size(), 15);
+            if (c) {
+                return c < 0;
+            }
+            return atoi(a.c_str() + std::min(a.size(), prefix.size() + 16))
+                    < atoi(b.c_str() + std::min(b.size(), prefix.size() + 16));
+        });
+        for (size_t i = 0; i < archives.size() - maxFiles; ++i) {
+            unlink((dir + "/" + archives[i]).c_str());
+        }
+    }
+
+    std::string filename;
+    uint64_t maxSize;
+    Interval interval;
+    uint32_t maxFiles;
+    std::atomic<int> fd;
+    std::atomic<uint64_t> size;
+    std::atomic<uint64_t> nextTime;
+    std::atomic<bool> rotating;
+};
+
+const char* RotatingFileLogAppender::ToString(Interval interval) {
+    switch (interval) {
+        case HOURLY:
+            return "hourly";
+        case DAILY:
+            return "daily";
+        default:
+            return "none";
+    }
+}
+
+RotatingFileLogAppender::Interval RotatingFileLogAppender::FromString(const std::string& str) {
+    if (str == "hourly") {
+        return HOURLY;
+    }
+    if (str == "daily") {
+        return DAILY;
+    }
+    return NONE;
+}
+
+RotatingFileLogAppender::RotatingFileLogAppender(const std::string& filename, uint64_t max_size
+        , Interval interval, uint32_t max_files)
+    :LogAppender(true)
+    ,m_filename(filename)
+    ,m_maxSize(max_size)
+    ,m_interval(interval)
+    ,m_maxFiles(max_files)
+    ,m_file(new File(filename, max_size, interval, max_files)) {
+    if (!m_file->open()) {
+        std::cout << "RotatingFileLogAppender open " << filename << " failed: "
+                  << strerror(errno) << std::endl;
+    }
+}
+
+void RotatingFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    static thread_local std::string s_buf;
+    s_buf.clear();
+    Rcu::ReadGuard guard;
+    formatter()->format(s_buf, logger, level, event);
+    logFormatted(logger, level, event, s_buf);
+}
+
+void RotatingFileLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    Rcu::ReadGuard guard;
+    int fd = m_file->fd.load(std::memory_order_acquire);
+    if (fd < 0) {
+        return;
+    }
+    //O_APPEND下一次write是原子追加，多个线程不需要加锁
+    ssize_t rt = ::write(fd, text.data(), text.size());
+    if (rt <= 0) {
+        return;
+    }
+    uint64_t size = m_file->size.fetch_add(rt, std::memory_order_relaxed) + rt;
+    if ((m_maxSize && size >= m_maxSize) || event->getTime() >= m_file->nextTime.load(std::memory_order_relaxed)) {
+        bool expected = false;
+        if (m_file->rotating.compare_exchange_strong(expected, true)) {
+            std::shared_ptr<File> file = m_file;
+            LogFileWorker::GetInstance()->submit([file](){ file->rotate(); });
+        }
+    }
+}
+
+void RotatingFileLogAppender::waitRotate() {
+    while (m_file->rotating.load()) {
+        sched_yield();
+    }
+}
+
+std::string RotatingFileLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "RotatingFileLogAppender";
+    node["file"] = m_filename;
+    if (m_maxSize) {
+        node["max_size"] = m_maxSize;
+    }
+    if (m_interval != NONE) {
+        node["interval"] = ToString(m_interval);
+    }
+    if (m_maxFiles) {
+        node["max_files"] = m_maxFiles;
+    }
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/*******************************MmapFileLogAppender*********************************/
+//同时保留映射的块数，写者只会用到当前块和刚跨过的上一块
+static const size_t s_mmap_slots = 4;
+
+struct MmapFileLogAppender::File : public std::enable_shared_from_this<MmapFileLogAppender::File> {
+    struct Chunk {
+        uint64_t index;
+        char* addr;
+    };
+
+    File(const std::string& name, uint64_t chunk_size)
+        :filename(name)
+        ,chunkSize(chunk_size)
+        ,fd(-1)
+        ,offset(0) {
+        for (auto& i : slots) {
+            i = nullptr;
+        }
+    }
+
+    ~File() {
+        close();
+    }
+
+    //解除所有映射并截断掉预分配但没有写入的部分，调用时不能再有写者
+    void close() {
+        Mutex::Lock lock(mutex);
+        for (auto& i : slots) {
+            unmap(i.exchange(nullptr));
+        }
+        if (fd >= 0) {
+            if (ftruncate(fd, offset)) {
+                std::cout << "MmapFileLogAppender truncate " << filename << " failed: "
+                          << strerror(errno) << std::endl;
+            }
+            ::close(fd);
+            fd = -1;
+        }
+    }
+
+    bool open() {
+        fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            return false;
+        }
+        struct stat st;
+        offset = fstat(fd, &st) == 0 ? st.st_size : 0;
+        uint64_t c = offset / chunkSize;
+        return prepare(c) && prepare(c + 1);
+    }
+
+    //映射第c块，已经映射过直接返回
+    bool prepare(uint64_t c) {
+        Mutex::Lock lock(mutex);
+        if (fd < 0) {
+            return false;
+        }
+        Chunk* chunk = slots[c % s_mmap_slots].load();
+        if (chunk && chunk->index == c) {
+            return true;
+        }
+        uint64_t begin = c * chunkSize;
+        int rt = fallocate(fd, 0, begin, chunkSize);
+        if (rt && (errno == EOPNOTSUPP || errno == ENOSYS)) {
+            struct stat st;
+            rt = fstat(fd, &st) == 0 && (uint64_t)st.st_size < begin + chunkSize
+                    ? ftruncate(fd, begin + chunkSize) : 0;
+        }
+        if (rt) {
+            std::cout << "MmapFileLogAppender extend " << filename << " failed: "
+                      << strerror(errno) << std::endl;
+            return false;
+        }
+        void* addr = mmap(nullptr, chunkSize, PROT_READ | PROT_WRITE
+                          , MAP_SHARED | MAP_POPULATE, fd, begin);
+        if (addr == MAP_FAILED) {
+            std::cout << "MmapFileLogAppender mmap " << filename << " failed: "
+                      << strerror(errno) << std::endl;
+            return false;
+        }
+        Chunk* old = slots[c % s_mmap_slots].exchange(new Chunk{c, (char*)addr});
+        if (old) {
+            //正常情况下旧块已经被release过了，这里可能在写者的读临界区内，只能延迟解除映射
+            uint64_t size = chunkSize;
+            Rcu::Retire([old, size]() {
+                munmap(old->addr, size);
+                delete old;
+            });
+        }
+        return true;
+    }
+
+    //后台线程预先映射，写者已经越过的块不再映射，避免把正在使用的块换出去
+    void prefetch(uint64_t c) {
+        if (c > offset.load(std::memory_order_relaxed) / chunkSize) {
+            prepare(c);
+        }
+    }
+
+    //解除第c块的映射，需要在读临界区之外调用
+    void release(uint64_t c) {
+        Chunk* chunk = nullptr;
+        {
+            Mutex::Lock lock(mutex);
+            chunk = slots[c % s_mmap_slots].load();
+            if (!chunk || chunk->index != c) {
+                return;
+            }
+            slots[c % s_mmap_slots] = nullptr;
+        }
+        Rcu::Synchronize();
+        unmap(chunk);
+    }
+
+    void unmap(Chunk* chunk) {
+        if (chunk) {
+            munmap(chunk->addr, chunkSize);
+            delete chunk;
+        }
+    }
+
+    Chunk* getChunk(uint64_t c) {
+        Chunk* chunk = slots[c % s_mmap_slots].load(std::memory_order_acquire);
+        if (chunk && chunk->index == c) {
+            return chunk;
+        }
+        //后台线程还没来得及映射，只能由写者自己做
+        while (prepare(c)) {
+            chunk = slots[c % s_mmap_slots].load(std::memory_order_acquire);
+            if (chunk && chunk->index == c) {
+                return chunk;
+            }
+        }
+        return nullptr;
+    }
+
+    //在读临界区内调用
+    void write(const char* data, size_t len) {
+        uint64_t off = offset.fetch_add(len, std::memory_order_relaxed);
+        uint64_t first = off / chunkSize;
+        uint64_t last = (off + len) / chunkSize;
+        while (len) {
+            Chunk* chunk = getChunk(off / chunkSize);
+            if (!chunk) {
+                return;
+            }
+            uint64_t pos = off % chunkSize;
+            size_t n = std::min<uint64_t>(len, chunkSize - pos);
+            memcpy(chunk->addr + pos, data, n);
+            data += n;
+            off += n;
+            len -= n;
+        }
+        //跨过块边界的写者负责让后台线程映射下一块、解除上一块
+        if (first != last) {
+            std::shared_ptr<File> self = shared_from_this();
+            LogFileWorker::GetInstance()->submit([self, last]() {
+                self->prefetch(last + 1);
+                self->release(last - 1);
+            });
+        }
+    }
+
+    std::string filename;
+    uint64_t chunkSize;
+    int fd;
+    std::atomic<uint64_t> offset;
+    std::atomic<Chunk*> slots[s_mmap_slots];
+    Mutex mutex;
+};
+
+MmapFileLogAppender::MmapFileLogAppender(const std::string& filename, uint64_t chunk_size)
+    :LogAppender(true)
+    ,m_filename(filename)
+    ,m_file(nullptr) {
+    uint64_t page = sysconf(_SC_PAGESIZE);
+    m_chunkSize = std::max<uint64_t>((chunk_size + page - 1) / page * page, page);
+    reopen();
 }
 
-void Logger::setFormatter(LogFormatter::ptr val) {
-    m_formatter = val;
+bool MmapFileLogAppender::reopen() {
+    //先关掉旧文件，否则没有改名时新文件会从预分配的末尾开始写，关闭期间的日志会丢弃
+    std::shared_ptr<File> old;
+    {
+        Mutex::Lock lock(m_mutex);
+        old.swap(m_fileHolder);
+        m_file = nullptr;
+    }
+    if (old) {
+        Rcu::Synchronize();
+        old->close();
+    }
 
-    for(auto& i : m_appenders) {
-        i->m_formatter = m_formatter;
+    std::shared_ptr<File> file(new File(m_filename, m_chunkSize));
+    if (!file->open()) {
+        std::cout << "MmapFileLogAppender open " << m_filename << " failed: "
+                  << strerror(errno) << std::endl;
+        return false;
     }
+    Mutex::Lock lock(m_mutex);
+    m_fileHolder = file;
+    m_file = file.get();
+    return true;
 }
-void Logger::setFormatter(const std::string& val) {
-    LogFormatter::ptr new_val(new LogFormatter(val));
-    if (new_val->isError()) {
-        std::cout << "Logger setFormatter name=" << m_name
-                  << " value = " << val << " invalid formatter" << std::endl;
+
+void MmapFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
         return;
     }
-    setFormatter(new_val);
+    static thread_local std::string s_buf;
+    s_buf.clear();
+    Rcu::ReadGuard guard;
+    formatter()->format(s_buf, logger, level, event);
+    logFormatted(logger, level, event, s_buf);
 }
 
-LogFormatter::ptr Logger::getFormatter() {
-    return m_formatter;
+void MmapFileLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    Rcu::ReadGuard guard;
+    File* file = m_file.load(std::memory_order_acquire);
+    if (file && !text.empty()) {
+        file->write(text.data(), text.size());
+    }
 }
 
-std::string Logger::toYamlString() {
+std::string MmapFileLogAppender::toYamlString() {
     YAML::Node node;
-    node["name"] = m_name;
+    node["type"] = "MmapFileLogAppender";
+    node["file"] = m_filename;
+    node["chunk_size"] = m_chunkSize;
     if(m_level != LogLevel::UNKNOW) {
         node["level"] = LogLevel::ToString(m_level);
     }
-    if(m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
-    }
-
-    for(auto& i : m_appenders) {
-        node["appenders"].push_back(YAML::Load(i->toYamlString()));
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
     }
     std::stringstream ss;
     ss << node;
     return ss.str();
 }
 
+/*******************************JsonLogAppender*********************************/
+static const char s_hex_digits[] = "0123456789abcdef";
 
-void Logger::addAppender(LogAppender::ptr appender) {
-    if (!appender->getFormatter()) {
-        appender->setFormatter(m_formatter);
+//需要转义的字符: 控制字符、双引号和反斜杠
+static inline bool NeedJsonEscape(unsigned char c) {
+    return c < 0x20 || c == '"' || c == '\\';
+}
+
+//返回第一个需要转义的字符的位置，没有时返回len
+static size_t FindJsonEscape(const char* str, size_t len) {
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i slash = _mm_set1_epi8('\\');
+    const __m128i ctrl = _mm_set1_epi8(0x1f);
+    for (; i + 16 <= len; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*)(str + i));
+        __m128i m = _mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, slash));
+        m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+        uint32_t mask = _mm_movemask_epi8(m);
+        if (mask) {
+            return i + __builtin_ctz(mask);
+        }
     }
-    m_appenders.push_back(appender);
+#endif
+    for (; i < len; ++i) {
+        if (NeedJsonEscape(str[i])) {
+            return i;
+        }
+    }
+    return len;
 }
-void Logger::delAppender(LogAppender::ptr appender) {
-    for (auto it = m_appenders.begin() ; it != m_appenders.end(); it ++) {
-        if (*it == appender) {
-            m_appenders.erase(it);
+
+void JsonLogAppender::Escape(std::string& buf, const char* str, size_t len) {
+    size_t pos = 0;
+    while (pos < len) {
+        size_t n = FindJsonEscape(str + pos, len - pos);
+        buf.append(str + pos, n);
+        pos += n;
+        if (pos == len) {
+            break;
+        }
+        unsigned char c = str[pos++];
+        switch (c) {
+        case '"':
+            buf.append("\\\"", 2);
+            break;
+        case '\\':
+            buf.append("\\\\", 2);
+            break;
+        case '\n':
+            buf.append("\\n", 2);
             break;
+        case '\r':
+            buf.append("\\r", 2);
+            break;
+        case '\t':
+            buf.append("\\t", 2);
+            break;
+        case '\b':
+            buf.append("\\b", 2);
+            break;
+        case '\f':
+            buf.append("\\f", 2);
+            break;
+        default: {
+            char tmp[6] = {'\\', 'u', '0', '0', s_hex_digits[c >> 4], s_hex_digits[c & 0xf]};
+            buf.append(tmp, sizeof(tmp));
+            break;
+        }
         }
     }
 }
 
-void Logger::clearAppender() {
-    m_appenders.clear();
+static void AppendJsonString(std::string& buf, const char* str, size_t len) {
+    buf.push_back('"');
+    JsonLogAppender::Escape(buf, str, len);
+    buf.push_back('"');
 }
 
-void Logger::log(LogLevel::Level level, LogEvent::ptr event) {
-    if (level >= m_level) {
-        auto self = shared_from_this();
-        
-        if (!m_appenders.empty()) {
-            for (auto& i : m_appenders) {
-                i->log(self, level, event); 
+void JsonLogAppender::Format(std::string& buf, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    //进程退出时其他静态对象析构中还可能写日志，不释放
+    static DateTimeFormatItem* s_time = new DateTimeFormatItem("%Y-%m-%dT%H:%M:%S.%6%z");
+    buf.append("{\"time\":\"");
+    s_time->append(buf, event);
+    buf.append("\",\"level\":\"");
+    buf.append(LogLevel::ToString(level));
+    buf.append("\",\"logger\":");
+    const std::string& name = event->getLogger()->getName();
+    AppendJsonString(buf, name.c_str(), name.size());
+    buf.append(",\"thread_id\":");
+    AppendUint(buf, event->getThreadId());
+    buf.append(",\"thread_name\":");
+    AppendJsonString(buf, event->getThreadName().c_str(), event->getThreadName().size());
+    buf.append(",\"fiber_id\":");
+    AppendUint(buf, event->getFiberId());
+    buf.append(",\"file\":");
+    AppendJsonString(buf, event->getFile(), strlen(event->getFile()));
+    buf.append(",\"line\":");
+    AppendInt(buf, event->getLine());
+    buf.append(",\"msg\":");
+    AppendJsonString(buf, event->getContentData(), event->getContentSize());
+
+    const LogFields& fields = event->getFields();
+    for (size_t i = 0; i < fields.size(); ++i) {
+        const LogFields::Field& f = fields[i];
+        buf.push_back(',');
+        AppendJsonString(buf, fields.getKey(f), f.keyLen);
+        buf.push_back(':');
+        switch (f.type) {
+        case LogFields::INT:
+            AppendInt(buf, f.i);
+            break;
+        case LogFields::UINT:
+            AppendUint(buf, f.u);
+            break;
+        case LogFields::DOUBLE:
+            //JSON没有nan和inf
+            if (std::isfinite(f.d)) {
+                AppendDouble(buf, f.d);
+            } else {
+                buf.append("null");
             }
-        } else if (m_root) {
-            m_root->log(level, event);
+            break;
+        case LogFields::BOOL:
+            buf.append(f.b ? "true" : "false");
+            break;
+        case LogFields::STRING:
+            AppendJsonString(buf, fields.getString(f), f.strLen);
+            break;
         }
-
     }
+    buf.append("}\n");
 }
 
-void Logger::debug(LogEvent::ptr event) {
-    log(LogLevel::DEBUG, event);
-}
-void Logger::info(LogEvent::ptr event) {
-    log(LogLevel::INFO, event); 
-}
-void Logger::warn(LogEvent::ptr event) {
-    log(LogLevel::WARN, event);
-}
-void Logger::error(LogEvent::ptr event) {
-    log(LogLevel::ERROR, event);
-}
-void Logger::fatal(LogEvent::ptr event) {
-    log(LogLevel::FATAL, event);
-}
-
-
-/*******************************LogAppender*********************************/
-FileLogAppender::FileLogAppender(const std::string& filename)
-    :m_filename(filename) {
+JsonLogAppender::JsonLogAppender(const std::string& filename)
+    :m_filename(filename)
+    ,m_fd(-1) {
     reopen();
 }
 
-void FileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    if (level >= m_level) {
-        m_filestream << m_formatter->format(logger, level, event);
+JsonLogAppender::~JsonLogAppender() {
+    int fd = m_fd.exchange(-1);
+    if (fd >= 0 && !m_filename.empty()) {
+        close(fd);
     }
 }
 
-
-std::string FileLogAppender::toYamlString() {
-    YAML::Node node;
-    node["type"] = "FileLogAppender";
-    node["file"] = m_filename;
-    if(m_level != LogLevel::UNKNOW) {
-        node["level"] = LogLevel::ToString(m_level);
+bool JsonLogAppender::reopen() {
+    if (m_filename.empty()) {
+        m_fd = STDOUT_FILENO;
+        return true;
     }
-    if( m_hasFormatter && m_formatter ) {
-        node["formatter"] = m_formatter->getPattern();
+    int fd = open(m_filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        std::cout << "JsonLogAppender open " << m_filename << " failed: "
+                  << strerror(errno) << std::endl;
+        return false;
     }
-    std::stringstream ss;
-    ss << node;
-    return ss.str();
-}
-
-bool FileLogAppender::reopen() {
-    if (m_filestream) {
-        m_filestream.close();
+    int old = m_fd.exchange(fd);
+    if (old >= 0) {
+        //可能还有写者拿着旧的fd
+        Rcu::Retire([old]() { close(old); });
     }
-    m_filestream.open(m_filename);
-    return !!m_filestream;
+    return true;
 }
 
-void StdoutLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+void JsonLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
     if (level >= m_level) {
-        std::cout << m_formatter->format(logger, level, event);
+        int fd = m_fd.load(std::memory_order_acquire);
+        if (fd < 0) {
+            return;
+        }
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        Format(s_buf, logger, level, event);
+        struct iovec iov;
+        iov.iov_base = (void*)s_buf.data();
+        iov.iov_len = s_buf.size();
+        WriteFull(fd, &iov, 1);
     }
 }
 
-std::string StdoutLogAppender::toYamlString() {
+std::string JsonLogAppender::toYamlString() {
     YAML::Node node;
-    node["type"] = "StdoutLogAppender";
+    node["type"] = "JsonLogAppender";
+    if (!m_filename.empty()) {
+        node["file"] = m_filename;
+    }
     if(m_level != LogLevel::UNKNOW) {
         node["level"] = LogLevel::ToString(m_level);
     }
-    if(m_hasFormatter && m_formatter) {
-        node["formatter"] = m_formatter->getPattern();
-    }
     std::stringstream ss;
     ss << node;
     return ss.str();
@@ -368,11 +2368,85 @@ LogFormatter::LogFormatter(const std::string& pattern)
 }
 
 std::string LogFormatter::format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
-    std::stringstream ss;
+    std::string buf;
+    format(buf, logger, level, event);
+    return buf;
+}
+
+std::ostream& LogFormatter::format(std::ostream& ofs, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
     for (auto& i : m_items) {
-        i->format(logger, ss, level, event);
+        i->format(logger, ofs, level, event);
+    }
+    return ofs;
+}
+
+//编译后的格式化操作码，与init中的占位符一一对应
+enum FormatOpCode {
+    OP_STRING = 0,
+    OP_MESSAGE,
+    OP_LEVEL,
+    OP_ELAPSE,
+    OP_NAME,
+    OP_THREAD_ID,
+    OP_NEWLINE,
+    OP_DATETIME,
+    OP_FILENAME,
+    OP_LINE,
+    OP_TAB,
+    OP_FIBER_ID,
+    OP_THREAD_NAME,
+    OP_FIELDS
+};
+
+void LogFormatter::format(std::string& buf, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event) {
+    for (auto& op : m_ops) {
+        switch (op.code) {
+        case OP_STRING:
+            buf.append(op.str);
+            break;
+        case OP_MESSAGE:
+            buf.append(event->getContentData(), event->getContentSize());
+            break;
+        case OP_LEVEL:
+            buf.append(LogLevel::ToString(level));
+            break;
+        case OP_ELAPSE:
+            AppendUint(buf, event->getElapse());
+            break;
+        case OP_NAME:
+            buf.append(event->getLogger()->getName());
+            break;
+        case OP_THREAD_ID:
+            AppendUint(buf, event->getThreadId());
+            break;
+        case OP_NEWLINE:
+            buf.push_back('\n');
+            break;
+        case OP_DATETIME:
+            static_cast<DateTimeFormatItem*>(op.item.get())->append(buf, event);
+            break;
+        case OP_FILENAME:
+            buf.append(event->getFile());
+            break;
+        case OP_LINE:
+            AppendInt(buf, event->getLine());
+            break;
+        case OP_TAB:
+            buf.push_back('\t');
+            break;
+        case OP_FIBER_ID:
+            AppendUint(buf, event->getFiberId());
+            break;
+        case OP_THREAD_NAME:
+            buf.append(event->getThreadName());
+            break;
+        case OP_FIELDS:
+            event->getFields().appendText(buf);
+            break;
+        default:
+            break;
+        }
     }
-    return ss.str();
 }
 
 //%xxx %xxx{xxx} %%
@@ -470,7 +2544,9 @@ void LogFormatter::init() {
         XX(f, FilenameFormatItem),
         XX(l, LineFormatItem),
         XX(T, TabFormatItem),
-        XX(F, FiberIdFormatItem)
+        XX(F, FiberIdFormatItem),
+        XX(N, ThreadNameFormatItem),
+        XX(K, FieldsFormatItem)
 #undef XX
     };
     //%m -- 消息体
@@ -478,25 +2554,58 @@ void LogFormatter::init() {
     //%r -- 启动后的时间
     //%c -- 日志名称
     //%t -- 线程id
+    //%N -- 线程名
+    //%K -- 结构化字段 key=value，空格分隔
     //%n -- 回车换行
-    //%d -- 时间
+    //%d -- 时间 %d{...}中可以用%3 %6 %9输出毫秒、微秒、纳秒
     //%f -- 文件名
     //%l -- 行号
 
+    static std::map<std::string, int> s_format_ops = {
+        {"m", OP_MESSAGE},
+        {"p", OP_LEVEL},
+        {"r", OP_ELAPSE},
+        {"c", OP_NAME},
+        {"t", OP_THREAD_ID},
+        {"n", OP_NEWLINE},
+        {"d", OP_DATETIME},
+        {"f", OP_FILENAME},
+        {"l", OP_LINE},
+        {"T", OP_TAB},
+        {"F", OP_FIBER_ID},
+        {"N", OP_THREAD_NAME},
+        {"K", OP_FIELDS}
+    };
+
+    m_items.clear();
+    m_ops.clear();
     for (auto& i : vec) {
+        FormatOp op;
+        op.code = OP_STRING;
         if (std::get<2>(i) == 0) {
             m_items.push_back(FormatItem::ptr(new StringFormatItem(std::get<0>(i))));
+            op.str = std::get<0>(i);
         } else {
             auto it = s_format_items.find(std::get<0>(i));
             if (it == s_format_items.end()) {
                 std::string fmt = std::get<0>(i).empty() ? "null" : std::get<0>(i);
                 m_items.push_back(FormatItem::ptr(new StringFormatItem("<<error_format %" + fmt + ">>")));
+                op.str = "<<error_format %" + fmt + ">>";
                 m_error = true;
             } else {
                 m_items.push_back(it->second(std::get<1>(i)));
+                op.code = s_format_ops[std::get<0>(i)];
+                op.item = m_items.back();
             }
         }
 
+        //相邻的普通字符串合并成一次append
+        if (op.code == OP_STRING && !m_ops.empty() && m_ops.back().code == OP_STRING) {
+            m_ops.back().str += op.str;
+        } else {
+            m_ops.push_back(op);
+        }
+
         //std::cout << "(" << std::get<0>(i) << " ) - ( " << std::get<1>(i) << " ) - ( " << std::get<2>(i) << " )\n";
     }
     //std::cout << m_items.size() << std::endl;
@@ -505,35 +2614,148 @@ void LogFormatter::init() {
 LoggerManager::LoggerManager() {
     m_root.reset(new Logger);
     m_root->addAppender(LogAppender::ptr(new StdoutLogAppender));
+    //root的级别总是作为设置过的级别被继承
+    m_root->m_levelSet.store(true, std::memory_order_relaxed);
+    m_root->m_managed = true;
 
     m_loggers[m_root->getName()] = m_root;
 
     init();
 }
 
+LoggerManager::~LoggerManager() {
+    //队列中的日志事件持有Logger的引用，退出前先把异步日志输出完
+    std::map<std::string, Logger::ptr> loggers;
+    {
+        RWMutex::ReadLock lock(m_mutex);
+        loggers = m_loggers;
+    }
+    for (auto& i : loggers) {
+        i.second->stopAsync();
+    }
+}
+
 Logger::ptr LoggerManager::getLogger(const std::string& name) {
+    {
+        RWMutex::ReadLock lock(m_mutex);
+        auto it = m_loggers.find(name);
+        if (it != m_loggers.end()) {
+            return it->second;
+        }
+    }
+
+    RWMutex::WriteLock lock(m_mutex);
     auto it = m_loggers.find(name);
     if (it != m_loggers.end()) {
         return it->second;
     }
-
     Logger::ptr logger(new Logger(name));
-    logger->m_root = m_root;
+    logger->m_managed = true;
+    //新Logger没有设置级别和appender，不影响已有Logger的继承关系
+    resolve(logger.get());
     m_loggers[name] = logger;
+    LogCallSite::Invalidate();
     return logger;
 }
 
+void LoggerManager::resolve() {
+    {
+        RWMutex::WriteLock lock(m_mutex);
+        for (auto& i : m_loggers) {
+            resolve(i.second.get());
+        }
+    }
+    LogCallSite::Invalidate();
+}
+
+void LoggerManager::resolve(Logger* logger) {
+    if (logger == m_root.get()) {
+        return;
+    }
+    Logger* level = logger->isLevelSet() ? logger : nullptr;
+    Logger* parent = nullptr;
+    std::string name = logger->getName();
+    size_t pos;
+    while ((!level || !parent) && (pos = name.rfind('.')) != std::string::npos) {
+        name.resize(pos);
+        auto it = m_loggers.find(name);
+        if (it == m_loggers.end()) {
+            continue;
+        }
+        Logger* p = it->second.get();
+        if (!level && p->isLevelSet()) {
+            level = p;
+        }
+        if (!parent && !p->m_appenders.load()->empty()) {
+            parent = p;
+        }
+    }
+    //调用者在释放写锁后调用LogCallSite::Invalidate发布
+    if (!level) {
+        logger->m_level.store(m_root->getLevel(), std::memory_order_relaxed);
+    } else if (level != logger) {
+        logger->m_level.store(level->getLevel(), std::memory_order_relaxed);
+    }
+    logger->m_parent = parent ? parent : m_root.get();
+}
+
 struct LogAppenderDefine {
-    int type = 0; //1 File, 2 Stdout
+    int type = 0; //1 File, 2 Stdout, 3 RotatingFile, 4 MmapFile, 5 Console, 6 Json, 7 Socket, 8 Shm, 9 Uring, 10 Compressed
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::string file;
+    uint64_t max_size = 0;
+    RotatingFileLogAppender::Interval interval = RotatingFileLogAppender::NONE;
+    uint32_t max_files = 0;
+    uint64_t chunk_size = 32 * 1024 * 1024;
+    int fd = STDOUT_FILENO;
+    ConsoleLogAppender::FlushPolicy flush = ConsoleLogAppender::AUTO;
+    uint32_t buffer_size = 64 * 1024;
+    uint32_t flush_interval = 1000;
+    LogLevel::Level flush_level = LogLevel::ERROR;
+    std::string address;
+    SocketLogAppender::Framing framing = SocketLogAppender::SYSLOG;
+    uint64_t max_pending = 4 * 1024 * 1024;
+    AsyncLogDispatcher::OverflowPolicy overflow = AsyncLogDispatcher::DROP_COUNT;
+    std::string channel;
+    uint32_t capacity = 4096;
+    uint32_t slot_size = 1024;
+    UringFileLogAppender::SyncPolicy sync = UringFileLogAppender::NONE;
+    uint32_t sync_interval = 1000;
+    uint32_t buffers = 8;
+    uint32_t index_records = 0;
+    uint64_t index_bytes = 0;
+    CompressedLog::Codec codec = CompressedLog::ZLIB;
+    int compress_level = -1;
 
     bool operator==(const LogAppenderDefine& oth) const {
         return type == oth.type &&
                level == oth.level &&
                formatter == oth.formatter &&
-               file == oth.file;
+               file == oth.file &&
+               max_size == oth.max_size &&
+               interval == oth.interval &&
+               max_files == oth.max_files &&
+               chunk_size == oth.chunk_size &&
+               fd == oth.fd &&
+               flush == oth.flush &&
+               buffer_size == oth.buffer_size &&
+               flush_interval == oth.flush_interval &&
+               flush_level == oth.flush_level &&
+               address == oth.address &&
+               framing == oth.framing &&
+               max_pending == oth.max_pending &&
+               overflow == oth.overflow &&
+               channel == oth.channel &&
+               capacity == oth.capacity &&
+               slot_size == oth.slot_size &&
+               sync == oth.sync &&
+               sync_interval == oth.sync_interval &&
+               buffers == oth.buffers &&
+               index_records == oth.index_records &&
+               index_bytes == oth.index_bytes &&
+               codec == oth.codec &&
+               compress_level == oth.compress_level;
     }
 };
 
@@ -542,11 +2764,21 @@ struct LogDefine {
     LogLevel::Level level = LogLevel::UNKNOW;
     std::string formatter;
     std::vector<LogAppenderDefine> appenders;
+    bool async = false;
+    uint32_t queue_size = 8192;
+    AsyncLogDispatcher::OverflowPolicy overflow = AsyncLogDispatcher::BLOCK;
+    std::string binary;
+    uint32_t dedup = 0;
     bool operator== (const LogDefine& oth) const {
         return name == oth.name && 
                level == oth.level &&
                formatter == oth.formatter &&
-               appenders == oth.appenders;
+               appenders == oth.appenders &&
+               async == oth.async &&
+               queue_size == oth.queue_size &&
+               overflow == oth.overflow &&
+               binary == oth.binary &&
+               dedup == oth.dedup;
     }
 
     bool operator<(const LogDefine& oth) const {
@@ -570,6 +2802,21 @@ public:
         if(node["formatter"].IsDefined()) {
             p.formatter = node["formatter"].as<std::string>();
         }
+        if(node["async"].IsDefined()) {
+            p.async = node["async"].as<bool>();
+        }
+        if(node["queue_size"].IsDefined()) {
+            p.queue_size = node["queue_size"].as<uint32_t>();
+        }
+        if(node["overflow"].IsDefined()) {
+            p.overflow = AsyncLogDispatcher::FromString(node["overflow"].as<std::string>());
+        }
+        if(node["binary"].IsDefined()) {
+            p.binary = node["binary"].as<std::string>();
+        }
+        if(node["dedup"].IsDefined()) {
+            p.dedup = node["dedup"].as<uint32_t>();
+        }
         if (node["appenders"].IsDefined()) {
             for(size_t x = 0; x < node["appenders"].size(); ++x) {
                 auto a = node["appenders"][x];
@@ -588,6 +2835,163 @@ public:
                         continue;
                     }
                     lad.file = a["file"].as<std::string>();
+                    if(a["index_records"].IsDefined()) {
+                        lad.index_records = a["index_records"].as<uint32_t>();
+                    }
+                    if(a["index_bytes"].IsDefined()) {
+                        lad.index_bytes = a["index_bytes"].as<uint64_t>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "CompressedFileLogAppender") {
+                    lad.type = 10;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: compressedfileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["codec"].IsDefined()) {
+                        lad.codec = CompressedLog::FromString(a["codec"].as<std::string>());
+                    }
+                    if(a["compress_level"].IsDefined()) {
+                        lad.compress_level = a["compress_level"].as<int>();
+                    }
+                    //块大小的默认值与ConsoleLogAppender的缓冲区不同
+                    lad.buffer_size = 256 * 1024;
+                    if(a["block_size"].IsDefined()) {
+                        lad.buffer_size = a["block_size"].as<uint32_t>();
+                    }
+                    if(a["buffers"].IsDefined()) {
+                        lad.buffers = a["buffers"].as<uint32_t>();
+                    }
+                    if(a["flush_interval"].IsDefined()) {
+                        lad.flush_interval = a["flush_interval"].as<uint32_t>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "RotatingFileLogAppender") {
+                    lad.type = 3;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: rotatingfileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["max_size"].IsDefined()) {
+                        lad.max_size = a["max_size"].as<uint64_t>();
+                    }
+                    if(a["interval"].IsDefined()) {
+                        lad.interval = RotatingFileLogAppender::FromString(a["interval"].as<std::string>());
+                    }
+                    if(a["max_files"].IsDefined()) {
+                        lad.max_files = a["max_files"].as<uint32_t>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "MmapFileLogAppender") {
+                    lad.type = 4;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: mmapfileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["chunk_size"].IsDefined()) {
+                        lad.chunk_size = a["chunk_size"].as<uint64_t>();
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "ConsoleLogAppender") {
+                    lad.type = 5;
+                    if(a["target"].IsDefined()) {
+                        lad.fd = a["target"].as<std::string>() == "stderr" ? STDERR_FILENO : STDOUT_FILENO;
+                    }
+                    if(a["flush"].IsDefined()) {
+                        lad.flush = ConsoleLogAppender::FromString(a["flush"].as<std::string>());
+                    }
+                    if(a["buffer_size"].IsDefined()) {
+                        lad.buffer_size = a["buffer_size"].as<uint32_t>();
+                    }
+                    if(a["flush_interval"].IsDefined()) {
+                        lad.flush_interval = a["flush_interval"].as<uint32_t>();
+                    }
+                    if(a["flush_level"].IsDefined()) {
+                        lad.flush_level = LogLevel::FromString(a["flush_level"].as<std::string>());
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "JsonLogAppender") {
+                    lad.type = 6;
+                    //没有file时输出到标准输出
+                    if(a["file"].IsDefined()) {
+                        lad.file = a["file"].as<std::string>();
+                    }
+                } else if(type == "SocketLogAppender") {
+                    lad.type = 7;
+                    if(!a["address"].IsDefined()) {
+                        std::cout << "log config error: socketappender address is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.address = a["address"].as<std::string>();
+                    if(a["framing"].IsDefined()) {
+                        lad.framing = SocketLogAppender::FromString(a["framing"].as<std::string>());
+                    }
+                    if(a["max_pending"].IsDefined()) {
+                        lad.max_pending = a["max_pending"].as<uint64_t>();
+                    }
+                    if(a["overflow"].IsDefined()) {
+                        lad.overflow = AsyncLogDispatcher::FromString(a["overflow"].as<std::string>());
+                    }
+                    if(a["formatter"].IsDefined()) {
+                        lad.formatter = a["formatter"].as<std::string>();
+                    }
+                } else if(type == "ShmLogAppender") {
+                    lad.type = 8;
+                    if(!a["channel"].IsDefined()) {
+                        std::cout << "log config error: shmappender channel is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.channel = a["channel"].as<std::string>();
+                    if(a["capacity"].IsDefined()) {
+                        lad.capacity = a["capacity"].as<uint32_t>();
+                    }
+                    if(a["slot_size"].IsDefined()) {
+                        lad.slot_size = a["slot_size"].as<uint32_t>();
+                    }
+                } else if(type == "UringFileLogAppender") {
+                    lad.type = 9;
+                    if(!a["file"].IsDefined()) {
+                        std::cout << "log config error: uringfileappender file is null, " << a
+                              << std::endl;
+                        continue;
+                    }
+                    lad.file = a["file"].as<std::string>();
+                    if(a["sync"].IsDefined()) {
+                        lad.sync = UringFileLogAppender::FromString(a["sync"].as<std::string>());
+                    }
+                    if(a["sync_interval"].IsDefined()) {
+                        lad.sync_interval = a["sync_interval"].as<uint32_t>();
+                    }
+                    //缓冲区大小和刷新间隔的默认值与ConsoleLogAppender不同
+                    lad.buffer_size = 256 * 1024;
+                    if(a["buffer_size"].IsDefined()) {
+                        lad.buffer_size = a["buffer_size"].as<uint32_t>();
+                    }
+                    if(a["buffers"].IsDefined()) {
+                        lad.buffers = a["buffers"].as<uint32_t>();
+                    }
+                    lad.flush_interval = 100;
+                    if(a["flush_interval"].IsDefined()) {
+                        lad.flush_interval = a["flush_interval"].as<uint32_t>();
+                    }
                     if(a["formatter"].IsDefined()) {
                         lad.formatter = a["formatter"].as<std::string>();
                     }
@@ -621,13 +3025,87 @@ public:
         if(!i.formatter.empty()) {
             n["formatter"] = i.formatter;
         }
+        if(i.async) {
+            n["async"] = true;
+            n["queue_size"] = i.queue_size;
+            n["overflow"] = AsyncLogDispatcher::ToString(i.overflow);
+        }
+        if(!i.binary.empty()) {
+            n["binary"] = i.binary;
+        }
+        if(i.dedup) {
+            n["dedup"] = i.dedup;
+        }
         for(auto& a : i.appenders) {
             YAML::Node na;
             if(a.type == 1) {
                 na["type"] = "FileLogAppender";
                 na["file"] = a.file;
+                if(a.index_records) {
+                    na["index_records"] = a.index_records;
+                }
+                if(a.index_bytes) {
+                    na["index_bytes"] = a.index_bytes;
+                }
             } else if(a.type == 2) {
                 na["type"] = "StdoutLogAppender";
+            } else if(a.type == 10) {
+                na["type"] = "CompressedFileLogAppender";
+                na["file"] = a.file;
+                na["codec"] = CompressedLog::ToString(a.codec);
+                if(a.compress_level >= 0) {
+                    na["compress_level"] = a.compress_level;
+                }
+                na["block_size"] = a.buffer_size;
+                na["buffers"] = a.buffers;
+                na["flush_interval"] = a.flush_interval;
+            } else if(a.type == 3) {
+                na["type"] = "RotatingFileLogAppender";
+                na["file"] = a.file;
+                if(a.max_size) {
+                    na["max_size"] = a.max_size;
+                }
+                if(a.interval != RotatingFileLogAppender::NONE) {
+                    na["interval"] = RotatingFileLogAppender::ToString(a.interval);
+                }
+                if(a.max_files) {
+                    na["max_files"] = a.max_files;
+                }
+            } else if(a.type == 4) {
+                na["type"] = "MmapFileLogAppender";
+                na["file"] = a.file;
+                na["chunk_size"] = a.chunk_size;
+            } else if(a.type == 5) {
+                na["type"] = "ConsoleLogAppender";
+                na["target"] = a.fd == STDERR_FILENO ? "stderr" : "stdout";
+                na["flush"] = ConsoleLogAppender::ToString(a.flush);
+                na["buffer_size"] = a.buffer_size;
+                na["flush_interval"] = a.flush_interval;
+                na["flush_level"] = LogLevel::ToString(a.flush_level);
+            } else if(a.type == 6) {
+                na["type"] = "JsonLogAppender";
+                if(!a.file.empty()) {
+                    na["file"] = a.file;
+                }
+            } else if(a.type == 7) {
+                na["type"] = "SocketLogAppender";
+                na["address"] = a.address;
+                na["framing"] = SocketLogAppender::ToString(a.framing);
+                na["max_pending"] = a.max_pending;
+                na["overflow"] = AsyncLogDispatcher::ToString(a.overflow);
+            } else if(a.type == 8) {
+                na["type"] = "ShmLogAppender";
+                na["channel"] = a.channel;
+                na["capacity"] = a.capacity;
+                na["slot_size"] = a.slot_size;
+            } else if(a.type == 9) {
+                na["type"] = "UringFileLogAppender";
+                na["file"] = a.file;
+                na["sync"] = UringFileLogAppender::ToString(a.sync);
+                na["sync_interval"] = a.sync_interval;
+                na["buffer_size"] = a.buffer_size;
+                na["buffers"] = a.buffers;
+                na["flush_interval"] = a.flush_interval;
             }
             if(a.level != LogLevel::UNKNOW) {
                 na["level"] = LogLevel::ToString(a.level);
@@ -653,29 +3131,52 @@ struct LogIniter {
         g_log_defines->addListener(0xF1E231, [](const std::set<LogDefine>& old_value, 
             const std::set<LogDefine>& new_value) {
             LCH_LOG_INFO(LCH_LOG_ROOT()) << "on_logger_conf_changed";
-            Logger::ptr logger;
             for (auto& i : new_value) {
                 auto it = old_value.find(i);
-                if (it == old_value.end()) { //新增
-                    logger = LCH_LOG_NAME(i.name);
-                } else { //修改
-                    if (!(i == *it)) {
-                        logger = LCH_LOG_NAME(i.name);
-                    }
+                //没有变化的不用重新配置
+                if (it != old_value.end() && i == *it) {
+                    continue;
                 }
+                //新增或修改
+                Logger::ptr logger = LCH_LOG_NAME(i.name);
 
-                logger->setLevel(i.level);
+                //没有配置级别时从上级继承
+                if (i.level == LogLevel::UNKNOW) {
+                    logger->inheritLevel();
+                } else {
+                    logger->setLevel(i.level);
+                }
                 if (!i.formatter.empty()) {
                     logger->setFormatter(i.formatter);
                 }
 
-                logger->clearAppender();
+                //先建好全部appender再一次发布，重新配置时正在写的日志不会看到空的或不完整的列表
+                Logger::AppenderList appenders;
                 for (auto& a : i.appenders) {
                     LogAppender::ptr ap;
                     if (a.type == 1) {
-                        ap.reset(new FileLogAppender(a.file));
+                        ap.reset(new FileLogAppender(a.file, a.index_records, a.index_bytes));
                     } else if (a.type == 2) {
                         ap.reset(new StdoutLogAppender());
+                    } else if (a.type == 3) {
+                        ap.reset(new RotatingFileLogAppender(a.file, a.max_size, a.interval, a.max_files));
+                    } else if (a.type == 4) {
+                        ap.reset(new MmapFileLogAppender(a.file, a.chunk_size));
+                    } else if (a.type == 5) {
+                        ap.reset(new ConsoleLogAppender(a.fd, a.flush, a.buffer_size
+                                    , a.flush_interval, a.flush_level));
+                    } else if (a.type == 6) {
+                        ap.reset(new JsonLogAppender(a.file));
+                    } else if (a.type == 7) {
+                        ap.reset(new SocketLogAppender(a.address, a.framing, a.max_pending, a.overflow));
+                    } else if (a.type == 8) {
+                        ap.reset(new ShmLogAppender(a.channel, a.capacity, a.slot_size));
+                    } else if (a.type == 9) {
+                        ap.reset(new UringFileLogAppender(a.file, a.sync, a.sync_interval
+                                    , a.buffer_size, a.buffers, a.flush_interval));
+                    } else if (a.type == 10) {
+                        ap.reset(new CompressedFileLogAppender(a.file, a.codec, a.compress_level
+                                    , a.buffer_size, a.flush_interval, a.buffers));
                     }
                     ap->setLevel(a.level);
                     if(!a.formatter.empty()) {
@@ -687,7 +3188,27 @@ struct LogIniter {
                                       << " formatter=" << a.formatter << " is invalid" << std::endl;
                         }
                     }
-                    logger->addAppender(ap);
+                    appenders.push_back(ap);
+                }
+                logger->setAppenders(appenders);
+
+                if (i.binary.empty()) {
+                    logger->stopBinary();
+                } else if (!logger->startBinary(i.binary)) {
+                    std::cout << "log.name=" << i.name << " binary=" << i.binary
+                              << " open failed" << std::endl;
+                }
+
+                if (i.async) {
+                    logger->startAsync(i.queue_size, i.overflow);
+                } else {
+                    logger->stopAsync();
+                }
+
+                if (i.dedup) {
+                    logger->startDedup(i.dedup);
+                } else {
+                    logger->stopDedup();
                 }
             }
 
@@ -698,8 +3219,12 @@ struct LogIniter {
                 auto it = new_value.find(i);
                 if (it == new_value.end()) {
                     auto logger = LCH_LOG_NAME(i.name);
-                    logger->setLevel( (LogLevel::Level)100 );
-                    logger->clearAppender();
+                    logger->stopDedup();
+                    logger->stopAsync();
+                    logger->stopBinary();
+                    //恢复为从上级继承级别和appender
+                    logger->inheritLevel();
+                    logger->setAppenders(Logger::AppenderList());
                 }
             }
 
@@ -716,8 +3241,13 @@ void LoggerManager::init() {
 }
 
 std::string LoggerManager::toYamlString() {
+    std::map<std::string, Logger::ptr> loggers;
+    {
+        RWMutex::ReadLock lock(m_mutex);
+        loggers = m_loggers;
+    }
     YAML::Node node;
-    for(auto& i : m_loggers) {
+    for(auto& i : loggers) {
         node.push_back(YAML::Load(i.second->toYamlString()));
     }
     std::stringstream ss;
@@ -12,17 +12,37 @@
 #include <functional>
 #include <time.h>
 #include <stdarg.h>
+#include <atomic>
+#include <type_traits>
+#include <string.h>
 
 #include "singleton.h"
 #include "util.h"
+#include "mutex.h"
+#include "ring_queue.h"
 
 
+//编译期最低日志级别，低于该级别的日志语句会被编译器整个去掉
+//1 DEBUG, 2 INFO, 3 WARN, 4 ERROR, 5 FATAL
+#ifndef LCH_LOG_ACTIVE_LEVEL
+#define LCH_LOG_ACTIVE_LEVEL 1
+#endif
+
+//每个宏展开处有一个静态的LogCallSite，缓存该语句是否需要输出
+#define LCH_LOG_CALL_SITE() \
+    []() -> lch::LogCallSite& { static lch::LogCallSite s_site; return s_site; }()
+
+#define LCH_LOG_ENABLED(logger, level) \
+    ((level) >= LCH_LOG_ACTIVE_LEVEL && LCH_LOG_CALL_SITE().isEnabled(logger, level))
+
 //这条宏是为提供日志器的简便使用方式
+//编译期级别判断单独放在外层if，保证-O0下也能被整个去掉
 #define LCH_LOG_LEVEL(logger, level) \
-    if (logger->getLevel() <= level) \
-        lch::LogEventWrap(lch::LogEvent::ptr(new lch::LogEvent(logger, level, __FILE__, __LINE__, 0,\
-            lch::GetThreadId(), \
-            lch::GetFiberId(), time(0)))).getSS()
+    if ((level) >= LCH_LOG_ACTIVE_LEVEL) \
+        if (lch::LogCallSite* lch_log_site = LCH_LOG_CALL_SITE().check(logger, level)) \
+            lch::LogEventWrap(lch::LogEvent::Create(logger, level, __FILE__, __LINE__, lch::GetElapsedMS(),\
+                lch::GetThreadId(), \
+                lch::GetFiberId(), lch_log_site)).getSS()
 //输出日志的方法：LCH_LOG_XX(logger) << content; 即可输出对应级别为xx的日志 
 #define LCH_LOG_DEBUG(logger) LCH_LOG_LEVEL(logger, lch::LogLevel::DEBUG)
 #define LCH_LOG_INFO(logger) LCH_LOG_LEVEL(logger, lch::LogLevel::INFO)
@@ -31,11 +51,14 @@
 #define LCH_LOG_FATAL(logger) LCH_LOG_LEVEL(logger, lch::LogLevel::FATAL)
 
 
+//二进制模式下参数按类型原样编码，不做格式化
+//fmt必须是字符串常量，""fmt在传入其他表达式时编译失败
 #define LCH_LOG_FMT_LEVEL(logger, level, fmt, ...) \
-    if (logger->getLevel() <= level) \
-        lch::LogEventWrap(lch::LogEvent::ptr(new lch::LogEvent(logger, level, \
-            __FILE__, __LINE__, 0, lch::GetThreadId(), \
-            lch::GetFiberId(), time(0)))).getEvent()->format(fmt, __VA_ARGS__)
+    if ((level) >= LCH_LOG_ACTIVE_LEVEL) \
+        if (lch::LogCallSite* lch_log_site = LCH_LOG_CALL_SITE().check(logger, level)) \
+            lch::LogEventWrap(lch::LogEvent::Create(logger, level, \
+                __FILE__, __LINE__, lch::GetElapsedMS(), lch::GetThreadId(), \
+                lch::GetFiberId(), lch_log_site)).format("" fmt, __VA_ARGS__)
 
 #define LCH_LOG_FMT_DEBUG(logger, fmt, ...) LCH_LOG_FMT_LEVEL(logger, lch::LogLevel::DEBUG, fmt, __VA_ARGS__)
 #define LCH_LOG_FMT_INFO(logger, fmt, ...) LCH_LOG_FMT_LEVEL(logger, lch::LogLevel::INFO, fmt, __VA_ARGS__)
@@ -43,13 +66,38 @@
 #define LCH_LOG_FMT_ERROR(logger, fmt, ...) LCH_LOG_FMT_LEVEL(logger, lch::LogLevel::ERROR, fmt, __VA_ARGS__)
 #define LCH_LOG_FMT_FATAL(logger, fmt, ...) LCH_LOG_FMT_LEVEL(logger, lch::LogLevel::FATAL, fmt, __VA_ARGS__)
 
+//按调用点限流的日志 通过的那一条会带上之前被丢弃的条数
+#define LCH_LOG_LIMITED(logger, level, limit) \
+    if ((level) >= LCH_LOG_ACTIVE_LEVEL) \
+        if (lch::LogCallSite* lch_log_site = LCH_LOG_CALL_SITE().check(logger, level)) \
+            if (uint64_t lch_log_pass = []() -> lch::LogRateLimiter& { \
+                    static lch::LogRateLimiter s_limiter; return s_limiter; }().limit) \
+                lch::LogEventWrap(lch::LogEvent::Create(logger, level, __FILE__, __LINE__, lch::GetElapsedMS(),\
+                    lch::GetThreadId(), \
+                    lch::GetFiberId(), lch_log_site)).getSS(lch_log_pass - 1)
+
+//每n次输出一次
+#define LCH_LOG_EVERY_N(logger, level, n) LCH_LOG_LIMITED(logger, level, everyN(n))
+//只输出前n次
+#define LCH_LOG_FIRST_N(logger, level, n) LCH_LOG_LIMITED(logger, level, firstN(n))
+//每ms毫秒最多输出一次
+#define LCH_LOG_EVERY_MS(logger, level, ms) LCH_LOG_LIMITED(logger, level, everyMs(ms))
+//令牌桶 平均每秒rate条，最多突发burst条
+#define LCH_LOG_RATE_LIMIT(logger, level, rate, burst) LCH_LOG_LIMITED(logger, level, tokenBucket(rate, burst))
+
 #define LCH_LOG_ROOT() lch::LoggerMgr::GetInstance()->getRoot()
 #define LCH_LOG_NAME(name) lch::LoggerMgr::GetInstance()->getLogger(name)
+//每个展开处只查找一次Logger，之后直接返回缓存的引用；name必须是常量，同一展开处不能换名字
+#define LCH_LOG_CACHED(name) \
+    []() -> const lch::Logger::ptr& { static const lch::Logger::ptr s_logger = LCH_LOG_NAME(name); return s_logger; }()
 
 namespace lch {
 
 class Logger;
 class LoggerManager;
+class Thread;
+class BinLogWriter;
+class LogIndexWriter;
 
 //日志级别
 class LogLevel {
@@ -69,47 +117,369 @@ public:
 };
 
 
+//日志调用点 缓存某条日志语句对某个Logger是否开启
+//Logger级别变化时全局代数加一，所有调用点的缓存随之失效
+class LogCallSite {
+public:
+    constexpr LogCallSite() : m_logger(nullptr), m_state(0), m_id(0) {}
+
+    bool isEnabled(const std::shared_ptr<Logger>& logger, LogLevel::Level level) {
+        uint64_t state = m_state.load(std::memory_order_acquire);
+        if (state == MakeState(s_generation.load(std::memory_order_relaxed), level, state & 1)
+                && m_logger.load(std::memory_order_relaxed) == logger.get()) {
+            return state & 1;
+        }
+        return refresh(logger, level);
+    }
+
+    //开启时返回自身，否则返回nullptr
+    LogCallSite* check(const std::shared_ptr<Logger>& logger, LogLevel::Level level) {
+        return isEnabled(logger, level) ? this : nullptr;
+    }
+
+    //二进制日志中的调用点编号，第一次使用时分配
+    uint32_t getId() {
+        uint32_t id = m_id.load(std::memory_order_acquire);
+        return id ? id : allocId();
+    }
+
+    //使所有调用点的缓存失效
+    static void Invalidate() { s_generation.fetch_add(1); }
+    //分配一个进程内唯一的调用点编号
+    static uint32_t NextId();
+private:
+    uint32_t allocId();
+    static uint64_t MakeState(uint32_t gen, LogLevel::Level level, bool enabled) {
+        return ((uint64_t)gen << 32) | ((uint64_t)level << 8) | (enabled ? 1 : 0);
+    }
+    bool refresh(const std::shared_ptr<Logger>& logger, LogLevel::Level level);
+private:
+    //只缓存第一次遇到的Logger，同一调用点换了Logger时每次都现查
+    std::atomic<Logger*> m_logger;
+    //高32位代数，8~15位级别，最低位是否开启
+    std::atomic<uint64_t> m_state;
+    std::atomic<uint32_t> m_id;
+    static std::atomic<uint32_t> s_generation;
+};
+
+//日志内容缓冲区 先写入内联数组，超出后才扩展到堆上，复用时不释放已扩展的空间
+class LogStreamBuf : public std::streambuf {
+public:
+    enum { INLINE_SIZE = 512 };
+    LogStreamBuf();
+
+    const char* data() const { return pbase(); }
+    size_t size() const { return pptr() - pbase(); }
+    void reset();
+    //直接格式化到缓冲区中，不经过临时字符串
+    void vformat(const char* fmt, va_list al);
+protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+private:
+    void reserve(size_t n);
+private:
+    char m_inline[INLINE_SIZE];
+    std::vector<char> m_heap;
+};
+
+//日志事件附带的结构化字段 键和字符串值都拷贝到同一块缓冲区里，
+//事件复用时只清空不释放，字段多的日志也不会每个字段分配一次内存
+class LogFields {
+public:
+    enum Type {
+        INT = 0,
+        UINT = 1,
+        DOUBLE = 2,
+        BOOL = 3,
+        STRING = 4
+    };
+
+    struct Field {
+        Type type;
+        uint32_t key;       //键在缓冲区中的偏移
+        uint32_t keyLen;
+        uint32_t str;       //字符串值在缓冲区中的偏移
+        uint32_t strLen;
+        union {
+            int64_t i;
+            uint64_t u;
+            double d;
+            bool b;
+        };
+    };
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    add(const char* key, T v) { push(key, INT).i = v; }
+
+    template<class T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value
+                            && !std::is_same<T, bool>::value>::type
+    add(const char* key, T v) { push(key, UINT).u = v; }
+
+    template<class T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    add(const char* key, T v) { push(key, DOUBLE).d = v; }
+
+    template<class T>
+    typename std::enable_if<std::is_enum<T>::value>::type
+    add(const char* key, T v) { push(key, INT).i = (int64_t)v; }
+
+    void add(const char* key, bool v) { push(key, BOOL).b = v; }
+    void add(const char* key, const char* v) { addString(key, v ? v : "(null)", v ? strlen(v) : 6); }
+    void add(const char* key, char* v) { add(key, (const char*)v); }
+    void add(const char* key, const std::string& v) { addString(key, v.data(), v.size()); }
+
+    size_t size() const { return m_fields.size(); }
+    bool empty() const { return m_fields.empty(); }
+    const Field& operator[](size_t idx) const { return m_fields[idx]; }
+    const char* getKey(const Field& f) const { return m_data.data() + f.key; }
+    const char* getString(const Field& f) const { return m_data.data() + f.str; }
+
+    void clear() { m_fields.clear(); m_data.clear(); }
+    //按 key=value 的形式追加到buf中，字段之间用空格分隔
+    void appendText(std::string& buf) const;
+private:
+    Field& push(const char* key, Type type);
+    void addString(const char* key, const char* v, size_t len);
+private:
+    std::vector<Field> m_fields;
+    std::string m_data;
+};
+
+class LogStream : public std::ostream {
+public:
+    LogStream() : std::ostream(&m_buf) {}
+
+    const char* data() const { return m_buf.data(); }
+    size_t size() const { return m_buf.size(); }
+    std::string str() const { return std::string(data(), size()); }
+    //清空内容并恢复默认的格式状态
+    void reset();
+    void vformat(const char* fmt, va_list al) { m_buf.vformat(fmt, al); }
+    //原样追加，不经过ostream的sentry
+    void append(const char* s, size_t n) { m_buf.sputn(s, n); }
+    //所属事件的字段，由LogEvent设置，供 << lch::kv(...) 使用
+    LogFields* getFields() const { return m_fields; }
+    void setFields(LogFields* fields) { m_fields = fields; }
+private:
+    LogStreamBuf m_buf;
+    LogFields* m_fields = nullptr;
+};
+
 //日志事件 每条日志信息都是一个LogEvent对象    
 class LogEvent {
 public:
     typedef std::shared_ptr<LogEvent> ptr;
     LogEvent(std::shared_ptr<Logger> logger, LogLevel::Level level,const char* file, int32_t line, uint32_t elapse
-    , uint32_t threadId, uint32_t fiberId, uint64_t time);
+    , uint32_t threadId, uint32_t fiberId, uint64_t time, uint32_t nsec = 0);
 
     ~LogEvent();
 
+    //从线程本地的对象池中取一个空闲的LogEvent，池中都被占用时才new
+    //时间戳在这里读取，精确到纳秒
+    static LogEvent::ptr Create(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file
+    , int32_t line, uint32_t elapse, uint32_t threadId, uint32_t fiberId, LogCallSite* site = nullptr);
+
     const char* getFile() const {return m_file;}
     int32_t getLine() const {return m_line;}
     uint32_t getElapse() const {return m_elapse;}
     uint32_t getThreadId() const {return m_threadId;}
     uint32_t getFiberId() const {return m_fiberId;}
+    //创建事件的线程名，异步输出时也是产生日志的线程
+    const std::string& getThreadName() const {return m_threadName;}
+    void setThreadName(const std::string& name) {m_threadName = name;}
     std::uint64_t getTime() const {return m_time;}
+    //时间戳秒以下的纳秒部分
+    uint32_t getNanosecond() const {return m_nsec;}
     std::string getContent() const {return m_ss.str();}
-    std::shared_ptr<Logger> getLogger() const {return m_logger;}
+    const char* getContentData() const { return m_ss.data(); }
+    size_t getContentSize() const { return m_ss.size(); }
+    const std::shared_ptr<Logger>& getLogger() const {return m_logger;}
     LogLevel::Level getLevel() const {return m_level;}
     
-    std::stringstream& getSS() {return m_ss;}
+    LogStream& getSS() {return m_ss;}
     void format(const char* fmt, ...);
     void format(const char* fmt, va_list al);
+
+    //产生该事件的日志语句，直接构造的事件为nullptr
+    LogCallSite* getCallSite() const { return m_site; }
+    //非空表示内容是二进制编码的参数，值为printf格式串
+    const char* getBinaryFormat() const { return m_binaryFormat; }
+    void setBinaryFormat(const char* fmt) { m_binaryFormat = fmt; }
+
+    //结构化字段，键值都会被拷贝
+    template<class T>
+    LogEvent& addField(const char* key, const T& v) { m_fields.add(key, v); return *this; }
+    const LogFields& getFields() const { return m_fields; }
+private:
+    void reset(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const char* file, int32_t line
+    , uint32_t elapse, uint32_t threadId, uint32_t fiberId, uint64_t time, uint32_t nsec);
 private:
     const char* m_file = nullptr;  //文件名
     int32_t m_line = 0;            //行号
     uint32_t m_elapse = 0;         //程序启动开始到现在的毫秒数
     uint32_t m_threadId = 0;       //线程Id
     uint32_t m_fiberId = 0;        //协程Id
+    std::string m_threadName;      //线程名
     uint64_t m_time = 0;           //时间戳
-    std::stringstream m_ss;
+    uint32_t m_nsec = 0;           //时间戳的纳秒部分
+    LogStream m_ss;
+    LogFields m_fields;
 
     std::shared_ptr<Logger> m_logger;
     LogLevel::Level m_level;
+    LogCallSite* m_site = nullptr;
+    const char* m_binaryFormat = nullptr;
+};
+
+//日志语句中的结构化字段 LCH_LOG_INFO(g_logger) << "login" << lch::kv("user", name) << lch::kv("cost_ms", 12);
+//写入LogStream时记为事件的字段，写入其他流时输出 key=value
+template<class T>
+struct LogKV {
+    const char* key;
+    const T& value;
+};
+
+template<class T>
+LogKV<T> kv(const char* key, const T& value) {
+    return LogKV<T>{key, value};
+}
+
+template<class T>
+std::ostream& operator<<(std::ostream& os, const LogKV<T>& kv) {
+    LogStream* ls = dynamic_cast<LogStream*>(&os);
+    if (ls && ls->getFields()) {
+        ls->getFields()->add(kv.key, kv.value);
+    } else {
+        os << kv.key << "=" << kv.value;
+    }
+    return os;
+}
+
+//二进制日志的参数编码 每个参数一个类型字节加原始数据
+class BinLogArgs {
+public:
+    enum Type {
+        INT = 'i',      //int64_t
+        UINT = 'u',     //uint64_t
+        DOUBLE = 'd',   //double
+        STRING = 's',   //uint32_t长度 + 内容
+        POINTER = 'p'   //uint64_t
+    };
+
+    static void Encode(LogStream& os) {}
+
+    template<class T, class... Args>
+    static void Encode(LogStream& os, const T& v, const Args&... args) {
+        Put(os, v);
+        Encode(os, args...);
+    }
+
+    //按printf格式串把编码的参数还原成文本
+    static std::string Decode(const char* fmt, const char* data, size_t len);
+    //解码到定长缓冲区，超出部分截断，不分配内存，返回写入的长度
+    static size_t Decode(const char* fmt, const char* data, size_t len, char* buf, size_t size);
+private:
+    template<class T>
+    static typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    Put(LogStream& os, T v) { PutRaw(os, INT, (int64_t)v); }
+
+    template<class T>
+    static typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    Put(LogStream& os, T v) { PutRaw(os, UINT, (uint64_t)v); }
+
+    template<class T>
+    static typename std::enable_if<std::is_floating_point<T>::value>::type
+    Put(LogStream& os, T v) { PutRaw(os, DOUBLE, (double)v); }
+
+    template<class T>
+    static typename std::enable_if<std::is_enum<T>::value>::type
+    Put(LogStream& os, T v) { PutRaw(os, INT, (int64_t)v); }
+
+    static void Put(LogStream& os, const char* v) { PutString(os, v ? v : "(null)", v ? strlen(v) : 6); }
+    static void Put(LogStream& os, char* v) { Put(os, (const char*)v); }
+    static void Put(LogStream& os, const std::string& v) { PutString(os, v.c_str(), v.size()); }
+    template<class T>
+    static void Put(LogStream& os, T* v) { PutRaw(os, POINTER, (uint64_t)(uintptr_t)v); }
+
+    template<class T>
+    static void PutRaw(LogStream& os, Type type, T v) {
+        char buf[1 + sizeof(T)];
+        buf[0] = type;
+        memcpy(buf + 1, &v, sizeof(v));
+        os.append(buf, sizeof(buf));
+    }
+    static void PutString(LogStream& os, const char* v, size_t len) {
+        char buf[1 + sizeof(uint32_t)];
+        uint32_t l = len;
+        buf[0] = STRING;
+        memcpy(buf + 1, &l, sizeof(l));
+        os.append(buf, sizeof(buf));
+        os.append(v, len);
+    }
+};
+
+//日志调用点的限流状态，由LCH_LOG_EVERY_N等宏为每个调用点生成一个静态对象
+//各方法返回0表示丢弃这一条，否则返回1+上次输出以来丢弃的条数
+class LogRateLimiter {
+public:
+    constexpr LogRateLimiter() : m_count(0), m_suppressed(0), m_last(0) {}
+
+    uint64_t everyN(uint64_t n) {
+        return m_count.fetch_add(1, std::memory_order_relaxed) % (n ? n : 1) == 0 ? pass() : drop();
+    }
+    //超过n次之后不再输出，丢弃的条数也就没有机会报告
+    uint64_t firstN(uint64_t n) {
+        return m_count.load(std::memory_order_relaxed) < n
+            && m_count.fetch_add(1, std::memory_order_relaxed) < n ? 1 : 0;
+    }
+    uint64_t everyMs(uint64_t ms);
+    //GCRA形式的令牌桶，只用一个原子变量记录理论到达时间
+    uint64_t tokenBucket(double rate, uint64_t burst);
+
+    uint64_t getSuppressed() const { return m_suppressed.load(std::memory_order_relaxed); }
+private:
+    uint64_t pass() { return m_suppressed.exchange(0, std::memory_order_relaxed) + 1; }
+    uint64_t drop() { m_suppressed.fetch_add(1, std::memory_order_relaxed); return 0; }
+private:
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_suppressed;
+    //everyMs为上次输出的时间，tokenBucket为理论到达时间，单位纳秒
+    std::atomic<uint64_t> m_last;
 };
 
 class LogEventWrap {
 public:
     LogEventWrap(LogEvent::ptr e);
     ~LogEventWrap();
-    std::stringstream& getSS();
-    LogEvent::ptr getEvent() {return m_event;}
+    LogStream& getSS();
+    //限流宏使用，先写入之前被丢弃的条数
+    LogStream& getSS(uint64_t suppressed);
+    const LogEvent::ptr& getEvent() {return m_event;}
+
+    //Logger为二进制模式时只编码参数，否则按printf格式化
+    //fmt必须是字符串常量：二进制模式下事件只保存fmt指针，并且每个调用点只记录一次格式串
+    //std::string按%s的C字符串传入，两种模式结果相同
+    template<class... Args>
+    void format(const char* fmt, const Args&... args) {
+        if (isBinary()) {
+            m_event->setBinaryFormat(fmt);
+            BinLogArgs::Encode(m_event->getSS(), args...);
+        } else {
+            m_event->format(fmt, Arg(args)...);
+        }
+    }
+private:
+    bool isBinary() const;
+    //可变参数只能传递可平凡复制的值
+    template<class T>
+    static const T& Arg(const T& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "LCH_LOG_FMT argument must be trivially copyable");
+        return v;
+    }
+    static const char* Arg(const std::string& v) { return v.c_str(); }
 private:
     LogEvent::ptr m_event;
 };
@@ -124,6 +494,10 @@ public:
 
     //"%t   %thread_id %m%n"
     std::string format(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
+    //按init时编译好的操作码直接追加到buf中，不经过ostream和中间字符串
+    void format(std::string& buf, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event);
+    //逐个调用FormatItem输出到流中
+    std::ostream& format(std::ostream& ofs, std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event);
 public:
     class FormatItem {
     public:
@@ -138,9 +512,17 @@ public:
 
     const std::string getPattern() const { return m_pattern;}
 
+private:
+    //编译后的格式化操作
+    struct FormatOp {
+        int code;
+        std::string str;        //普通字符串
+        FormatItem::ptr item;   //需要额外状态的占位符，如%d
+    };
 private:
     std::string m_pattern;
     std::vector<FormatItem::ptr> m_items;
+    std::vector<FormatOp> m_ops;
     bool m_error = false;
 };
 
@@ -149,38 +531,147 @@ class LogAppender {
 friend class Logger;
 public:
     typedef std::shared_ptr<LogAppender> ptr;
+    //share_formatted为true表示可以直接写入按formatter()格式化好的内容，
+    //Logger对使用同一个格式器的这类appender只格式化一次，见logFormatted
+    LogAppender(bool share_formatted = false) : m_formatterPtr(nullptr), m_shareFormatted(share_formatted) {}
     virtual ~LogAppender() {}
 
     virtual void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) = 0;
+    //写入已经按formatter()格式化好的text，由Logger在级别判断之后调用
+    //默认忽略text直接调用log，自定义的appender不需要关心
+    virtual void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                              , const LogEvent::ptr& event, const std::string& text);
     virtual std::string toYamlString() = 0;
 
-    void setFormatter(LogFormatter::ptr val) {
-        m_formatter = val; 
-        if (m_formatter) {
-            m_hasFormatter = true;
-        } else {
-            m_hasFormatter = false;
-        }
-    }
-    LogFormatter::ptr getFormatter() const { return m_formatter; }
+    void setFormatter(LogFormatter::ptr val);
+    LogFormatter::ptr getFormatter();
 
     LogLevel::Level getLevel() const { return m_level; }
     void setLevel(LogLevel::Level val) { m_level = val; }
+protected:
+    //写日志时取格式器，只能在Logger::log的调用链(Rcu读临界区)内使用
+    LogFormatter* formatter() const { return m_formatterPtr.load(std::memory_order_acquire); }
+private:
+    //替换格式器，旧的格式器等正在使用它的读者离开后才释放
+    void updateFormatter(LogFormatter::ptr val);
 protected:
     LogLevel::Level m_level = LogLevel::DEBUG;
     LogFormatter::ptr m_formatter;
+    std::atomic<LogFormatter*> m_formatterPtr;
     /// 是否有自己的日志格式器
     bool m_hasFormatter = false;
+    Mutex m_mutex;
+private:
+    bool m_shareFormatted;
+};
+
+//异步日志分发器 生产者线程把日志事件压入无锁环形队列，由独立线程取出后写入appender
+class AsyncLogDispatcher : public std::enable_shared_from_this<AsyncLogDispatcher> {
+public:
+    typedef std::shared_ptr<AsyncLogDispatcher> ptr;
+    //队列满时的处理策略
+    enum OverflowPolicy {
+        BLOCK = 0,          //阻塞生产者直到有空位
+        DROP_NEWEST = 1,    //丢弃新日志
+        DROP_COUNT = 2      //丢弃新日志，并由后台线程输出丢弃条数
+    };
+
+    static const char* ToString(OverflowPolicy policy);
+    static OverflowPolicy FromString(const std::string& str);
+
+    AsyncLogDispatcher(std::shared_ptr<Logger> logger, size_t capacity, OverflowPolicy policy);
+    ~AsyncLogDispatcher();
+
+    void start();
+    //停止后台线程，停止前会把队列中剩余的日志全部输出
+    void stop();
+
+    //返回false表示日志被丢弃
+    bool push(LogLevel::Level level, LogEvent::ptr event);
+
+    size_t getCapacity() const { return m_queue.capacity(); }
+    OverflowPolicy getPolicy() const { return m_policy; }
+    uint64_t getDropped() const { return m_dropped; }
+private:
+    struct Item {
+        LogLevel::Level level = LogLevel::UNKNOW;
+        LogEvent::ptr event;
+    };
+    void run();
+    size_t drain();
+    void notify();
+private:
+    std::weak_ptr<Logger> m_logger;
+    MPSCRingQueue<Item> m_queue;
+    OverflowPolicy m_policy;
+    std::shared_ptr<Thread> m_thread;
+    Semaphore m_sem;
+    std::atomic<bool> m_sleeping;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_reported = 0;
+};
+
+//连续重复日志的合并 (文件, 行号, 级别, 内容)和上一条相同时不输出，只计数，
+//内容变化时先输出"last message repeated N times"再输出新的一条；
+//重复开始后超过timeout毫秒还没有报告的次数由后台线程输出，之后继续重复会重新计数
+class LogDeduplicator : public std::enable_shared_from_this<LogDeduplicator> {
+public:
+    typedef std::shared_ptr<LogDeduplicator> ptr;
+    LogDeduplicator(std::shared_ptr<Logger> logger, uint32_t timeout);
+    ~LogDeduplicator();
+
+    void start();
+    //停止后台线程，停止前输出还没报告的重复次数
+    void stop();
+
+    //返回false表示和上一条重复，已经合并；summary非空时要在这一条之前输出
+    bool check(LogLevel::Level level, const LogEvent::ptr& event, LogEvent::ptr& summary);
+    //输出还没报告的重复次数
+    void flush();
+
+    uint32_t getTimeout() const { return m_timeout; }
+    //合并掉的总条数
+    uint64_t getSuppressed() const { return m_suppressed; }
+
+    static uint64_t Hash(LogLevel::Level level, const LogEvent& event);
+private:
+    //生成重复次数的日志并清零，调用者持有m_mutex
+    LogEvent::ptr takeSummary(const std::shared_ptr<Logger>& logger);
+    void run();
+private:
+    std::weak_ptr<Logger> m_logger;
+    uint32_t m_timeout;
+    Mutex m_mutex;
+    //上一条日志的hash，0表示还没有
+    uint64_t m_hash = 0;
+    //还没报告的重复次数，以及第一次重复的日志信息
+    uint64_t m_repeats = 0;
+    uint64_t m_firstRepeat = 0;
+    LogLevel::Level m_level = LogLevel::UNKNOW;
+    const char* m_file = nullptr;
+    int32_t m_line = 0;
+    uint32_t m_threadId = 0;
+    uint32_t m_fiberId = 0;
+    std::string m_threadName;
+    std::shared_ptr<Thread> m_thread;
+    Semaphore m_sem;
+    std::atomic<bool> m_stopping;
+    std::atomic<uint64_t> m_suppressed;
 };
 
 //日志器
 class Logger : public std::enable_shared_from_this<Logger> {
 
 friend class LoggerManager;
+friend class AsyncLogDispatcher;
+friend class LogDeduplicator;
 
 public:
     typedef std::shared_ptr<Logger>  ptr;
+    typedef std::vector<LogAppender::ptr> AppenderList;
     Logger(const std::string& name = "root");
+    ~Logger();
     void log(LogLevel::Level level, LogEvent::ptr event);
 
     void debug(LogEvent::ptr event);
@@ -192,8 +683,14 @@ public:
     void addAppender(LogAppender::ptr appender);
     void delAppender(LogAppender::ptr appender);
     void clearAppender();
-    LogLevel::Level getLevel() const {return m_level;}
-    void setLevel(LogLevel::Level level) {m_level = level;}
+    //一次替换全部appender，正在写的日志看到的要么是旧列表要么是新列表
+    void setAppenders(const AppenderList& appenders);
+    //没有设置过级别时返回从上级继承的级别
+    LogLevel::Level getLevel() const { return m_level.load(std::memory_order_relaxed); }
+    void setLevel(LogLevel::Level level);
+    //清除设置的级别，改为从上级继承
+    void inheritLevel();
+    bool isLevelSet() const { return m_levelSet.load(std::memory_order_relaxed); }
 
     const std::string& getName() const { return m_name; }
 
@@ -205,52 +702,263 @@ public:
 
     std::string toYamlString();
 
+    //切换为异步输出，capacity为队列长度
+    void startAsync(size_t capacity = 8192,
+                    AsyncLogDispatcher::OverflowPolicy policy = AsyncLogDispatcher::BLOCK);
+    //切换回同步输出，队列中的日志会先输出完
+    void stopAsync();
+    bool isAsync() const { return m_async.load() != nullptr; }
+    AsyncLogDispatcher::ptr getAsync();
+
+    //切换为二进制日志，日志不再经过appender，而是写入file，由binlog_decode还原
+    bool startBinary(const std::string& file);
+    void stopBinary();
+    bool isBinary() const { return m_binary.load() != nullptr; }
+    std::string getBinaryFile();
+
+    //合并连续重复的日志，timeout为重复次数最晚多久输出(毫秒)
+    void startDedup(uint32_t timeout = 1000);
+    //停止合并，还没报告的重复次数会先输出
+    void stopDedup();
+    bool isDedup() const { return m_dedup.load() != nullptr; }
+    LogDeduplicator::ptr getDedup();
+
+    //进程内唯一的编号
+    uint32_t getId() const { return m_id; }
+
+private:
+    //交给异步队列或者直接写入appender，不经过合并
+    void dispatch(LogLevel::Level level, LogEvent::ptr event);
+    //直接写入appender，没有appender时交给上级
+    void doLog(LogLevel::Level level, LogEvent::ptr event);
+    //替换appender快照，旧快照等读者离开后释放，调用者持有m_mutex
+    void publish(AppenderList* appenders);
+    //级别或appender变化后，由LoggerManager重新计算下级的继承关系
+    void changed();
 private:
     std::string m_name;                    //日志名称
-    LogLevel::Level m_level;               //日志级别
-    std::list<LogAppender::ptr> m_appenders;//appender集合
+    //配置线程修改、写日志的线程读取，修改后通过LogCallSite::Invalidate发布
+    std::atomic<LogLevel::Level> m_level;  //日志级别
+    //appender集合 写时复制，写日志时通过原子指针读取不可变的快照，不加锁
+    std::atomic<const AppenderList*> m_appenders;
     LogFormatter::ptr m_formatter;
-
-    Logger::ptr m_root;
+    std::atomic<AsyncLogDispatcher*> m_async;  //非空时为异步模式
+    AsyncLogDispatcher::ptr m_asyncHolder;
+    std::atomic<BinLogWriter*> m_binary;      //非空时为二进制模式
+    std::shared_ptr<BinLogWriter> m_binaryHolder;
+    std::atomic<LogDeduplicator*> m_dedup;    //非空时合并重复日志
+    LogDeduplicator::ptr m_dedupHolder;
+    uint32_t m_id;
+    //修改appender集合、格式器、异步设置时加锁
+    Mutex m_mutex;
+
+    std::atomic<bool> m_levelSet;     //级别是否设置过，否则从上级继承
+    bool m_managed;                        //由LoggerManager创建
+    //有appender的最近上级，由LoggerManager在配置变化时计算，没有appender时日志直接交给它
+    std::atomic<Logger*> m_parent;
 };
 
 //输出到控制台的Appender
 class StdoutLogAppender : public LogAppender {
 public:
     typedef std::shared_ptr<StdoutLogAppender> ptr;
+    StdoutLogAppender() : LogAppender(true) {}
     ~StdoutLogAppender() {}
     void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+};
+
+//输出到控制台的Appender 自己维护缓冲区，用write/writev直接写fd，不经过iostream
+//LINE每行写一次；BLOCK缓冲区满了才写；AUTO在终端上按行，重定向到文件或管道时按块
+//另外可以按时间间隔由后台线程刷新，级别不低于flush_level的日志立即刷新
+class ConsoleLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<ConsoleLogAppender> ptr;
+
+    enum FlushPolicy {
+        AUTO = 0,
+        LINE = 1,
+        BLOCK = 2
+    };
+    static const char* ToString(FlushPolicy policy);
+    static FlushPolicy FromString(const std::string& str);
+
+    //fd为STDOUT_FILENO或STDERR_FILENO，flush_interval为0表示不按时间刷新(毫秒)
+    ConsoleLogAppender(int fd = 1, FlushPolicy policy = AUTO, size_t buffer_size = 64 * 1024
+                       , uint32_t flush_interval = 1000, LogLevel::Level flush_level = LogLevel::ERROR);
+    ~ConsoleLogAppender();
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
     std::string toYamlString() override;
+    void flush();
+
+    int getFd() const { return m_fd; }
+    FlushPolicy getPolicy() const { return m_policy; }
+    //AUTO解析之后实际使用的方式
+    bool isLineBuffered() const { return m_lineBuffered; }
+    size_t getBufferSize() const { return m_bufferSize; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+    LogLevel::Level getFlushLevel() const { return m_flushLevel; }
+
+    //后台线程定时刷新的缓冲区
+    struct Buffer;
+private:
+    int m_fd;
+    FlushPolicy m_policy;
+    bool m_lineBuffered;
+    size_t m_bufferSize;
+    uint32_t m_flushInterval;
+    LogLevel::Level m_flushLevel;
+    std::shared_ptr<Buffer> m_buffer;
 };
 
 //输出到文件的Appender
 class FileLogAppender : public LogAppender {
 public:
     typedef std::shared_ptr<FileLogAppender> ptr;
-    FileLogAppender(const std::string& filename);
+    //index_records、index_bytes不全为0时同时写时间索引(文件名加.idx)，
+    //每index_records条或者每index_bytes字节日志记一项，见LogIndexReader
+    FileLogAppender(const std::string& filename, uint32_t index_records = 0, uint64_t index_bytes = 0);
     ~FileLogAppender() {}
     void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
     std::string toYamlString() override;
     
     //重新打开文件，成功返回true，失败返回false
     bool reopen();
+    uint32_t getIndexRecords() const { return m_indexRecords; }
+    uint64_t getIndexBytes() const { return m_indexBytes; }
 private:
     std::string m_filename;
     std::ofstream m_filestream;
+    uint32_t m_indexRecords;
+    uint64_t m_indexBytes;
+    //写索引时日志在文件中的偏移，只在m_mutex内访问
+    uint64_t m_offset = 0;
+    std::shared_ptr<LogIndexWriter> m_index;
+};
+
+//通过内存映射写文件的Appender
+//文件按chunk_size分块用fallocate预分配并映射，写者用原子fetch_add在写偏移上占位后直接拷贝，
+//多个线程写同一个文件不需要加锁。下一块的映射和旧块的解除映射在后台线程完成，
+//关闭或reopen时把文件截断到实际写入的长度
+class MmapFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<MmapFileLogAppender> ptr;
+    //chunk_size会向上取整为页大小的整数倍
+    MmapFileLogAppender(const std::string& filename, uint64_t chunk_size = 32 * 1024 * 1024);
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+
+    //截断并关闭当前文件后重新打开(追加写)，成功返回true
+    bool reopen();
+    const std::string& getFilename() const { return m_filename; }
+    uint64_t getChunkSize() const { return m_chunkSize; }
+private:
+    struct File;
+private:
+    std::string m_filename;
+    uint64_t m_chunkSize;
+    std::atomic<File*> m_file;
+    std::shared_ptr<File> m_fileHolder;
+};
+
+//每条日志输出一行JSON的Appender，不使用LogFormatter
+//固定输出time level logger thread_id thread_name fiber_id file line msg，事件的字段平铺在后面
+//用O_APPEND的write整行写出，多个线程写同一个文件不需要加锁
+class JsonLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<JsonLogAppender> ptr;
+    //filename为空时输出到标准输出
+    JsonLogAppender(const std::string& filename = "");
+    ~JsonLogAppender();
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    //重新打开文件(追加写)，成功返回true
+    bool reopen();
+    const std::string& getFilename() const { return m_filename; }
+
+    //把事件序列化成一行JSON(带换行)追加到buf中
+    static void Format(std::string& buf, const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event);
+    //按JSON字符串的规则转义后追加到buf中，不加引号
+    //支持SSE2时一次检查16字节，否则逐字节检查，没有需要转义的字符就整段拷贝
+    static void Escape(std::string& buf, const char* str, size_t len);
+private:
+    std::string m_filename;
+    std::atomic<int> m_fd;
 };
 
+//按大小和时间切分的文件Appender
+//写日志的线程只负责发现需要切分，改名、打开新文件和删除旧文件都在后台线程完成，
+//切换完成之前的日志仍然写进旧文件，所以归档文件可能略大于max_size
+class RotatingFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<RotatingFileLogAppender> ptr;
+
+    enum Interval {
+        NONE = 0,
+        HOURLY = 1,
+        DAILY = 2
+    };
+    static const char* ToString(Interval interval);
+    static Interval FromString(const std::string& str);
 
+    //max_size为0表示不按大小切分，max_files为保留的归档文件个数，0表示不删除
+    RotatingFileLogAppender(const std::string& filename, uint64_t max_size
+                            , Interval interval = NONE, uint32_t max_files = 0);
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+
+    const std::string& getFilename() const { return m_filename; }
+    uint64_t getMaxSize() const { return m_maxSize; }
+    Interval getInterval() const { return m_interval; }
+    uint32_t getMaxFiles() const { return m_maxFiles; }
+    //等待已经发起的切分完成
+    void waitRotate();
+private:
+    //后台线程和Appender共享的文件状态，Appender析构后切分任务仍可以安全执行
+    struct File;
+private:
+    std::string m_filename;
+    uint64_t m_maxSize;
+    Interval m_interval;
+    uint32_t m_maxFiles;
+    std::shared_ptr<File> m_file;
+};
+
+
+//Logger管理器
+//名字按'.'分层，a.b.c的上级依次是a.b、a、root
+//没有设置级别的Logger使用最近一个设置了级别的上级的级别，没有appender的Logger输出到最近一个有appender的上级
+//继承关系在创建Logger以及级别、appender变化时计算好，写日志时不再查找
 class LoggerManager {
 public:
     LoggerManager();
+    ~LoggerManager();
     Logger::ptr getLogger(const std::string& name);
 
     void init();
     Logger::ptr getRoot() const { return m_root; }
 
+    //重新计算所有Logger继承的级别和上级
+    void resolve();
+
     std::string toYamlString();
 
 private:
+    //计算一个Logger继承的级别和上级，调用者持有写锁
+    void resolve(Logger* logger);
+private:
+    RWMutex m_mutex;
     std::map<std::string, Logger::ptr> m_loggers;
     Logger::ptr m_root;
 };
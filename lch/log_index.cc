@@ -0,0 +1,306 @@
+#include "log_index.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <algorithm>
+
+namespace lch {
+
+const char LogIndex::MAGIC[8] = {'L', 'C', 'H', 'L', 'I', 'D', 'X', 1};
+
+std::string LogIndex::IndexFile(const std::string& filename) {
+    return filename + ".idx";
+}
+
+uint64_t LogIndex::LoggerBits(const std::string& name) {
+    //FNV-1a，取两段6位作为位图中的两位
+    uint64_t h = 14695981039346656037ull;
+    for (auto c : name) {
+        h ^= (uint8_t)c;
+        h *= 1099511628211ull;
+    }
+    return (1ull << (h & 63)) | (1ull << ((h >> 6) & 63));
+}
+
+/*******************************LogIndexWriter*********************************/
+LogIndexWriter::LogIndexWriter(const std::string& filename, uint32_t records, uint64_t bytes)
+    :m_filename(filename)
+    ,m_records(records)
+    ,m_bytes(bytes)
+    ,m_fd(-1) {
+}
+
+LogIndexWriter::~LogIndexWriter() {
+    flush();
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+}
+
+bool LogIndexWriter::reopen(uint64_t log_size) {
+    flush();
+    if (m_fd >= 0) {
+        close(m_fd);
+    }
+    m_cur = LogIndexEntry();
+    m_fd = open(m_filename.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (m_fd < 0) {
+        std::cout << "LogIndexWriter open " << m_filename << " failed: "
+                  << strerror(errno) << std::endl;
+        return false;
+    }
+    struct stat st;
+    char magic[sizeof(LogIndex::MAGIC)];
+    bool reset = log_size == 0 || fstat(m_fd, &st) != 0 || st.st_size < (off_t)sizeof(magic)
+                 || pread(m_fd, magic, sizeof(magic), 0) != (ssize_t)sizeof(magic)
+                 || memcmp(magic, LogIndex::MAGIC, sizeof(magic)) != 0;
+    if (!reset) {
+        //去掉写了一半的记录；最后一块超出日志文件说明日志文件已经换过了
+        off_t valid = st.st_size - (st.st_size - sizeof(magic)) % sizeof(LogIndexEntry);
+        if (valid != st.st_size && ftruncate(m_fd, valid) != 0) {
+            reset = true;
+        }
+        LogIndexEntry last;
+        if (valid > (off_t)sizeof(magic)
+                && (pread(m_fd, &last, sizeof(last), valid - sizeof(last)) != (ssize_t)sizeof(last)
+                    || last.offset + last.size > log_size)) {
+            reset = true;
+        }
+    }
+    if (reset) {
+        if (ftruncate(m_fd, 0) != 0
+                || write(m_fd, LogIndex::MAGIC, sizeof(LogIndex::MAGIC)) != (ssize_t)sizeof(LogIndex::MAGIC)) {
+            std::cout << "LogIndexWriter reset " << m_filename << " failed: "
+                      << strerror(errno) << std::endl;
+            close(m_fd);
+            m_fd = -1;
+            return false;
+        }
+    }
+    return true;
+}
+
+void LogIndexWriter::append(uint64_t offset, uint64_t size, uint64_t time, LogLevel::Level level, const std::string& logger) {
+    if (m_cur.count == 0) {
+        m_cur.offset = offset;
+        m_cur.minTime = time;
+        m_cur.maxTime = time;
+    } else if (time < m_cur.minTime) {
+        m_cur.minTime = time;
+    } else if (time > m_cur.maxTime) {
+        m_cur.maxTime = time;
+    }
+    m_cur.size = offset + size - m_cur.offset;
+    ++m_cur.count;
+    m_cur.levels |= 1u << level;
+    m_cur.loggers |= LogIndex::LoggerBits(logger);
+    if ((m_records && m_cur.count >= m_records) || (m_bytes && m_cur.size >= m_bytes)) {
+        flush();
+    }
+}
+
+void LogIndexWriter::flush() {
+    if (m_cur.count == 0) {
+        return;
+    }
+    if (m_fd >= 0 && write(m_fd, &m_cur, sizeof(m_cur)) != (ssize_t)sizeof(m_cur)) {
+        std::cout << "LogIndexWriter write " << m_filename << " failed: "
+                  << strerror(errno) << std::endl;
+    }
+    m_cur = LogIndexEntry();
+}
+
+/*******************************LogIndexReader*********************************/
+LogIndexReader::LogIndexReader(const std::string& filename)
+    :m_filename(filename)
+    ,m_data(nullptr)
+    ,m_size(0)
+    ,m_index(nullptr)
+    ,m_indexSize(0)
+    ,m_entries(nullptr)
+    ,m_count(0)
+    ,m_scanned(0)
+    ,m_lastTime(0)
+    ,m_valid(false) {
+    int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return;
+    }
+    m_size = st.st_size;
+    if (m_size) {
+        void* data = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data == MAP_FAILED) {
+            close(fd);
+            return;
+        }
+        m_data = (const char*)data;
+    }
+    close(fd);
+    m_valid = true;
+
+    fd = open(LogIndex::IndexFile(filename).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return;
+    }
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)(sizeof(LogIndex::MAGIC) + sizeof(LogIndexEntry))) {
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        if (data != MAP_FAILED) {
+            m_index = data;
+            m_indexSize = st.st_size;
+            if (memcmp(data, LogIndex::MAGIC, sizeof(LogIndex::MAGIC)) == 0) {
+                m_entries = (const LogIndexEntry*)((const char*)data + sizeof(LogIndex::MAGIC));
+                m_count = (st.st_size - sizeof(LogIndex::MAGIC)) / sizeof(LogIndexEntry);
+            }
+        }
+    }
+    close(fd);
+}
+
+LogIndexReader::~LogIndexReader() {
+    if (m_data) {
+        munmap((void*)m_data, m_size);
+    }
+    if (m_index) {
+        munmap(m_index, m_indexSize);
+    }
+}
+
+uint64_t LogIndexReader::query(const Query& q, std::function<void(const char* data, size_t len)> cb) {
+    m_scanned = 0;
+    m_lastPrefix.clear();
+    uint64_t matched = 0;
+    if (!m_data) {
+        return 0;
+    }
+    uint64_t start = q.start > UINT64_MAX / 1000000 ? UINT64_MAX : q.start * 1000000;
+    uint64_t end = q.end >= UINT64_MAX / 1000000 ? UINT64_MAX : (q.end + 1) * 1000000 - 1;
+    uint32_t levels = ~0u;
+    if (q.level != LogLevel::UNKNOW) {
+        levels = 0;
+        for (int l = q.level; l <= LogLevel::FATAL; ++l) {
+            levels |= 1u << l;
+        }
+    }
+    uint64_t loggers = q.logger.empty() ? 0 : LogIndex::LoggerBits(q.logger);
+
+    //相邻要扫描的部分合并成一段
+    uint64_t begin = 0;
+    uint64_t stop = 0;
+    auto add = [&](uint64_t b, uint64_t e) {
+        if (b != stop) {
+            scan(begin, stop, q, matched, cb);
+            begin = b;
+        }
+        stop = e;
+    };
+    uint64_t pos = 0;
+    for (size_t i = 0; i < m_count; ++i) {
+        const LogIndexEntry& e = m_entries[i];
+        uint64_t b = std::max(std::min(e.offset, m_size), pos);
+        uint64_t en = std::min(e.offset + e.size, m_size);
+        if (en <= b) {
+            continue;
+        }
+        //索引没有覆盖的部分
+        if (b > pos) {
+            add(pos, b);
+        }
+        if (e.maxTime >= start && e.minTime <= end && (e.levels & levels)
+                && (e.loggers & loggers) == loggers) {
+            add(b, en);
+        }
+        pos = en;
+    }
+    if (pos < m_size) {
+        add(pos, m_size);
+    }
+    scan(begin, stop, q, matched, cb);
+    return matched;
+}
+
+void LogIndexReader::scan(uint64_t begin, uint64_t end, const Query& q, uint64_t& matched
+                          , std::function<void(const char* data, size_t len)>& cb) {
+    if (begin >= end) {
+        return;
+    }
+    m_scanned += end - begin;
+    std::vector<std::string> levels;
+    if (q.level != LogLevel::UNKNOW) {
+        for (int l = q.level; l <= LogLevel::FATAL; ++l) {
+            levels.push_back(std::string("[") + LogLevel::ToString((LogLevel::Level)l) + "]");
+        }
+    }
+    std::string logger = q.logger.empty() ? "" : "[" + q.logger + "]";
+
+    uint64_t record = end;
+    bool match = false;
+    uint64_t pos = begin;
+    while (pos < end) {
+        const char* line = m_data + pos;
+        const char* nl = (const char*)memchr(line, '\n', end - pos);
+        uint64_t next = nl ? nl - m_data + 1 : end;
+        size_t len = next - pos;
+
+        //解析行首的时间，和上一行前缀相同时直接用上一次的结果
+        bool has_time = false;
+        uint64_t t = 0;
+        if (!m_lastPrefix.empty() && len >= m_lastPrefix.size()
+                && memcmp(line, m_lastPrefix.data(), m_lastPrefix.size()) == 0) {
+            has_time = true;
+            t = m_lastTime;
+        } else {
+            char buf[64];
+            size_t n = std::min(len, sizeof(buf) - 1);
+            memcpy(buf, line, n);
+            buf[n] = '\0';
+            struct tm tm;
+            memset(&tm, 0, sizeof(tm));
+            const char* p = strptime(buf, q.timeFormat.c_str(), &tm);
+            if (p) {
+                tm.tm_isdst = -1;
+                time_t v = mktime(&tm);
+                if (v >= 0) {
+                    has_time = true;
+                    t = v;
+                    m_lastPrefix.assign(buf, p - buf);
+                    m_lastTime = t;
+                }
+            }
+        }
+
+        if (has_time) {
+            if (match) {
+                ++matched;
+                cb(m_data + record, pos - record);
+            }
+            record = pos;
+            match = t >= q.start && t <= q.end;
+            if (match && !levels.empty()) {
+                match = false;
+                for (auto& i : levels) {
+                    if (memmem(line, len, i.data(), i.size())) {
+                        match = true;
+                        break;
+                    }
+                }
+            }
+            if (match && !logger.empty()) {
+                match = memmem(line, len, logger.data(), logger.size()) != nullptr;
+            }
+        }
+        pos = next;
+    }
+    if (match) {
+        ++matched;
+        cb(m_data + record, end - record);
+    }
+}
+
+}
@@ -0,0 +1,110 @@
+#ifndef __LCH_LOG_INDEX_H__
+#define __LCH_LOG_INDEX_H__
+
+#include <string>
+#include <memory>
+#include <functional>
+#include <vector>
+#include "log.h"
+
+namespace lch {
+
+//日志文件的稀疏时间索引，和日志文件放在一起，文件名为 日志文件名 + ".idx"
+//  文件头: "LCHLIDX\x01"
+//  之后是定长的LogIndexEntry(本机字节序)，每个描述日志文件中连续的一段(块)，
+//  块在每N条或者每M字节日志之后结束，块内的日志都是完整的
+//查询时先用索引跳过时间、级别、Logger都对不上的块，只扫描剩下的部分
+class LogIndex {
+public:
+    static const char MAGIC[8];
+    //日志文件对应的索引文件名
+    static std::string IndexFile(const std::string& filename);
+    //Logger名字在LogIndexEntry::loggers中对应的位
+    static uint64_t LoggerBits(const std::string& name);
+};
+
+struct LogIndexEntry {
+    uint64_t offset = 0;    //块在日志文件中的偏移
+    uint64_t size = 0;      //块的字节数
+    uint64_t minTime = 0;   //块中最早的日志时间(微秒)
+    uint64_t maxTime = 0;   //块中最晚的日志时间(微秒)
+    uint64_t loggers = 0;   //块中出现过的Logger，见LogIndex::LoggerBits
+    uint32_t count = 0;     //块中的日志条数
+    uint32_t levels = 0;    //块中出现过的级别 1 << level
+};
+
+//索引写入者 由FileLogAppender在写日志的锁内调用
+class LogIndexWriter {
+public:
+    typedef std::shared_ptr<LogIndexWriter> ptr;
+    //records、bytes为0表示不按这个条件分块，不能都为0
+    LogIndexWriter(const std::string& filename, uint32_t records, uint64_t bytes);
+    //写出没结束的块
+    ~LogIndexWriter();
+
+    //日志文件重新打开后调用，log_size为日志文件当前的大小
+    //日志文件是空的时候清空旧的索引
+    bool reopen(uint64_t log_size);
+    //记录从offset开始的一条日志
+    void append(uint64_t offset, uint64_t size, uint64_t time, LogLevel::Level level, const std::string& logger);
+    //结束当前的块并写出
+    void flush();
+
+    const std::string& getFilename() const { return m_filename; }
+    uint32_t getRecords() const { return m_records; }
+    uint64_t getBytes() const { return m_bytes; }
+private:
+    std::string m_filename;
+    uint32_t m_records;
+    uint64_t m_bytes;
+    int m_fd;
+    LogIndexEntry m_cur;
+};
+
+//按索引查询日志文件，日志文件和索引都用mmap读取
+//每条日志的时间从行首按time_format解析(本地时间，精确到秒)，
+//不以时间开头的行属于上一条日志；级别和Logger按格式器中的[%p]、[%c]匹配
+//没有索引或者索引没有覆盖到的部分会整段扫描
+class LogIndexReader {
+public:
+    struct Query {
+        uint64_t start = 0;                 //开始时间(秒)，包含
+        uint64_t end = UINT64_MAX;          //结束时间(秒)，包含
+        LogLevel::Level level = LogLevel::UNKNOW;   //只要不低于这个级别的日志
+        std::string logger;                 //为空表示不按Logger过滤
+        std::string timeFormat = "%Y-%m-%d %H:%M:%S";
+    };
+
+    LogIndexReader(const std::string& filename);
+    ~LogIndexReader();
+
+    bool isValid() const { return m_valid; }
+    bool hasIndex() const { return m_entries != nullptr; }
+    size_t getBlocks() const { return m_count; }
+    uint64_t getSize() const { return m_size; }
+
+    //每条匹配的日志(可能有多行)调用一次cb，返回匹配的条数
+    uint64_t query(const Query& q, std::function<void(const char* data, size_t len)> cb);
+    //上一次查询实际扫描的字节数
+    uint64_t getScanned() const { return m_scanned; }
+private:
+    void scan(uint64_t begin, uint64_t end, const Query& q, uint64_t& matched
+              , std::function<void(const char* data, size_t len)>& cb);
+private:
+    std::string m_filename;
+    const char* m_data;
+    uint64_t m_size;
+    void* m_index;
+    uint64_t m_indexSize;
+    const LogIndexEntry* m_entries;
+    size_t m_count;
+    uint64_t m_scanned;
+    //上一次解析的时间前缀，相邻日志的秒数一般相同，不用每行都strptime
+    std::string m_lastPrefix;
+    uint64_t m_lastTime;
+    bool m_valid;
+};
+
+}
+
+#endif // !__LCH_LOG_INDEX_H__
@@ -0,0 +1,36 @@
+#ifndef __LCH_MACROS_H__
+#define __LCH_MACROS_H__
+
+#include <string.h>
+#include <assert.h>
+#include "log.h"
+#include "util.h"
+
+#if defined __GNUC__ || defined __llvm__
+#define LCH_LIKELY(x)       __builtin_expect(!!(x), 1)
+#define LCH_UNLIKELY(x)     __builtin_expect(!!(x), 0)
+#else
+#define LCH_LIKELY(x)       (x)
+#define LCH_UNLIKELY(x)     (x)
+#endif
+
+//断言失败时先把调用栈写到root日志，再交给assert
+#define LCH_ASSERT(x) \
+    if (LCH_UNLIKELY(!(x))) { \
+        LCH_LOG_ERROR(LCH_LOG_ROOT()) << "ASSERTION: " #x \
+            << "\nbacktrace:\n" \
+            << lch::BacktraceToString(100, 2, "    "); \
+        assert(x); \
+    }
+
+//w为附加的说明
+#define LCH_ASSERT2(x, w) \
+    if (LCH_UNLIKELY(!(x))) { \
+        LCH_LOG_ERROR(LCH_LOG_ROOT()) << "ASSERTION: " #x \
+            << "\n" << w \
+            << "\nbacktrace:\n" \
+            << lch::BacktraceToString(100, 2, "    "); \
+        assert(x); \
+    }
+
+#endif // !__LCH_MACROS_H__
@@ -0,0 +1,204 @@
+#include "mutex.h"
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+#include <stdexcept>
+#include <atomic>
+#include <vector>
+
+namespace lch {
+
+Semaphore::Semaphore(uint32_t count) {
+    if (sem_init(&m_semaphore, 0, count)) {
+        throw std::logic_error("sem_init error");
+    }
+}
+
+Semaphore::~Semaphore() {
+    sem_destroy(&m_semaphore);
+}
+
+void Semaphore::wait() {
+    //被信号打断时重新等待
+    while (sem_wait(&m_semaphore)) {
+        if (errno != EINTR) {
+            throw std::logic_error("sem_wait error");
+        }
+    }
+}
+
+bool Semaphore::wait(uint32_t timeout_ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    ts.tv_sec += timeout_ms / 1000;
+    ts.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+    if (ts.tv_nsec >= 1000000000) {
+        ++ts.tv_sec;
+        ts.tv_nsec -= 1000000000;
+    }
+    while (sem_timedwait(&m_semaphore, &ts)) {
+        if (errno == ETIMEDOUT) {
+            return false;
+        }
+        if (errno != EINTR) {
+            throw std::logic_error("sem_timedwait error");
+        }
+    }
+    return true;
+}
+
+void Semaphore::notify() {
+    if (sem_post(&m_semaphore)) {
+        throw std::logic_error("sem_post error");
+    }
+}
+
+/*******************************Rcu*********************************/
+namespace {
+
+struct RcuReader {
+    //0表示不在临界区内，否则为进入时的代数
+    std::atomic<uint64_t> epoch;
+    uint32_t depth = 0;
+    bool free = false;
+    RcuReader() : epoch(0) {}
+};
+
+struct RcuRetired {
+    uint64_t epoch;
+    std::function<void()> cb;
+};
+
+struct RcuDomain {
+    Mutex mutex;
+    std::vector<RcuReader*> readers;
+    std::vector<RcuRetired> retired;
+};
+
+//不析构，避免线程退出晚于静态对象析构
+static RcuDomain* GetRcuDomain() {
+    static RcuDomain* s_domain = new RcuDomain;
+    return s_domain;
+}
+
+static std::atomic<uint64_t> s_rcu_epoch(1);
+static thread_local RcuReader* t_rcu_reader = nullptr;
+
+//线程退出时把槽位还回去给新线程复用
+struct RcuReaderHolder {
+    ~RcuReaderHolder() {
+        if (t_rcu_reader) {
+            RcuDomain* domain = GetRcuDomain();
+            Mutex::Lock lock(domain->mutex);
+            t_rcu_reader->epoch = 0;
+            t_rcu_reader->depth = 0;
+            t_rcu_reader->free = true;
+            t_rcu_reader = nullptr;
+        }
+    }
+};
+
+static RcuReader* GetRcuReader() {
+    if (t_rcu_reader) {
+        return t_rcu_reader;
+    }
+    static thread_local RcuReaderHolder s_holder;
+    (void)s_holder;
+    RcuDomain* domain = GetRcuDomain();
+    Mutex::Lock lock(domain->mutex);
+    for (auto r : domain->readers) {
+        if (r->free) {
+            r->free = false;
+            t_rcu_reader = r;
+            return r;
+        }
+    }
+    t_rcu_reader = new RcuReader;
+    domain->readers.push_back(t_rcu_reader);
+    return t_rcu_reader;
+}
+
+//所有读者都不在代数小于epoch的临界区内时返回true，调用者需持有domain->mutex
+static bool RcuQuiescent(RcuDomain* domain, uint64_t epoch) {
+    for (auto r : domain->readers) {
+        if (r == t_rcu_reader) {
+            continue;
+        }
+        uint64_t v = r->epoch.load();
+        if (v != 0 && v < epoch) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void RcuCollect(RcuDomain* domain, std::vector<std::function<void()> >& cbs) {
+    uint64_t min = s_rcu_epoch.load();
+    for (auto r : domain->readers) {
+        uint64_t v = r->epoch.load();
+        if (v != 0 && v < min) {
+            min = v;
+        }
+    }
+    for (auto it = domain->retired.begin(); it != domain->retired.end();) {
+        if (it->epoch <= min) {
+            cbs.push_back(it->cb);
+            it = domain->retired.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+}
+
+Rcu::ReadGuard::ReadGuard() {
+    RcuReader* r = GetRcuReader();
+    if (r->depth++ == 0) {
+        //seq_cst保证写者扫描时要么看到这个代数，要么我们读到的是新指针
+        r->epoch.store(s_rcu_epoch.load(std::memory_order_acquire));
+    }
+}
+
+Rcu::ReadGuard::~ReadGuard() {
+    RcuReader* r = t_rcu_reader;
+    if (r && --r->depth == 0) {
+        r->epoch.store(0, std::memory_order_release);
+    }
+}
+
+void Rcu::Synchronize() {
+    uint64_t epoch = ++s_rcu_epoch;
+    RcuDomain* domain = GetRcuDomain();
+    std::vector<std::function<void()> > cbs;
+    {
+        Mutex::Lock lock(domain->mutex);
+        while (!RcuQuiescent(domain, epoch)) {
+            lock.unlock();
+            sched_yield();
+            lock.lock();
+        }
+        RcuCollect(domain, cbs);
+    }
+    for (auto& cb : cbs) {
+        cb();
+    }
+}
+
+void Rcu::Retire(std::function<void()> cb) {
+    RcuDomain* domain = GetRcuDomain();
+    std::vector<std::function<void()> > cbs;
+    {
+        Mutex::Lock lock(domain->mutex);
+        RcuRetired r;
+        r.epoch = ++s_rcu_epoch;
+        r.cb = cb;
+        domain->retired.push_back(r);
+        RcuCollect(domain, cbs);
+    }
+    for (auto& i : cbs) {
+        i();
+    }
+}
+
+}
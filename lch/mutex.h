@@ -0,0 +1,204 @@
+#ifndef __LCH_MUTEX_H__
+#define __LCH_MUTEX_H__
+
+#include <semaphore.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <functional>
+
+namespace lch {
+
+//信号量
+class Semaphore {
+public:
+    Semaphore(uint32_t count = 0);
+    ~Semaphore();
+
+    void wait();
+    //最多等待timeout_ms毫秒，超时返回false
+    bool wait(uint32_t timeout_ms);
+    void notify();
+private:
+    Semaphore(const Semaphore&) = delete;
+    Semaphore(const Semaphore&&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+private:
+    sem_t m_semaphore;
+};
+
+//局部锁，构造时加锁，析构时解锁
+template<class T>
+struct ScopedLockImpl {
+public:
+    ScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.lock();
+        m_locked = true;
+    }
+
+    ~ScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.lock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+template<class T>
+struct ReadScopedLockImpl {
+public:
+    ReadScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.rdlock();
+        m_locked = true;
+    }
+
+    ~ReadScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.rdlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+template<class T>
+struct WriteScopedLockImpl {
+public:
+    WriteScopedLockImpl(T& mutex)
+        :m_mutex(mutex) {
+        m_mutex.wrlock();
+        m_locked = true;
+    }
+
+    ~WriteScopedLockImpl() {
+        unlock();
+    }
+
+    void lock() {
+        if (!m_locked) {
+            m_mutex.wrlock();
+            m_locked = true;
+        }
+    }
+
+    void unlock() {
+        if (m_locked) {
+            m_mutex.unlock();
+            m_locked = false;
+        }
+    }
+private:
+    T& m_mutex;
+    bool m_locked;
+};
+
+//互斥量
+class Mutex {
+public:
+    typedef ScopedLockImpl<Mutex> Lock;
+    Mutex() {
+        pthread_mutex_init(&m_mutex, nullptr);
+    }
+
+    ~Mutex() {
+        pthread_mutex_destroy(&m_mutex);
+    }
+
+    void lock() {
+        pthread_mutex_lock(&m_mutex);
+    }
+
+    void unlock() {
+        pthread_mutex_unlock(&m_mutex);
+    }
+private:
+    Mutex(const Mutex&) = delete;
+    Mutex& operator=(const Mutex&) = delete;
+private:
+    pthread_mutex_t m_mutex;
+};
+
+//读写锁
+class RWMutex {
+public:
+    typedef ReadScopedLockImpl<RWMutex> ReadLock;
+    typedef WriteScopedLockImpl<RWMutex> WriteLock;
+
+    RWMutex() {
+        pthread_rwlock_init(&m_lock, nullptr);
+    }
+
+    ~RWMutex() {
+        pthread_rwlock_destroy(&m_lock);
+    }
+
+    void rdlock() {
+        pthread_rwlock_rdlock(&m_lock);
+    }
+
+    void wrlock() {
+        pthread_rwlock_wrlock(&m_lock);
+    }
+
+    void unlock() {
+        pthread_rwlock_unlock(&m_lock);
+    }
+private:
+    RWMutex(const RWMutex&) = delete;
+    RWMutex& operator=(const RWMutex&) = delete;
+private:
+    pthread_rwlock_t m_lock;
+};
+
+//简化的RCU(基于代数的延迟回收)
+//读者进入临界区时在线程本地的槽位上记下当前代数，不加锁
+//写者替换原子指针后调用Retire，旧数据等所有更早进入的读者离开后才释放
+class Rcu {
+public:
+    //读临界区，可以嵌套
+    class ReadGuard {
+    public:
+        ReadGuard();
+        ~ReadGuard();
+    private:
+        ReadGuard(const ReadGuard&) = delete;
+        ReadGuard& operator=(const ReadGuard&) = delete;
+    };
+
+    //等待调用之前进入临界区的读者全部离开，不能在读临界区内调用
+    static void Synchronize();
+    //延迟执行cb(一般是delete旧数据)，在之后某次Retire/Synchronize时执行
+    static void Retire(std::function<void()> cb);
+};
+
+}
+
+#endif // !__LCH_MUTEX_H__
@@ -0,0 +1,97 @@
+#ifndef __LCH_RING_QUEUE_H__
+#define __LCH_RING_QUEUE_H__
+
+#include <atomic>
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+namespace lch {
+
+//有界无锁环形队列，多生产者单消费者
+//每个槽位带序号(Vyukov算法)，生产者只在写指针上做一次CAS，消费者不需要原子RMW操作
+template<class T>
+class MPSCRingQueue {
+public:
+    //capacity会向上取整为2的幂
+    MPSCRingQueue(size_t capacity) {
+        size_t cap = 2;
+        while (cap < capacity) {
+            cap <<= 1;
+        }
+        m_mask = cap - 1;
+        m_cells = std::vector<Cell>(cap);
+        for (size_t i = 0; i < cap; ++i) {
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        m_enqueuePos.store(0, std::memory_order_relaxed);
+        m_dequeuePos.store(0, std::memory_order_relaxed);
+    }
+
+    //队列满时返回false，v不会被移走
+    bool push(T& v) {
+        Cell* cell;
+        size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = m_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = std::move(v);
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    //只能由唯一的消费者线程调用，队列空时返回false
+    bool pop(T& v) {
+        size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+        Cell* cell = &m_cells[pos & m_mask];
+        size_t seq = cell->seq.load(std::memory_order_acquire);
+        if ((intptr_t)seq - (intptr_t)(pos + 1) < 0) {
+            return false;
+        }
+        v = std::move(cell->data);
+        cell->data = T();
+        m_dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        cell->seq.store(pos + m_mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const {
+        const Cell& cell = m_cells[m_dequeuePos.load(std::memory_order_relaxed) & m_mask];
+        return cell.seq.load(std::memory_order_acquire) != m_dequeuePos.load(std::memory_order_relaxed) + 1;
+    }
+
+    size_t capacity() const { return m_mask + 1; }
+private:
+    struct Cell {
+        Cell() {}
+        Cell(const Cell&) : seq(0) {}
+        std::atomic<size_t> seq;
+        T data;
+    };
+    MPSCRingQueue(const MPSCRingQueue&) = delete;
+    MPSCRingQueue& operator=(const MPSCRingQueue&) = delete;
+private:
+    std::vector<Cell> m_cells;
+    size_t m_mask = 0;
+    //读写指针分开在不同的cache line上，避免生产者和消费者互相干扰
+    char m_pad0[64];
+    std::atomic<size_t> m_enqueuePos;
+    char m_pad1[64];
+    std::atomic<size_t> m_dequeuePos;
+    char m_pad2[64];
+};
+
+}
+
+#endif // !__LCH_RING_QUEUE_H__
@@ -0,0 +1,485 @@
+#include "shm_log.h"
+#include "config.h"
+#include "thread.h"
+#include "util.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+namespace lch {
+
+//原子变量放在共享内存里给多个进程用，必须是无锁的
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "shm log needs lock-free atomics");
+
+//"LCHSMLOG"，初始化完成后最后写入
+static const uint64_t s_shm_magic = 0x474f4c4d5348434cULL;
+//槽位最小的字节数
+static const uint32_t s_min_slot_size = 256;
+//文件名、Logger名、线程名在槽位中保留的长度
+static const size_t s_max_name = 255;
+//收集者没有可取的日志时最多睡这么久，用来检查卡住的槽位
+static const uint32_t s_idle_wait_ms = 100;
+
+/*******************************ShmLogChannel*********************************/
+//共享内存布局: ShmLogHeader + capacity个槽位，槽位按Vyukov算法用seq标记状态
+//  seq == pos             空闲，等待第pos条(写入者占到之后、写完之前也是这个值)
+//  seq == pos + 1         第pos条已写完，等待收集者取走
+//  seq == pos + capacity  收集者取走或跳过，等待第pos + capacity条
+//  seq == pos + capacity - 1  写入者卡住，收集者已经跳过，写入者可能还在拷贝；
+//                             下一圈的写入者把它当作队列满，等卡住的写入者结束时改成pos + capacity，
+//                             或者收集者确认写入进程已经不存在、或者这一圈再等一个停顿时间后收回
+struct ShmLogHeader {
+    std::atomic<uint64_t> magic;
+    uint32_t slotSize;
+    uint32_t capacity;
+    char pad0[48];
+    std::atomic<uint64_t> enqueuePos;
+    char pad1[56];
+    std::atomic<uint64_t> dequeuePos;
+    std::atomic<int32_t> sleeping;      //收集者等待时为1，也是futex的地址
+    char pad2[52];
+    std::atomic<uint64_t> dropped;
+    std::atomic<uint64_t> abandoned;
+    //收集者已经输出过的丢弃条数，收集者重启后接着报告
+    uint64_t reportedDropped;
+    uint64_t reportedAbandoned;
+    char pad3[32];
+};
+static_assert(sizeof(ShmLogHeader) == 256, "shm log header layout changed");
+
+struct ShmLogSlot {
+    std::atomic<uint64_t> seq;
+    std::atomic<int32_t> owner;     //写入者的进程号，收集者取走后清0
+    uint8_t level;
+    uint8_t pad[3];
+    uint64_t sec;
+    uint32_t nsec;
+    uint32_t elapse;
+    uint32_t threadId;
+    uint32_t fiberId;
+    int32_t line;
+    uint16_t fileLen;
+    uint16_t loggerLen;
+    uint16_t threadLen;
+    uint16_t pad2;
+    uint32_t msgLen;
+
+    //后面依次是文件名、Logger名、线程名、内容
+    char* data() { return (char*)(this + 1); }
+};
+
+static std::string ShmPath(const std::string& name) {
+    return !name.empty() && name[0] == '/' ? name : "/" + name;
+}
+
+class ShmLogChannel {
+public:
+    typedef std::shared_ptr<ShmLogChannel> ptr;
+
+    //打开或创建通道，失败返回nullptr
+    static ptr Open(const std::string& name, uint32_t capacity, uint32_t slot_size);
+
+    ShmLogChannel(int fd, void* data, size_t size)
+        :m_fd(fd)
+        ,m_data(data)
+        ,m_size(size) {
+        m_header = (ShmLogHeader*)data;
+        m_slots = (char*)data + sizeof(ShmLogHeader);
+        m_mask = m_header->capacity - 1;
+        m_slotSize = m_header->slotSize;
+    }
+
+    ~ShmLogChannel() {
+        munmap(m_data, m_size);
+        close(m_fd);
+    }
+
+    ShmLogHeader* header() const { return m_header; }
+    ShmLogSlot* slot(uint64_t pos) const { return (ShmLogSlot*)(m_slots + (pos & m_mask) * m_slotSize); }
+    uint32_t getCapacity() const { return m_mask + 1; }
+    uint32_t getSlotSize() const { return m_slotSize; }
+    //槽位中除去固定字段后能放的字节数
+    size_t getDataSize() const { return m_slotSize - sizeof(ShmLogSlot); }
+    int getFd() const { return m_fd; }
+
+    //写入者写完一条后调用，收集者在等待时唤醒它
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_header->sleeping.load(std::memory_order_relaxed) && m_header->sleeping.exchange(0)) {
+            syscall(SYS_futex, (int*)&m_header->sleeping, FUTEX_WAKE, 1, nullptr, nullptr, 0);
+        }
+    }
+
+    //收集者等待新日志，最多ms毫秒
+    void wait(uint32_t ms) {
+        m_header->sleeping.store(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        uint64_t pos = m_header->dequeuePos.load(std::memory_order_relaxed);
+        if (slot(pos)->seq.load(std::memory_order_acquire) != pos + 1) {
+            struct timespec ts = {ms / 1000, (long)(ms % 1000) * 1000000};
+            syscall(SYS_futex, (int*)&m_header->sleeping, FUTEX_WAIT, 1, &ts, nullptr, 0);
+        }
+        m_header->sleeping.store(0);
+    }
+private:
+    int m_fd;
+    void* m_data;
+    size_t m_size;
+    ShmLogHeader* m_header;
+    char* m_slots;
+    uint64_t m_mask;
+    uint32_t m_slotSize;
+};
+
+ShmLogChannel::ptr ShmLogChannel::Open(const std::string& name, uint32_t capacity, uint32_t slot_size) {
+    std::string path = ShmPath(name);
+    uint32_t cap = 2;
+    while (cap < capacity) {
+        cap <<= 1;
+    }
+    slot_size = (std::max(slot_size, s_min_slot_size) + 63) & ~63u;
+
+    //另一个进程正在初始化时等它完成，最多等100ms
+    for (int i = 0; i < 100; ++i) {
+        int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+        if (fd >= 0) {
+            size_t size = sizeof(ShmLogHeader) + (size_t)cap * slot_size;
+            void* data = MAP_FAILED;
+            if (ftruncate(fd, size) == 0) {
+                data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            }
+            if (data == MAP_FAILED) {
+                std::cout << "ShmLogChannel create " << path << " failed: " << strerror(errno) << std::endl;
+                close(fd);
+                shm_unlink(path.c_str());
+                return nullptr;
+            }
+            //ftruncate出来的内存都是0，只需要设置非0的字段
+            ShmLogHeader* header = (ShmLogHeader*)data;
+            header->slotSize = slot_size;
+            header->capacity = cap;
+            for (uint32_t j = 0; j < cap; ++j) {
+                ShmLogSlot* slot = (ShmLogSlot*)((char*)data + sizeof(ShmLogHeader) + (size_t)j * slot_size);
+                slot->seq.store(j, std::memory_order_relaxed);
+            }
+            header->magic.store(s_shm_magic, std::memory_order_release);
+            return ptr(new ShmLogChannel(fd, data, size));
+        }
+        if (errno != EEXIST) {
+            std::cout << "ShmLogChannel open " << path << " failed: " << strerror(errno) << std::endl;
+            return nullptr;
+        }
+        fd = shm_open(path.c_str(), O_RDWR | O_CLOEXEC, 0);
+        if (fd < 0) {
+            //刚好被删除了，重新创建
+            continue;
+        }
+        struct stat st;
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(ShmLogHeader)) {
+            void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            if (data != MAP_FAILED) {
+                ShmLogHeader* header = (ShmLogHeader*)data;
+                if (header->magic.load(std::memory_order_acquire) == s_shm_magic) {
+                    uint32_t c = header->capacity;
+                    if (c >= 2 && (c & (c - 1)) == 0 && header->slotSize >= s_min_slot_size
+                            && sizeof(ShmLogHeader) + (size_t)c * header->slotSize == (size_t)st.st_size) {
+                        return ptr(new ShmLogChannel(fd, data, st.st_size));
+                    }
+                    std::cout << "ShmLogChannel " << path << " is corrupted" << std::endl;
+                    munmap(data, st.st_size);
+                    close(fd);
+                    return nullptr;
+                }
+                munmap(data, st.st_size);
+            }
+        }
+        close(fd);
+        usleep(1000);
+    }
+    std::cout << "ShmLogChannel " << path << " is not initialized" << std::endl;
+    return nullptr;
+}
+
+/*******************************ShmLogAppender*********************************/
+//拷贝到槽位中，超长的部分截断，tail为true时保留末尾
+static uint16_t PutString(char*& p, size_t& left, const char* str, size_t len, size_t max, bool tail = false) {
+    size_t n = std::min(std::min(len, max), left);
+    memcpy(p, tail ? str + len - n : str, n);
+    p += n;
+    left -= n;
+    return n;
+}
+
+ShmLogAppender::ShmLogAppender(const std::string& name, uint32_t capacity, uint32_t slot_size)
+    :m_name(name)
+    ,m_capacity(capacity)
+    ,m_slotSize(slot_size)
+    ,m_channel(ShmLogChannel::Open(name, capacity, slot_size))
+    ,m_dropped(0) {
+}
+
+void ShmLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level < m_level) {
+        return;
+    }
+    if (!m_channel) {
+        ++m_dropped;
+        return;
+    }
+    ShmLogHeader* header = m_channel->header();
+    uint64_t pos = header->enqueuePos.load(std::memory_order_relaxed);
+    ShmLogSlot* slot;
+    while (true) {
+        slot = m_channel->slot(pos);
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t dif = (int64_t)(seq - pos);
+        if (dif == 0) {
+            if (header->enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (dif < 0) {
+            ++m_dropped;
+            header->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = header->enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    slot->owner.store(getpid(), std::memory_order_relaxed);
+    slot->level = level;
+    slot->sec = event->getTime();
+    slot->nsec = event->getNanosecond();
+    slot->elapse = event->getElapse();
+    slot->threadId = event->getThreadId();
+    slot->fiberId = event->getFiberId();
+    slot->line = event->getLine();
+    char* p = slot->data();
+    size_t left = m_channel->getDataSize();
+    const char* file = event->getFile() ? event->getFile() : "";
+    const std::string& name = event->getLogger()->getName();
+    const std::string& thread = event->getThreadName();
+    slot->fileLen = PutString(p, left, file, strlen(file), s_max_name, true);
+    slot->loggerLen = PutString(p, left, name.c_str(), name.size(), s_max_name);
+    slot->threadLen = PutString(p, left, thread.c_str(), thread.size(), s_max_name);
+    slot->msgLen = std::min(event->getContentSize(), left);
+    memcpy(p, event->getContentData(), slot->msgLen);
+
+    uint64_t expect = pos;
+    if (!slot->seq.compare_exchange_strong(expect, pos + 1, std::memory_order_release
+                , std::memory_order_relaxed)) {
+        //写得太慢，收集者已经跳过了这个槽位，拷贝完了才能交给下一圈的写入者
+        uint64_t cap = m_channel->getCapacity();
+        expect = pos + cap - 1;
+        slot->seq.compare_exchange_strong(expect, pos + cap, std::memory_order_release
+                , std::memory_order_relaxed);
+        ++m_dropped;
+        return;
+    }
+    m_channel->wake();
+}
+
+std::string ShmLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "ShmLogAppender";
+    node["channel"] = m_name;
+    node["capacity"] = m_capacity;
+    node["slot_size"] = m_slotSize;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+/*******************************ShmLogCollector*********************************/
+ShmLogCollector::ShmLogCollector(const std::string& name, Logger::ptr logger
+        , uint32_t capacity, uint32_t slot_size)
+    :m_name(name)
+    ,m_logger(logger)
+    ,m_channel(ShmLogChannel::Open(name, capacity, slot_size))
+    ,m_received(0)
+    ,m_stopping(false) {
+    if (!m_channel) {
+        return;
+    }
+    //收集者进程退出后锁自动释放，新的收集者从上次的位置接着取
+    if (flock(m_channel->getFd(), LOCK_EX | LOCK_NB)) {
+        std::cout << "ShmLogCollector " << name << " already has a collector" << std::endl;
+        m_channel.reset();
+        return;
+    }
+}
+
+ShmLogCollector::~ShmLogCollector() {
+    stop();
+}
+
+void ShmLogCollector::start() {
+    if (m_thread || !m_channel) {
+        return;
+    }
+    m_thread.reset(new Thread([this](){ run(); }, "log_shm"));
+}
+
+void ShmLogCollector::stop() {
+    if (!m_thread || m_stopping.exchange(true)) {
+        return;
+    }
+    m_channel->wake();
+    m_thread->join();
+}
+
+uint64_t ShmLogCollector::getDropped() const {
+    return m_channel ? m_channel->header()->dropped.load() : 0;
+}
+
+uint64_t ShmLogCollector::getAbandoned() const {
+    return m_channel ? m_channel->header()->abandoned.load() : 0;
+}
+
+bool ShmLogCollector::Unlink(const std::string& name) {
+    return shm_unlink(ShmPath(name).c_str()) == 0;
+}
+
+const Logger::ptr& ShmLogCollector::getLogger(const char* name, size_t len) {
+    Logger::ptr& logger = m_loggers[std::string(name, len)];
+    if (!logger) {
+        //只用来提供%c的名字，不会输出
+        logger.reset(new Logger(std::string(name, len)));
+    }
+    return logger;
+}
+
+bool ShmLogCollector::next() {
+    ShmLogHeader* header = m_channel->header();
+    uint64_t pos = header->dequeuePos.load(std::memory_order_relaxed);
+    ShmLogSlot* slot = m_channel->slot(pos);
+    uint64_t seq = slot->seq.load(std::memory_order_acquire);
+    if (seq == pos + 1) {
+        //长度来自其他进程，按槽位大小截断，防止越界
+        size_t left = m_channel->getDataSize();
+        size_t file_len = std::min<size_t>(slot->fileLen, left);
+        size_t logger_len = std::min<size_t>(slot->loggerLen, left - file_len);
+        size_t thread_len = std::min<size_t>(slot->threadLen, left - file_len - logger_len);
+        size_t msg_len = std::min<size_t>(slot->msgLen, left - file_len - logger_len - thread_len);
+        const char* p = slot->data();
+        LogLevel::Level level = (LogLevel::Level)std::min<int>(slot->level, LogLevel::FATAL);
+        const char* file = m_files.insert(std::string(p, file_len)).first->c_str();
+        LogEvent::ptr event(new LogEvent(getLogger(p + file_len, logger_len), level, file, slot->line
+                    , slot->elapse, slot->threadId, slot->fiberId, slot->sec, slot->nsec));
+        p += file_len + logger_len;
+        event->setThreadName(std::string(p, thread_len));
+        event->getSS().append(p + thread_len, msg_len);
+        event->addField("pid", slot->owner.load(std::memory_order_relaxed));
+
+        slot->owner.store(0, std::memory_order_relaxed);
+        slot->seq.store(pos + m_channel->getCapacity(), std::memory_order_release);
+        header->dequeuePos.store(pos + 1, std::memory_order_relaxed);
+        m_stallSince = 0;
+        ++m_received;
+        if (m_logger) {
+            m_logger->log(level, event);
+        }
+        return true;
+    }
+    uint64_t cap = m_channel->getCapacity();
+    if (seq == pos - 1) {
+        //上一圈跳过的槽位，写入者还没结束；写入进程已经不存在时收回给这一圈使用
+        //写入者可能在记下owner之前就崩溃了，pid也可能已经被复用，
+        //所以超过停顿时间后不管owner都收回，否则这一圈的写入者会一直当作队列满
+        uint64_t now = GetMonotonicNS();
+        if (m_stallPos != pos || !m_stallSince) {
+            m_stallPos = pos;
+            m_stallSince = now;
+        }
+        int32_t owner = slot->owner.load(std::memory_order_relaxed);
+        bool dead = owner > 0 && kill(owner, 0) && errno == ESRCH;
+        if (!dead && now - m_stallSince < (uint64_t)m_stallMS * 1000000) {
+            return false;
+        }
+        if (slot->seq.compare_exchange_strong(seq, pos)) {
+            slot->owner.store(0, std::memory_order_relaxed);
+        }
+        m_stallSince = 0;
+        return true;
+    }
+    if (seq != pos || header->enqueuePos.load(std::memory_order_relaxed) <= pos) {
+        return false;
+    }
+
+    //已经被写入者占用但还没写完
+    uint64_t now = GetMonotonicNS();
+    if (m_stallPos != pos || !m_stallSince) {
+        m_stallPos = pos;
+        m_stallSince = now;
+    }
+    int32_t owner = slot->owner.load(std::memory_order_relaxed);
+    bool dead = owner > 0 && kill(owner, 0) && errno == ESRCH;
+    if (!dead && now - m_stallSince < (uint64_t)m_stallMS * 1000000) {
+        return false;
+    }
+    //写入进程还活着时它可能还在往槽位里拷贝，不能直接交给下一圈的写入者
+    if (!slot->seq.compare_exchange_strong(seq, dead ? pos + cap : pos + cap - 1)) {
+        //刚好写完了，下次取
+        return true;
+    }
+    if (dead) {
+        slot->owner.store(0, std::memory_order_relaxed);
+    }
+    header->abandoned.fetch_add(1, std::memory_order_relaxed);
+    header->dequeuePos.store(pos + 1, std::memory_order_relaxed);
+    m_stallSince = 0;
+    return true;
+}
+
+void ShmLogCollector::reportDropped() {
+    ShmLogHeader* header = m_channel->header();
+    uint64_t dropped = header->dropped;
+    uint64_t abandoned = header->abandoned;
+    if (!m_logger || (dropped == header->reportedDropped && abandoned == header->reportedAbandoned)) {
+        return;
+    }
+    LogEvent::ptr event = LogEvent::Create(m_logger, LogLevel::WARN, __FILE__, __LINE__, GetElapsedMS(),
+                GetThreadId(), GetFiberId());
+    event->getSS() << "shm log channel " << m_name << " dropped " << (dropped - header->reportedDropped)
+                   << " records, abandoned " << (abandoned - header->reportedAbandoned) << " records";
+    header->reportedDropped = dropped;
+    header->reportedAbandoned = abandoned;
+    m_logger->log(LogLevel::WARN, event);
+}
+
+size_t ShmLogCollector::drain() {
+    if (!m_channel) {
+        return 0;
+    }
+    size_t count = 0;
+    while (next()) {
+        ++count;
+    }
+    reportDropped();
+    return count;
+}
+
+void ShmLogCollector::run() {
+    while (true) {
+        if (drain()) {
+            continue;
+        }
+        if (m_stopping) {
+            break;
+        }
+        //有卡住的槽位时频繁检查，尽快跳过
+        m_channel->wait(m_stallSince ? 10 : s_idle_wait_ms);
+    }
+}
+
+}
@@ -0,0 +1,100 @@
+#ifndef __LCH_SHM_LOG_H__
+#define __LCH_SHM_LOG_H__
+
+#include <string>
+#include <memory>
+#include <map>
+#include <set>
+#include "log.h"
+#include "mutex.h"
+
+namespace lch {
+
+class ShmLogChannel;
+
+//多进程共享的日志通道 shm_open("/name")得到的共享内存里是一个定长槽位的无锁环形队列
+//各进程的ShmLogAppender把日志事件(不格式化)拷贝进槽位，唯一的ShmLogCollector
+//取出后还原成LogEvent交给自己的Logger，由它的appender统一输出，多个进程不再各自打开同一个文件
+//第一个打开通道的一方负责创建，之后打开时以已有的容量和槽位大小为准
+//进程退出后共享内存依然存在，不再使用时调用ShmLogCollector::Unlink删除
+
+//写入共享内存通道的Appender 队列满时丢弃并计数，不会阻塞调用者
+//超过槽位大小的日志内容会被截断，结构化字段只保留进程号pid
+class ShmLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<ShmLogAppender> ptr;
+    //capacity为槽位数(向上取整为2的幂)，slot_size为每个槽位的字节数
+    ShmLogAppender(const std::string& name, uint32_t capacity = 4096, uint32_t slot_size = 1024);
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    std::string toYamlString() override;
+
+    //通道打开失败时为false，此时日志全部丢弃
+    bool isValid() const { return !!m_channel; }
+    //本进程因队列满或者被判定为崩溃而丢弃的条数
+    uint64_t getDropped() const { return m_dropped; }
+    const std::string& getName() const { return m_name; }
+private:
+    std::string m_name;
+    uint32_t m_capacity;
+    uint32_t m_slotSize;
+    std::shared_ptr<ShmLogChannel> m_channel;
+    std::atomic<uint64_t> m_dropped;
+};
+
+//共享内存通道的收集者 同一个通道同时只能有一个(用flock保证)
+//可以在主进程里start()开后台线程，也可以在单独的进程里循环调用drain()
+//写入者在占到槽位之后、写完之前崩溃时，该槽位会挡住后面的日志，
+//收集者发现写入进程已经不存在，或者等待超过stall_ms后跳过这个槽位并计入abandoned；
+//跳过时写入进程还活着的，槽位要等它写完(丢弃这一条)、确认它已经退出，或者下一圈再等stall_ms后才会被重新使用
+class ShmLogCollector {
+public:
+    typedef std::shared_ptr<ShmLogCollector> ptr;
+    //logger为输出目标，通道不存在时按capacity和slot_size创建
+    ShmLogCollector(const std::string& name, Logger::ptr logger
+                    , uint32_t capacity = 4096, uint32_t slot_size = 1024);
+    ~ShmLogCollector();
+
+    void start();
+    //停止后台线程，停止前会把通道中剩余的日志全部输出
+    void stop();
+    //取出当前所有的日志交给logger，返回条数，不能和start同时使用
+    size_t drain();
+
+    //打开通道失败或者已经有别的收集者时为false
+    bool isValid() const { return !!m_channel; }
+    uint64_t getReceived() const { return m_received; }
+    //各进程因队列满丢弃的总条数
+    uint64_t getDropped() const;
+    //因写入者崩溃或卡住而跳过的条数
+    uint64_t getAbandoned() const;
+
+    void setStallTimeout(uint32_t ms) { m_stallMS = ms; }
+    uint32_t getStallTimeout() const { return m_stallMS; }
+
+    //删除共享内存，已经打开的进程不受影响
+    static bool Unlink(const std::string& name);
+private:
+    void run();
+    //取出一条，没有可取的返回false
+    bool next();
+    const Logger::ptr& getLogger(const char* name, size_t len);
+    void reportDropped();
+private:
+    std::string m_name;
+    Logger::ptr m_logger;
+    std::shared_ptr<ShmLogChannel> m_channel;
+    uint32_t m_stallMS = 1000;
+    //第一次发现m_stallPos处的槽位被占用但没写完的时间
+    uint64_t m_stallPos = 0;
+    uint64_t m_stallSince = 0;
+    std::atomic<uint64_t> m_received;
+    //还原LogEvent用到的Logger和文件名
+    std::map<std::string, Logger::ptr> m_loggers;
+    std::set<std::string> m_files;
+    std::shared_ptr<Thread> m_thread;
+    std::atomic<bool> m_stopping;
+};
+
+}
+
+#endif // !__LCH_SHM_LOG_H__
@@ -0,0 +1,542 @@
+#include "socket_appender.h"
+#include "config.h"
+#include "thread.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sched.h>
+#include <algorithm>
+
+namespace lch {
+
+//一次sendmmsg最多发送的条数
+static const int s_batch_msgs = 64;
+//单条数据报的内容上限，超出截断，UDP最大负载为65507
+static const size_t s_max_datagram = 60 * 1024;
+//重连退避，毫秒
+static const uint32_t s_min_backoff_ms = 50;
+static const uint32_t s_max_backoff_ms = 2000;
+
+/*******************************Framing*********************************/
+//RFC5424的severity
+static int SyslogSeverity(LogLevel::Level level) {
+    switch (level) {
+        case LogLevel::DEBUG: return 7;
+        case LogLevel::INFO: return 6;
+        case LogLevel::WARN: return 4;
+        case LogLevel::ERROR: return 3;
+        case LogLevel::FATAL: return 2;
+        default: return 5;
+    }
+}
+
+//HOSTNAME APP-NAME MSGID只能是可见的ASCII字符，不能为空
+static std::string SyslogName(const std::string& str, size_t max) {
+    std::string out;
+    for (size_t i = 0; i < str.size() && out.size() < max; ++i) {
+        char c = str[i];
+        out.push_back(c > 32 && c < 127 ? c : '_');
+    }
+    return out.empty() ? "-" : out;
+}
+
+static const std::string& SyslogHeader() {
+    //HOSTNAME APP-NAME PROCID，进程内不变
+    static std::string s_header = []() {
+        char host[256] = {0};
+        gethostname(host, sizeof(host) - 1);
+        return " " + SyslogName(host, 255) + " " + SyslogName(program_invocation_short_name, 48)
+            + " " + std::to_string(getpid()) + " ";
+    }();
+    return s_header;
+}
+
+static void AppendSyslogTime(std::string& out, uint64_t sec, uint32_t nsec) {
+    static thread_local time_t s_sec = -1;
+    static thread_local char s_text[32];
+    if ((time_t)sec != s_sec) {
+        struct tm tm;
+        time_t t = sec;
+        gmtime_r(&t, &tm);
+        strftime(s_text, sizeof(s_text), "%Y-%m-%dT%H:%M:%S", &tm);
+        s_sec = sec;
+    }
+    char frac[16];
+    snprintf(frac, sizeof(frac), ".%06uZ", nsec / 1000);
+    out.append(s_text);
+    out.append(frac);
+}
+
+//按framing把一条日志编码后追加到out，stream为流式连接
+static void Frame(std::string& out, SocketLogAppender::Framing framing, bool stream, LogLevel::Level level
+        , uint64_t sec, uint32_t nsec, const std::string& logger, const char* text, size_t len) {
+    if (!stream && len > s_max_datagram) {
+        len = s_max_datagram;
+    }
+    if (framing == SocketLogAppender::LENGTH) {
+        uint32_t n = len;
+        char prefix[4] = {(char)(n >> 24), (char)(n >> 16), (char)(n >> 8), (char)n};
+        out.append(prefix, sizeof(prefix));
+        out.append(text, len);
+        return;
+    }
+    //<PRI>VERSION TIMESTAMP HOSTNAME APP-NAME PROCID MSGID STRUCTURED-DATA MSG，facility为user(1)
+    static thread_local std::string s_msg;
+    std::string& msg = stream ? s_msg : out;
+    if (stream) {
+        msg.clear();
+    }
+    msg.push_back('<');
+    msg.append(std::to_string(8 + SyslogSeverity(level)));
+    msg.append(">1 ");
+    AppendSyslogTime(msg, sec, nsec);
+    msg.append(SyslogHeader());
+    msg.append(SyslogName(logger, 32));
+    msg.append(" - ");
+    msg.append(text, len);
+    if (stream) {
+        //RFC6587 octet counting
+        out.append(std::to_string(msg.size()));
+        out.push_back(' ');
+        out.append(msg);
+    }
+}
+
+/*******************************Sender*********************************/
+struct SocketLogAppender::Sender {
+    //待发送的一批日志，ends[i]为第i条的结束偏移
+    struct Batch {
+        std::string data;
+        std::vector<uint32_t> ends;
+        size_t next = 0;        //下一条要发送的日志
+
+        bool empty() const { return next >= ends.size(); }
+        size_t begin(size_t i) const { return i ? ends[i - 1] : 0; }
+        void clear() {
+            data.clear();
+            ends.clear();
+            next = 0;
+        }
+    };
+
+    Sender(const std::string& address, Framing f, size_t max_pending
+            , AsyncLogDispatcher::OverflowPolicy policy)
+        :framing(f)
+        ,maxPending(max_pending)
+        ,overflow(policy)
+        ,sleeping(false)
+        ,stopping(false)
+        ,connected(false)
+        ,unsent(0)
+        ,sent(0)
+        ,dropped(0) {
+        memset(&addr, 0, sizeof(addr));
+        valid = parse(address);
+        if (!valid) {
+            std::cout << "SocketLogAppender invalid address: " << address << std::endl;
+        }
+    }
+
+    ~Sender() {
+        closeSocket();
+    }
+
+    bool parse(const std::string& address) {
+        std::string path;
+        if (address.compare(0, 7, "unix://") == 0) {
+            type = SOCK_DGRAM;
+            path = address.substr(7);
+        } else if (address.compare(0, 14, "unix-stream://") == 0) {
+            type = SOCK_STREAM;
+            path = address.substr(14);
+        } else if (address.compare(0, 6, "udp://") == 0) {
+            std::string hostport = address.substr(6);
+            size_t pos = hostport.rfind(':');
+            if (pos == std::string::npos) {
+                return false;
+            }
+            std::string host = hostport.substr(0, pos);
+            std::string port = hostport.substr(pos + 1);
+            if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+                host = host.substr(1, host.size() - 2);
+            }
+            struct addrinfo hints;
+            memset(&hints, 0, sizeof(hints));
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_DGRAM;
+            struct addrinfo* res = nullptr;
+            if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) || !res) {
+                return false;
+            }
+            memcpy(&addr, res->ai_addr, res->ai_addrlen);
+            addrLen = res->ai_addrlen;
+            family = res->ai_family;
+            type = SOCK_DGRAM;
+            freeaddrinfo(res);
+            return true;
+        } else {
+            return false;
+        }
+        struct sockaddr_un* un = (struct sockaddr_un*)&addr;
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size());
+        addrLen = offsetof(struct sockaddr_un, sun_path) + path.size() + 1;
+        family = AF_UNIX;
+        return true;
+    }
+
+    bool isStream() const { return type == SOCK_STREAM; }
+
+    void start(std::shared_ptr<Sender> self) {
+        thread.reset(new Thread([self]() { self->run(); }, "log_socket"));
+    }
+
+    void stop() {
+        stopping = true;
+        notify();
+        if (thread) {
+            thread->join();
+            thread.reset();
+        }
+    }
+
+    //返回false表示日志被丢弃
+    bool push(const std::string& frame) {
+        int spins = 0;
+        while (true) {
+            {
+                Mutex::Lock lock(mutex);
+                //缓冲区为空时总能放下一条，避免单条超过上限的日志永远发不出去
+                if (pending.data.empty() || pending.data.size() + frame.size() <= maxPending) {
+                    pending.data.append(frame);
+                    pending.ends.push_back(pending.data.size());
+                    //和追加一起计数，发送线程取走并减去之前一定已经加上
+                    ++unsent;
+                    break;
+                }
+            }
+            if (overflow != AsyncLogDispatcher::BLOCK || stopping) {
+                ++dropped;
+                return false;
+            }
+            notify();
+            if (++spins < 64) {
+                sched_yield();
+            } else {
+                usleep(100);
+            }
+        }
+        notify();
+        return true;
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+            sem.notify();
+        }
+    }
+
+    bool hasPending() {
+        Mutex::Lock lock(mutex);
+        return !pending.ends.empty();
+    }
+
+    void take() {
+        batch.clear();
+        Mutex::Lock lock(mutex);
+        std::swap(batch, pending);
+    }
+
+    //DROP_COUNT时把丢弃的条数作为一条日志发出去
+    void reportDropped() {
+        uint64_t d = dropped.load(std::memory_order_relaxed);
+        if (overflow != AsyncLogDispatcher::DROP_COUNT || d == reported) {
+            return;
+        }
+        std::string text = "socket log buffer full, dropped " + std::to_string(d - reported) + " records";
+        struct timespec ts;
+        GetRealTime(ts);
+        Frame(batch.data, framing, isStream(), LogLevel::WARN, ts.tv_sec, ts.tv_nsec, "lch"
+                , text.c_str(), text.size());
+        batch.ends.push_back(batch.data.size());
+        reported = d;
+        ++notices;
+    }
+
+    bool connect() {
+        int s = socket(family, type | SOCK_CLOEXEC, 0);
+        if (s < 0) {
+            return false;
+        }
+        if (::connect(s, (struct sockaddr*)&addr, addrLen)) {
+            close(s);
+            return false;
+        }
+        //对端不读时最多阻塞这么久，保证stop能退出
+        struct timeval tv = {1, 0};
+        setsockopt(s, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+        fd = s;
+        connected = true;
+        return true;
+    }
+
+    void closeSocket() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        connected = false;
+    }
+
+    //批次末尾的notices条是reportDropped加的，不计入unsent和sent
+    void account(size_t n) {
+        size_t user_end = batch.ends.size() - notices;
+        size_t end = batch.next + n;
+        size_t user = batch.next < user_end ? std::min(end, user_end) - batch.next : 0;
+        batch.next = end;
+        unsent -= user;
+        sent += user;
+    }
+
+    //返回0发完，1超时需要重试，-1连接出错
+    int sendBatch() {
+        if (!isStream()) {
+            struct mmsghdr msgs[s_batch_msgs];
+            struct iovec iovs[s_batch_msgs];
+            while (!batch.empty()) {
+                int n = std::min<size_t>(s_batch_msgs, batch.ends.size() - batch.next);
+                memset(msgs, 0, sizeof(msgs[0]) * n);
+                for (int i = 0; i < n; ++i) {
+                    size_t begin = batch.begin(batch.next + i);
+                    iovs[i].iov_base = &batch.data[begin];
+                    iovs[i].iov_len = batch.ends[batch.next + i] - begin;
+                    msgs[i].msg_hdr.msg_iov = &iovs[i];
+                    msgs[i].msg_hdr.msg_iovlen = 1;
+                }
+                int rt = sendmmsg(fd, msgs, n, 0);
+                if (rt < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    return errno == EAGAIN || errno == EWOULDBLOCK ? 1 : -1;
+                }
+                account(rt);
+            }
+            return 0;
+        }
+        //流式连接上所有日志首尾相接，从下一条的开头一次写完
+        size_t offset = batch.begin(batch.next);
+        while (offset < batch.data.size()) {
+            ssize_t rt = send(fd, batch.data.data() + offset, batch.data.size() - offset, MSG_NOSIGNAL);
+            if (rt < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    //半条已经发出去了，不能换连接重发，只能接着等
+                    if (offset != batch.begin(batch.next) && !stopping) {
+                        continue;
+                    }
+                    return 1;
+                }
+                //断开后从这一条的开头重发
+                return -1;
+            }
+            offset += rt;
+            size_t n = 0;
+            while (batch.next + n < batch.ends.size() && batch.ends[batch.next + n] <= offset) {
+                ++n;
+            }
+            if (n) {
+                account(n);
+            }
+        }
+        return 0;
+    }
+
+    //退避期间每10ms检查一次是否要停止
+    void nap(uint32_t ms) {
+        for (uint32_t i = 0; i < ms && !stopping; i += 10) {
+            usleep(10 * 1000);
+        }
+    }
+
+    void run() {
+        uint32_t backoff = s_min_backoff_ms;
+        while (true) {
+            if (batch.empty()) {
+                take();
+                notices = 0;
+                reportDropped();
+            }
+            if (batch.empty()) {
+                if (stopping) {
+                    break;
+                }
+                sleeping = true;
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (hasPending() || stopping) {
+                    if (sleeping.exchange(false)) {
+                        continue;
+                    }
+                }
+                sem.wait();
+                continue;
+            }
+            if (fd < 0 && !connect()) {
+                if (stopping) {
+                    break;
+                }
+                nap(backoff);
+                backoff = std::min(backoff * 2, s_max_backoff_ms);
+                continue;
+            }
+            int rt = sendBatch();
+            if (rt == 0) {
+                backoff = s_min_backoff_ms;
+            } else if (rt < 0) {
+                closeSocket();
+            } else if (stopping) {
+                break;
+            }
+        }
+        //停止时发不出去的日志算作丢弃
+        take();
+        size_t left = unsent.exchange(0);
+        dropped += left;
+        closeSocket();
+    }
+
+    Framing framing;
+    size_t maxPending;
+    AsyncLogDispatcher::OverflowPolicy overflow;
+    bool valid = false;
+    int family = AF_UNIX;
+    int type = SOCK_DGRAM;
+    struct sockaddr_storage addr;
+    socklen_t addrLen = 0;
+    int fd = -1;
+
+    Mutex mutex;
+    Batch pending;
+    //只由后台线程访问
+    Batch batch;
+    size_t notices = 0;
+    uint64_t reported = 0;
+
+    Thread::ptr thread;
+    Semaphore sem;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+    std::atomic<bool> connected;
+    std::atomic<size_t> unsent;
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> dropped;
+};
+
+/*******************************SocketLogAppender*********************************/
+const char* SocketLogAppender::ToString(Framing framing) {
+    return framing == LENGTH ? "length" : "syslog";
+}
+
+SocketLogAppender::Framing SocketLogAppender::FromString(const std::string& str) {
+    return str == "length" ? LENGTH : SYSLOG;
+}
+
+SocketLogAppender::SocketLogAppender(const std::string& address, Framing framing, size_t max_pending
+        , AsyncLogDispatcher::OverflowPolicy overflow)
+    :LogAppender(true)
+    ,m_address(address)
+    ,m_framing(framing)
+    ,m_maxPending(max_pending)
+    ,m_overflow(overflow)
+    ,m_sender(new Sender(address, framing, max_pending, overflow)) {
+    if (m_sender->valid) {
+        m_sender->start(m_sender);
+    }
+}
+
+SocketLogAppender::~SocketLogAppender() {
+    m_sender->stop();
+}
+
+void SocketLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void SocketLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    if (!m_sender->valid) {
+        return;
+    }
+    size_t len = text.size();
+    if (len && text[len - 1] == '\n') {
+        --len;
+    }
+    static thread_local std::string s_frame;
+    s_frame.clear();
+    Frame(s_frame, m_framing, m_sender->isStream(), level, event->getTime(), event->getNanosecond()
+            , event->getLogger()->getName(), text.data(), len);
+    m_sender->push(s_frame);
+}
+
+bool SocketLogAppender::flush(uint32_t timeout_ms) {
+    uint64_t deadline = GetMonotonicNS() + (uint64_t)timeout_ms * 1000000;
+    while (m_sender->unsent.load()) {
+        if (!m_sender->valid || GetMonotonicNS() >= deadline) {
+            return false;
+        }
+        m_sender->notify();
+        usleep(1000);
+    }
+    return true;
+}
+
+bool SocketLogAppender::isValid() const {
+    return m_sender->valid;
+}
+
+bool SocketLogAppender::isConnected() const {
+    return m_sender->connected;
+}
+
+uint64_t SocketLogAppender::getSent() const {
+    return m_sender->sent;
+}
+
+uint64_t SocketLogAppender::getDropped() const {
+    return m_sender->dropped;
+}
+
+std::string SocketLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "SocketLogAppender";
+    node["address"] = m_address;
+    node["framing"] = ToString(m_framing);
+    node["max_pending"] = m_maxPending;
+    node["overflow"] = AsyncLogDispatcher::ToString(m_overflow);
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+}
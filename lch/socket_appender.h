@@ -0,0 +1,63 @@
+#ifndef __LCH_SOCKET_APPENDER_H__
+#define __LCH_SOCKET_APPENDER_H__
+
+#include <string>
+#include <memory>
+#include "log.h"
+
+namespace lch {
+
+//把日志发到UNIX域套接字或UDP端口的Appender
+//地址: udp://host:port、unix:///path(数据报)、unix-stream:///path(流)
+//格式: SYSLOG为RFC5424，流式连接上按RFC6587在前面加 "长度 "；LENGTH为4字节大端长度+内容
+//      都不带结尾的换行
+//日志格式化后放进缓冲区，由后台线程批量发送(数据报用sendmmsg，流用一次write)
+//连接失败或断开后由后台线程退避重连，调用者不会因为网络阻塞；
+//缓冲区超过max_pending字节时按overflow处理，BLOCK时调用者等到有空间为止
+class SocketLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<SocketLogAppender> ptr;
+
+    enum Framing {
+        SYSLOG = 0,
+        LENGTH = 1
+    };
+    static const char* ToString(Framing framing);
+    static Framing FromString(const std::string& str);
+
+    SocketLogAppender(const std::string& address, Framing framing = SYSLOG
+                      , size_t max_pending = 4 * 1024 * 1024
+                      , AsyncLogDispatcher::OverflowPolicy overflow = AsyncLogDispatcher::DROP_COUNT);
+    //尽量把缓冲区里的日志发完(连接不上时不等)后停止后台线程
+    ~SocketLogAppender();
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+
+    //等缓冲区里的日志全部发出，最多等timeout_ms毫秒，发完返回true
+    bool flush(uint32_t timeout_ms = 1000);
+
+    //地址格式错误时为false，不会发送任何日志
+    bool isValid() const;
+    bool isConnected() const;
+    uint64_t getSent() const;
+    uint64_t getDropped() const;
+
+    const std::string& getAddress() const { return m_address; }
+    Framing getFraming() const { return m_framing; }
+    size_t getMaxPending() const { return m_maxPending; }
+    AsyncLogDispatcher::OverflowPolicy getOverflow() const { return m_overflow; }
+private:
+    struct Sender;
+private:
+    std::string m_address;
+    Framing m_framing;
+    size_t m_maxPending;
+    AsyncLogDispatcher::OverflowPolicy m_overflow;
+    std::shared_ptr<Sender> m_sender;
+};
+
+}
+
+#endif // !__LCH_SOCKET_APPENDER_H__
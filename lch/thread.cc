@@ -60,9 +60,10 @@ void Thread::join() {
 
 void* Thread::run(void* arg) {
     Thread* thread = (Thread*)arg;
+    //线程一启动就缓存tid，之后的日志不再调用gettid
+    thread->m_id = lch::GetThreadId();
     t_thread = thread;
     t_thread_name = thread->m_name;
-    thread->m_id = lch::GetThreadId();
     pthread_setname_np(pthread_self(), thread->m_name.substr(0, 15).c_str());
 
     std::function<void()> cb;
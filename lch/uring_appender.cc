@@ -0,0 +1,818 @@
+#include "uring_appender.h"
+#include "config.h"
+#include "thread.h"
+#include "util.h"
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <limits.h>
+#include <algorithm>
+
+namespace lch {
+
+//链在写后面的同步操作的user_data
+static const uint64_t s_sync_tag = ~0ULL;
+//不使用缓冲区的待写入内容
+static const uint32_t s_no_buffer = ~0U;
+
+/*******************************Uring*********************************/
+namespace {
+
+//最小的io_uring封装，只用到提交、等待完成和注册，不依赖liburing
+//只由后台线程使用，不加锁
+class Uring {
+public:
+    ~Uring() {
+        close();
+    }
+
+    bool init(unsigned entries) {
+        struct io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        int fd = syscall(__NR_io_uring_setup, entries, &p);
+        if (fd < 0) {
+            return false;
+        }
+        m_fd = fd;
+        m_sqRingSize = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cqRingSize = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        //5.4以后SQ和CQ在同一块映射里
+        bool single = p.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+        }
+        m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+                        , fd, IORING_OFF_SQ_RING);
+        if (m_sqRing == MAP_FAILED) {
+            close();
+            return false;
+        }
+        if (single) {
+            m_cqRing = m_sqRing;
+        } else {
+            m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+                            , fd, IORING_OFF_CQ_RING);
+            if (m_cqRing == MAP_FAILED) {
+                close();
+                return false;
+            }
+        }
+        m_sqesSize = p.sq_entries * sizeof(struct io_uring_sqe);
+        void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE
+                          , fd, IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            close();
+            return false;
+        }
+        m_sqes = (struct io_uring_sqe*)sqes;
+        char* sq = (char*)m_sqRing;
+        char* cq = (char*)m_cqRing;
+        m_sqHead = (unsigned*)(sq + p.sq_off.head);
+        m_sqTail = (unsigned*)(sq + p.sq_off.tail);
+        m_sqMask = *(unsigned*)(sq + p.sq_off.ring_mask);
+        m_sqArray = (unsigned*)(sq + p.sq_off.array);
+        m_sqEntries = p.sq_entries;
+        m_cqHead = (unsigned*)(cq + p.cq_off.head);
+        m_cqTail = (unsigned*)(cq + p.cq_off.tail);
+        m_cqMask = *(unsigned*)(cq + p.cq_off.ring_mask);
+        m_cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+        m_localTail = *m_sqTail;
+        return true;
+    }
+
+    void close() {
+        if (m_sqes) {
+            munmap(m_sqes, m_sqesSize);
+            m_sqes = nullptr;
+        }
+        if (m_cqRing != MAP_FAILED && m_cqRing != m_sqRing) {
+            munmap(m_cqRing, m_cqRingSize);
+        }
+        m_cqRing = MAP_FAILED;
+        if (m_sqRing != MAP_FAILED) {
+            munmap(m_sqRing, m_sqRingSize);
+            m_sqRing = MAP_FAILED;
+        }
+        if (m_fd >= 0) {
+            ::close(m_fd);
+            m_fd = -1;
+        }
+    }
+
+    bool isOpen() const { return m_fd >= 0; }
+
+    //取一个清零的SQE，队列满时返回nullptr
+    struct io_uring_sqe* getSqe() {
+        unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+        if (m_localTail - head >= m_sqEntries) {
+            return nullptr;
+        }
+        unsigned idx = m_localTail & m_sqMask;
+        struct io_uring_sqe* sqe = &m_sqes[idx];
+        memset(sqe, 0, sizeof(*sqe));
+        m_sqArray[idx] = idx;
+        ++m_localTail;
+        return sqe;
+    }
+
+    //提交取出的SQE并等待wait_nr个完成，失败返回-errno
+    int submitAndWait(unsigned wait_nr) {
+        __atomic_store_n(m_sqTail, m_localTail, __ATOMIC_RELEASE);
+        while (true) {
+            unsigned submit = m_localTail - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+            int rt = syscall(__NR_io_uring_enter, m_fd, submit, wait_nr
+                             , wait_nr ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+            if (rt >= 0) {
+                return rt;
+            }
+            if (errno != EINTR) {
+                return -errno;
+            }
+            //被信号打断时已经提交的不会重复提交，只等待剩下的完成
+            unsigned ready = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE) - *m_cqHead;
+            wait_nr = wait_nr > ready ? wait_nr - ready : 0;
+        }
+    }
+
+    //等待至少wait_nr个完成，失败返回-errno
+    int wait(unsigned wait_nr) {
+        while (true) {
+            int rt = syscall(__NR_io_uring_enter, m_fd, 0, wait_nr, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (rt >= 0 || errno != EINTR) {
+                return rt >= 0 ? rt : -errno;
+            }
+        }
+    }
+
+    bool popCqe(struct io_uring_cqe& cqe) {
+        unsigned head = *m_cqHead;
+        if (head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        cqe = m_cqes[head & m_cqMask];
+        __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+    bool registerBuffers(const struct iovec* iovs, unsigned n) {
+        return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_BUFFERS, iovs, n) == 0;
+    }
+
+    bool registerFile(int fd) {
+        return syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_FILES, &fd, 1) == 0;
+    }
+
+    void unregisterFiles() {
+        syscall(__NR_io_uring_register, m_fd, IORING_UNREGISTER_FILES, nullptr, 0);
+    }
+private:
+    int m_fd = -1;
+    void* m_sqRing = MAP_FAILED;
+    void* m_cqRing = MAP_FAILED;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    struct io_uring_sqe* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqMask = 0;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned m_cqMask = 0;
+    struct io_uring_cqe* m_cqes = nullptr;
+    //已经填好但还没有对内核可见的SQE的尾部
+    unsigned m_localTail = 0;
+};
+
+//从offset开始写满，只写了一部分时继续写
+static bool PWriteFull(int fd, struct iovec* iov, int cnt, off_t offset) {
+    while (cnt > 0) {
+        ssize_t n = pwritev(fd, iov, std::min(cnt, IOV_MAX), offset);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        offset += n;
+        while (cnt > 0 && (size_t)n >= iov->iov_len) {
+            n -= iov->iov_len;
+            ++iov;
+            --cnt;
+        }
+        if (cnt > 0) {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+    return true;
+}
+
+}
+
+/*******************************Writer*********************************/
+struct UringFileLogAppender::Writer {
+    //等待写入的缓冲区
+    struct Ready {
+        uint32_t index;
+        uint32_t len;
+        uint64_t offset = 0;        //提交时分配的文件偏移
+        std::string* big = nullptr; //超过缓冲区大小的日志，index为s_no_buffer
+    };
+
+    Writer(const std::string& name, SyncPolicy s, uint32_t sync_ms, uint32_t buffer_size
+            , uint32_t count, uint32_t flush_ms)
+        :filename(name)
+        ,sync(s)
+        ,syncInterval(sync_ms)
+        ,bufferSize(std::max<uint32_t>(buffer_size, 4096))
+        ,flushInterval(flush_ms)
+        ,sleeping(false)
+        ,stopping(false)
+        ,uring(false)
+        ,running(false)
+        ,flushRequests(0)
+        ,flushDone(0)
+        ,syncRequested(false)
+        ,submits(0)
+        ,syncs(0) {
+        count = std::max<uint32_t>(count, 2);
+        //按页对齐，注册时内核按页固定
+        for (uint32_t i = 0; i < count; ++i) {
+            void* p = nullptr;
+            if (posix_memalign(&p, 4096, bufferSize)) {
+                throw std::bad_alloc();
+            }
+            struct iovec iov;
+            iov.iov_base = p;
+            iov.iov_len = bufferSize;
+            buffers.push_back(iov);
+            free.push_back(count - 1 - i);
+        }
+        openFile();
+    }
+
+    ~Writer() {
+        for (auto& i : buffers) {
+            ::free(i.iov_base);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool openFile() {
+        fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            std::cout << "UringFileLogAppender open " << filename << " failed: " << strerror(errno) << std::endl;
+            return false;
+        }
+        //不用O_APPEND，每次写入都带着偏移，提交的多个写可以并发完成
+        offset = lseek(fd, 0, SEEK_END);
+        return true;
+    }
+
+    void start(std::shared_ptr<Writer> self) {
+        //每个缓冲区一个写，再加一个同步
+        if (ring.init(buffers.size() + 1)) {
+            uring = true;
+            fixedBuffers = ring.registerBuffers(&buffers[0], buffers.size());
+            fixedFile = fd >= 0 && ring.registerFile(fd);
+        }
+        thread.reset(new Thread([self]() { self->run(); }, "log_uring"));
+        running = true;
+    }
+
+    void stop() {
+        stopping = true;
+        notify();
+        if (thread) {
+            thread->join();
+            running = false;
+            thread.reset();
+        }
+    }
+
+    void notify() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (sleeping.load(std::memory_order_relaxed) && sleeping.exchange(false)) {
+            sem.notify();
+        }
+    }
+
+    //把正在写入的缓冲区交给后台线程，调用者持有mutex
+    void pushCurrent() {
+        Ready r;
+        r.index = cur;
+        r.len = curLen;
+        ready.push_back(r);
+        cur = -1;
+    }
+
+    //写日志的线程调用，只拷贝，缓冲区写满时才唤醒后台线程
+    //一条日志总是整条放在一个缓冲区里，不会被其他线程的日志隔开
+    void append(const char* data, size_t len) {
+        bool wake = false;
+        int spins = 0;
+        Mutex::Lock lock(mutex);
+        if (len > bufferSize) {
+            //比缓冲区还大的日志单独分配内存，写在当前缓冲区之后
+            if (cur >= 0 && curLen) {
+                pushCurrent();
+            }
+            Ready r;
+            r.index = s_no_buffer;
+            r.len = len;
+            r.big = new std::string(data, len);
+            ready.push_back(r);
+            lock.unlock();
+            notify();
+            return;
+        }
+        while (true) {
+            if (cur >= 0) {
+                if (curLen + len <= bufferSize) {
+                    break;
+                }
+                pushCurrent();
+                wake = true;
+                continue;
+            }
+            if (!free.empty()) {
+                cur = free.back();
+                free.pop_back();
+                curLen = 0;
+                curSince = GetMonotonicNS();
+                break;
+            }
+            //所有缓冲区都在等待写入
+            if (!running) {
+                return;
+            }
+            lock.unlock();
+            notify();
+            if (++spins < 64) {
+                sched_yield();
+            } else {
+                usleep(100);
+            }
+            lock.lock();
+        }
+        memcpy((char*)buffers[cur].iov_base + curLen, data, len);
+        curLen += len;
+        if (curLen == bufferSize) {
+            pushCurrent();
+            wake = true;
+        }
+        lock.unlock();
+        if (wake) {
+            notify();
+        }
+    }
+
+    //请求后台线程把当前的缓冲区写出，等待完成
+    void flush(bool need_sync) {
+        if (!running) {
+            return;
+        }
+        if (need_sync) {
+            syncRequested = true;
+        }
+        uint64_t req = ++flushRequests;
+        while (flushDone.load() < req && running) {
+            notify();
+            usleep(100);
+        }
+    }
+
+    bool reopen() {
+        Mutex::Lock lock(ioMutex);
+        int old = fd;
+        if (!openFile()) {
+            fd = old;
+            return false;
+        }
+        if (fixedFile) {
+            ring.unregisterFiles();
+            fixedFile = ring.registerFile(fd);
+        }
+        if (old >= 0) {
+            close(old);
+        }
+        return true;
+    }
+
+    void doSync() {
+        if (sync == FDATASYNC) {
+            fdatasync(fd);
+        } else {
+            fsync(fd);
+        }
+        ++syncs;
+    }
+
+    char* dataOf(const Ready& r) {
+        return r.big ? &(*r.big)[0] : (char*)buffers[r.index].iov_base;
+    }
+
+    //同步写出batch，need_sync为true时写完后同步一次
+    void write(std::vector<Ready>& batch, bool need_sync) {
+        if (fd < 0) {
+            return;
+        }
+        for (auto& r : batch) {
+            r.offset = offset;
+            offset += r.len;
+        }
+        size_t begin = 0;
+        //SQ放不下时分几次提交，同步链在最后一次；写刚好占满SQ时同步单独提交一次
+        while (uring && (begin < batch.size() || need_sync)) {
+            size_t end = submitBatch(batch, begin, need_sync);
+            if (end == (size_t)-1) {
+                break;
+            }
+            begin = end;
+        }
+        if (begin < batch.size()) {
+            std::vector<struct iovec> iovs;
+            for (size_t i = begin; i < batch.size(); ++i) {
+                struct iovec iov;
+                iov.iov_base = dataOf(batch[i]);
+                iov.iov_len = batch[i].len;
+                iovs.push_back(iov);
+            }
+            PWriteFull(fd, &iovs[0], iovs.size(), batch[begin].offset);
+            ++submits;
+        }
+        if (need_sync) {
+            doSync();
+        }
+    }
+
+    //用io_uring写batch中从begin开始的一段，放得下的话后面再链一个同步
+    //返回写到的位置，io_uring出错时返回-1，之后改用pwritev
+    size_t submitBatch(std::vector<Ready>& batch, size_t begin, bool& need_sync) {
+        std::vector<struct iovec> iovs(batch.size() - begin);
+        size_t end = begin;
+        unsigned count = 0;
+        struct io_uring_sqe* last = nullptr;
+        for (; end < batch.size(); ++end) {
+            struct io_uring_sqe* sqe = ring.getSqe();
+            if (!sqe) {
+                break;
+            }
+            Ready& r = batch[end];
+            struct iovec& iov = iovs[end - begin];
+            iov.iov_base = dataOf(r);
+            iov.iov_len = r.len;
+            if (fixedBuffers && !r.big) {
+                sqe->opcode = IORING_OP_WRITE_FIXED;
+                sqe->addr = (uint64_t)(uintptr_t)iov.iov_base;
+                sqe->len = r.len;
+                sqe->buf_index = r.index;
+            } else {
+                sqe->opcode = IORING_OP_WRITEV;
+                sqe->addr = (uint64_t)(uintptr_t)&iov;
+                sqe->len = 1;
+            }
+            setFile(sqe);
+            sqe->off = r.offset;
+            sqe->user_data = end;
+            last = sqe;
+            ++count;
+        }
+        bool sync_linked = false;
+        if (need_sync && end == batch.size()) {
+            struct io_uring_sqe* sqe = ring.getSqe();
+            if (sqe) {
+                //同步要等所有写完成，链在最后一个写后面
+                if (last) {
+                    last->flags |= IOSQE_IO_LINK;
+                }
+                sqe->opcode = IORING_OP_FSYNC;
+                sqe->fsync_flags = sync == FDATASYNC ? IORING_FSYNC_DATASYNC : 0;
+                setFile(sqe);
+                sqe->user_data = s_sync_tag;
+                sync_linked = true;
+                ++count;
+            }
+        }
+        int rt = ring.submitAndWait(count);
+        ++submits;
+        if (rt < 0) {
+            //以后都改用pwritev，这一段由调用者用pwritev写完
+            std::cout << "UringFileLogAppender io_uring_enter failed: " << strerror(-rt) << std::endl;
+            ring.close();
+            uring = false;
+            return (size_t)-1;
+        }
+        //所有写都完成之后缓冲区才能还回去
+        bool sync_failed = sync_linked;
+        std::vector<bool> done(end - begin, false);
+        struct io_uring_cqe cqe;
+        for (unsigned i = 0; i < count;) {
+            if (!ring.popCqe(cqe)) {
+                int err = ring.wait(count - i);
+                if (err < 0) {
+                    std::cout << "UringFileLogAppender io_uring wait failed: " << strerror(-err) << std::endl;
+                    abandon(batch, begin, done);
+                    break;
+                }
+                continue;
+            }
+            ++i;
+            if (cqe.user_data == s_sync_tag) {
+                //前面的写没写完时同步会被取消，写完剩下的之后再同步
+                if (cqe.res >= 0) {
+                    sync_failed = false;
+                    ++syncs;
+                }
+                continue;
+            }
+            Ready& r = batch[cqe.user_data];
+            uint32_t written = cqe.res > 0 ? cqe.res : 0;
+            if (written < r.len) {
+                struct iovec iov;
+                iov.iov_base = dataOf(r) + written;
+                iov.iov_len = r.len - written;
+                PWriteFull(fd, &iov, 1, r.offset + written);
+            }
+            done[cqe.user_data - begin] = true;
+        }
+        if (sync_linked) {
+            if (sync_failed) {
+                doSync();
+            }
+            need_sync = false;
+        }
+        return end;
+    }
+
+    //等待完成失败时还有写在内核里，关闭ring，以后都改用pwritev
+    //没有确认完成的写用pwritev按原来的偏移重写一遍，内核晚完成的写内容相同；
+    //内核可能还在读它们的内存，这些缓冲区不再使用(换成新分配的)，故意泄漏
+    void abandon(std::vector<Ready>& batch, size_t begin, const std::vector<bool>& done) {
+        ring.close();
+        uring = false;
+        for (size_t i = 0; i < done.size(); ++i) {
+            if (done[i]) {
+                continue;
+            }
+            Ready& r = batch[begin + i];
+            if (r.big) {
+                r.big = new std::string(*r.big);
+            } else {
+                void* p = nullptr;
+                if (posix_memalign(&p, 4096, bufferSize)) {
+                    throw std::bad_alloc();
+                }
+                memcpy(p, buffers[r.index].iov_base, r.len);
+                Mutex::Lock lock(mutex);
+                buffers[r.index].iov_base = p;
+            }
+            struct iovec iov;
+            iov.iov_base = dataOf(r);
+            iov.iov_len = r.len;
+            PWriteFull(fd, &iov, 1, r.offset);
+        }
+    }
+
+    void setFile(struct io_uring_sqe* sqe) {
+        if (fixedFile) {
+            sqe->fd = 0;
+            sqe->flags |= IOSQE_FIXED_FILE;
+        } else {
+            sqe->fd = fd;
+        }
+    }
+
+    //距离上次同步是否超过了间隔
+    bool syncDue(uint64_t now) const {
+        return syncInterval == 0 || now - lastSync >= (uint64_t)syncInterval * 1000000;
+    }
+
+    void run() {
+        std::vector<Ready> batch;
+        lastSync = GetMonotonicNS();
+        while (true) {
+            bool stop = stopping;
+            uint64_t req = flushRequests.load();
+            bool sync_req = syncRequested.exchange(false);
+            uint64_t now = GetMonotonicNS();
+            {
+                Mutex::Lock lock(mutex);
+                //没写满的缓冲区超过flush_interval或者被要求刷新时也写出去
+                if (cur >= 0 && curLen && (stop || req != flushDone || now - curSince >= (uint64_t)flushInterval * 1000000)) {
+                    pushCurrent();
+                }
+                batch.swap(ready);
+            }
+            if (!batch.empty()) {
+                dirty = true;
+            }
+            bool need_sync = sync != NONE && dirty && (stop || sync_req || syncDue(now));
+            bool wrote = !batch.empty();
+            if (wrote || need_sync) {
+                Mutex::Lock io(ioMutex);
+                write(batch, need_sync);
+                io.unlock();
+                if (need_sync) {
+                    lastSync = now;
+                    dirty = false;
+                }
+                Mutex::Lock lock(mutex);
+                for (auto& r : batch) {
+                    if (r.big) {
+                        delete r.big;
+                    } else {
+                        free.push_back(r.index);
+                    }
+                }
+                lock.unlock();
+                batch.clear();
+            }
+            flushDone = req;
+            if (stop) {
+                break;
+            }
+            if (wrote) {
+                continue;
+            }
+
+            //有没写满的缓冲区时最多睡到该刷新的时候，有没同步的数据时最多睡到该同步的时候
+            uint32_t timeout = 1000;
+            {
+                Mutex::Lock lock(mutex);
+                if (!ready.empty()) {
+                    continue;
+                }
+                if (cur >= 0 && curLen) {
+                    timeout = flushInterval;
+                }
+            }
+            if (sync != NONE && dirty) {
+                timeout = std::min(timeout, syncInterval);
+            }
+            sleeping = true;
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (hasReady() || stopping || flushRequests.load() != flushDone) {
+                if (sleeping.exchange(false)) {
+                    continue;
+                }
+            }
+            if (!sem.wait(std::max<uint32_t>(timeout, 1))) {
+                sleeping = false;
+            }
+        }
+        if (uring) {
+            ring.close();
+        }
+    }
+
+    bool hasReady() {
+        Mutex::Lock lock(mutex);
+        return !ready.empty();
+    }
+
+    std::string filename;
+    SyncPolicy sync;
+    uint32_t syncInterval;
+    uint32_t bufferSize;
+    uint32_t flushInterval;
+    int fd = -1;
+    uint64_t offset = 0;
+
+    //写日志的线程和后台线程共用，保护下面的缓冲区状态
+    Mutex mutex;
+    std::vector<struct iovec> buffers;
+    std::vector<uint32_t> free;
+    std::vector<Ready> ready;
+    int cur = -1;               //正在写入的缓冲区，-1表示没有
+    uint32_t curLen = 0;
+    uint64_t curSince = 0;      //正在写入的缓冲区第一次写入的时间
+
+    //写文件和reopen互斥
+    Mutex ioMutex;
+    Uring ring;
+    bool fixedBuffers = false;
+    bool fixedFile = false;
+    //只由后台线程访问
+    uint64_t lastSync = 0;
+    bool dirty = false;
+
+    Thread::ptr thread;
+    Semaphore sem;
+    std::atomic<bool> sleeping;
+    std::atomic<bool> stopping;
+    std::atomic<bool> uring;
+    //后台线程在运行，写日志的线程只看这个标志，不读stop时会被重置的thread
+    std::atomic<bool> running;
+    std::atomic<uint64_t> flushRequests;
+    std::atomic<uint64_t> flushDone;
+    std::atomic<bool> syncRequested;
+    std::atomic<uint64_t> submits;
+    std::atomic<uint64_t> syncs;
+};
+
+/*******************************UringFileLogAppender*********************************/
+const char* UringFileLogAppender::ToString(SyncPolicy policy) {
+    switch (policy) {
+        case FDATASYNC:
+            return "fdatasync";
+        case FSYNC:
+            return "fsync";
+        default:
+            return "none";
+    }
+}
+
+UringFileLogAppender::SyncPolicy UringFileLogAppender::FromString(const std::string& str) {
+    if (str == "fdatasync") {
+        return FDATASYNC;
+    }
+    if (str == "fsync") {
+        return FSYNC;
+    }
+    return NONE;
+}
+
+UringFileLogAppender::UringFileLogAppender(const std::string& filename, SyncPolicy sync, uint32_t sync_interval
+        , uint32_t buffer_size, uint32_t buffers, uint32_t flush_interval)
+    :LogAppender(true)
+    ,m_filename(filename)
+    ,m_sync(sync)
+    ,m_syncInterval(sync_interval)
+    ,m_bufferSize(buffer_size)
+    ,m_buffers(buffers)
+    ,m_flushInterval(flush_interval)
+    ,m_writer(new Writer(filename, sync, sync_interval, buffer_size, buffers, flush_interval)) {
+    m_writer->start(m_writer);
+}
+
+UringFileLogAppender::~UringFileLogAppender() {
+    m_writer->stop();
+}
+
+void UringFileLogAppender::log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) {
+    if (level >= m_level) {
+        static thread_local std::string s_buf;
+        s_buf.clear();
+        formatter()->format(s_buf, logger, level, event);
+        logFormatted(logger, level, event, s_buf);
+    }
+}
+
+void UringFileLogAppender::logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level, const LogEvent::ptr& event, const std::string& text) {
+    m_writer->append(text.data(), text.size());
+}
+
+void UringFileLogAppender::flush(bool sync) {
+    m_writer->flush(sync);
+}
+
+bool UringFileLogAppender::reopen() {
+    return m_writer->reopen();
+}
+
+bool UringFileLogAppender::isUring() const {
+    return m_writer->uring;
+}
+
+uint64_t UringFileLogAppender::getSubmits() const {
+    return m_writer->submits;
+}
+
+uint64_t UringFileLogAppender::getSyncs() const {
+    return m_writer->syncs;
+}
+
+std::string UringFileLogAppender::toYamlString() {
+    YAML::Node node;
+    node["type"] = "UringFileLogAppender";
+    node["file"] = m_filename;
+    node["sync"] = ToString(m_sync);
+    node["sync_interval"] = m_syncInterval;
+    node["buffer_size"] = m_bufferSize;
+    node["buffers"] = m_buffers;
+    node["flush_interval"] = m_flushInterval;
+    if(m_level != LogLevel::UNKNOW) {
+        node["level"] = LogLevel::ToString(m_level);
+    }
+    LogFormatter::ptr fmt = getFormatter();
+    if(m_hasFormatter && fmt) {
+        node["formatter"] = fmt->getPattern();
+    }
+    std::stringstream ss;
+    ss << node;
+    return ss.str();
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef __LCH_URING_APPENDER_H__
+#define __LCH_URING_APPENDER_H__
+
+#include <string>
+#include <memory>
+#include "log.h"
+
+namespace lch {
+
+//通过io_uring批量写文件的Appender
+//写日志的线程只把格式化好的内容拷贝进预先分配的缓冲区，不做系统调用；
+//缓冲区写满或者超过flush_interval毫秒后由后台线程一次提交所有待写的缓冲区，
+//缓冲区和文件都事先注册到io_uring中，写入用WRITE_FIXED，需要同步时在最后一个写后面链上fsync/fdatasync
+//内核不支持io_uring(或者被禁用)时退化为pwritev + fsync/fdatasync，行为不变
+//缓冲区都在等待写入时，写日志的线程等待后台线程腾出缓冲区
+class UringFileLogAppender : public LogAppender {
+public:
+    typedef std::shared_ptr<UringFileLogAppender> ptr;
+
+    enum SyncPolicy {
+        NONE = 0,           //不主动同步，交给内核回写
+        FDATASYNC = 1,
+        FSYNC = 2
+    };
+    static const char* ToString(SyncPolicy policy);
+    static SyncPolicy FromString(const std::string& str);
+
+    //sync_interval为两次同步之间最少间隔的毫秒数，0表示每批写入都同步
+    //buffer_size为每个缓冲区的字节数，buffers为缓冲区个数
+    UringFileLogAppender(const std::string& filename, SyncPolicy sync = NONE, uint32_t sync_interval = 1000
+                         , uint32_t buffer_size = 256 * 1024, uint32_t buffers = 8, uint32_t flush_interval = 100);
+    //写出缓冲区中剩余的内容后停止后台线程
+    ~UringFileLogAppender();
+    void log(std::shared_ptr<Logger> logger, LogLevel::Level level, LogEvent::ptr event) override;
+    void logFormatted(const std::shared_ptr<Logger>& logger, LogLevel::Level level
+                      , const LogEvent::ptr& event, const std::string& text) override;
+    std::string toYamlString() override;
+
+    //把已经写入的日志全部交给内核，sync为true时再按同步策略同步一次
+    void flush(bool sync = false);
+    //关闭当前文件后重新打开(追加写)，成功返回true
+    bool reopen();
+
+    //是否在使用io_uring，false表示退化为pwritev
+    bool isUring() const;
+    //提交写操作的系统调用次数(io_uring_enter或pwritev)
+    uint64_t getSubmits() const;
+    uint64_t getSyncs() const;
+
+    const std::string& getFilename() const { return m_filename; }
+    SyncPolicy getSync() const { return m_sync; }
+    uint32_t getSyncInterval() const { return m_syncInterval; }
+    uint32_t getBufferSize() const { return m_bufferSize; }
+    uint32_t getBuffers() const { return m_buffers; }
+    uint32_t getFlushInterval() const { return m_flushInterval; }
+private:
+    //后台线程和Appender共享的状态
+    struct Writer;
+private:
+    std::string m_filename;
+    SyncPolicy m_sync;
+    uint32_t m_syncInterval;
+    uint32_t m_bufferSize;
+    uint32_t m_buffers;
+    uint32_t m_flushInterval;
+    std::shared_ptr<Writer> m_writer;
+};
+
+}
+
+#endif // !__LCH_URING_APPENDER_H__
@@ -1,9 +1,234 @@
 #include "util.h"
+#include "mutex.h"
+#include <string.h>
+#include <stdlib.h>
+#include <alloca.h>
+#include <execinfo.h>
+#include <dlfcn.h>
+#include <cxxabi.h>
+#include <sstream>
+#include <unordered_map>
+#if defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+//0表示还没取过，fork出的子进程在atfork回调里清掉
+static thread_local pid_t t_thread_id = 0;
+
+static void ResetThreadIdAfterFork() {
+    t_thread_id = 0;
+}
+
+struct ThreadIdIniter {
+    ThreadIdIniter() {
+        pthread_atfork(nullptr, nullptr, &ResetThreadIdAfterFork);
+    }
+};
+static ThreadIdIniter __thread_id_init;
 
 pid_t lch::GetThreadId() {
-    return syscall(SYS_gettid);
+    if (!t_thread_id) {
+        t_thread_id = syscall(SYS_gettid);
+    }
+    return t_thread_id;
 }
 
 uint32_t lch::GetFiberId() {
     return 0;
-}
\ No newline at end of file
+}
+
+int lch::BacktraceRaw(void** frames, int size, int skip) {
+    if (size <= 0) {
+        return 0;
+    }
+    //多取skip层，再把最内层的移走
+    void** buf = (void**)alloca(sizeof(void*) * (size + skip));
+    int n = ::backtrace(buf, size + skip);
+    if (n <= skip) {
+        return 0;
+    }
+    n -= skip;
+    memcpy(frames, buf + skip, sizeof(void*) * n);
+    return n;
+}
+
+//缓存的地址个数上限，超出后不再缓存，避免JIT或者大量dlopen的模块让缓存无限增长
+static const size_t s_symbol_cache_size = 4096;
+
+static std::string DoSymbolize(void* addr) {
+    std::stringstream ss;
+    Dl_info info;
+    if (dladdr(addr, &info) && info.dli_sname) {
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(info.dli_sname, nullptr, nullptr, &status);
+        ss << (status == 0 && demangled ? demangled : info.dli_sname)
+           << "+0x" << std::hex << ((uintptr_t)addr - (uintptr_t)info.dli_saddr)
+           << " (" << (info.dli_fname ? info.dli_fname : "?") << ")";
+        free(demangled);
+        return ss.str();
+    }
+    //static函数等动态符号表里没有的，用backtrace_symbols给出模块和偏移
+    char** strings = backtrace_symbols(&addr, 1);
+    if (strings) {
+        ss << strings[0];
+        free(strings);
+    } else {
+        ss << addr;
+    }
+    return ss.str();
+}
+
+std::string lch::Symbolize(void* addr) {
+    static RWMutex* s_mutex = new RWMutex;
+    static std::unordered_map<void*, std::string>* s_cache = new std::unordered_map<void*, std::string>;
+    {
+        RWMutex::ReadLock lock(*s_mutex);
+        auto it = s_cache->find(addr);
+        if (it != s_cache->end()) {
+            return it->second;
+        }
+    }
+    std::string sym = DoSymbolize(addr);
+    RWMutex::WriteLock lock(*s_mutex);
+    if (s_cache->size() < s_symbol_cache_size) {
+        s_cache->insert(std::make_pair(addr, sym));
+    }
+    return sym;
+}
+
+void lch::Backtrace(std::vector<std::string>& bt, int size, int skip) {
+    void** frames = (void**)alloca(sizeof(void*) * (size > 0 ? size : 1));
+    //再跳过BacktraceRaw自己
+    int n = BacktraceRaw(frames, size, skip + 1);
+    for (int i = 0; i < n; ++i) {
+        bt.push_back(Symbolize(frames[i]));
+    }
+}
+
+std::string lch::BacktraceToString(int size, int skip, const std::string& prefix) {
+    std::vector<std::string> bt;
+    Backtrace(bt, size, skip);
+    std::stringstream ss;
+    for (size_t i = 0; i < bt.size(); ++i) {
+        ss << prefix << bt[i] << std::endl;
+    }
+    return ss.str();
+}
+
+namespace lch {
+
+uint64_t GetMonotonicNS() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+//第一次调用时记下，静态初始化阶段的日志也能用
+static uint64_t GetStartNS() {
+    static uint64_t s_start = GetMonotonicNS();
+    return s_start;
+}
+struct ClockIniter {
+    ClockIniter() { GetStartNS(); }
+};
+static ClockIniter __clock_init;
+
+uint64_t GetElapsedMS() {
+    return (GetMonotonicNS() - GetStartNS()) / 1000000;
+}
+
+void GetRealTime(struct timespec& ts) {
+    clock_gettime(CLOCK_REALTIME, &ts);
+}
+
+void GetCoarseRealTime(struct timespec& ts) {
+    clock_gettime(CLOCK_REALTIME_COARSE, &ts);
+}
+
+uint64_t GetCurrentMS() {
+    struct timespec ts;
+    GetCoarseRealTime(ts);
+    return ts.tv_sec * 1000ull + ts.tv_nsec / 1000000;
+}
+
+uint64_t GetCurrentUS() {
+    struct timespec ts;
+    GetRealTime(ts);
+    return ts.tv_sec * 1000000ull + ts.tv_nsec / 1000;
+}
+
+/*******************************TscClock*********************************/
+namespace {
+
+struct TscCalibration {
+    bool available = false;
+    //每个周期的纳秒数，定点数(右移32位)
+    uint64_t nsPerCycle = 0;
+
+    TscCalibration() {
+#if defined(__x86_64__)
+        //频率不随变频和休眠变化才能当时钟用
+        FILE* fp = fopen("/proc/cpuinfo", "r");
+        if (!fp) {
+            return;
+        }
+        char line[4096];
+        bool constant = false;
+        bool nonstop = false;
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "flags", 5) == 0) {
+                constant = strstr(line, " constant_tsc") != nullptr;
+                nonstop = strstr(line, " nonstop_tsc") != nullptr;
+                break;
+            }
+        }
+        fclose(fp);
+        if (!constant || !nonstop) {
+            return;
+        }
+        uint64_t ns0 = GetMonotonicNS();
+        uint64_t c0 = __rdtsc();
+        struct timespec req = {0, 10 * 1000 * 1000};
+        nanosleep(&req, nullptr);
+        uint64_t ns1 = GetMonotonicNS();
+        uint64_t c1 = __rdtsc();
+        if (c1 <= c0 || ns1 <= ns0) {
+            return;
+        }
+        nsPerCycle = (uint64_t)(((double)(ns1 - ns0) / (c1 - c0)) * (1ull << 32));
+        available = nsPerCycle > 0;
+#endif
+    }
+};
+
+static TscCalibration& GetTscCalibration() {
+    static TscCalibration s_calibration;
+    return s_calibration;
+}
+
+}
+
+bool TscClock::IsAvailable() {
+    return GetTscCalibration().available;
+}
+
+uint64_t TscClock::Now() {
+#if defined(__x86_64__)
+    if (GetTscCalibration().available) {
+        return __rdtsc();
+    }
+#endif
+    return GetMonotonicNS();
+}
+
+uint64_t TscClock::ToNS(uint64_t cycles) {
+#if defined(__x86_64__)
+    const TscCalibration& c = GetTscCalibration();
+    if (c.available) {
+        return (uint64_t)(((unsigned __int128)cycles * c.nsPerCycle) >> 32);
+    }
+#endif
+    return cycles;
+}
+
+}
@@ -7,14 +7,54 @@
 #include <sys/syscall.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <time.h>
+#include <vector>
+#include <string>
 
 namespace lch {
 
+//线程id，第一次调用时取一次后缓存在线程本地变量里
 pid_t GetThreadId();
 
 uint32_t GetFiberId();
 
+//调用栈 需要链接时加-rdynamic才能解析出非static函数的名字
+//只取返回地址，不解析符号，返回取到的层数，skip为跳过的最内层层数(1跳过自己)
+int BacktraceRaw(void** frames, int size, int skip = 1);
+//把地址解析成 "函数名+偏移 (模块)"，C++符号会被demangle，结果按地址缓存
+std::string Symbolize(void* addr);
+//取调用栈并解析成字符串，重复出现的地址直接用缓存
+void Backtrace(std::vector<std::string>& bt, int size = 64, int skip = 1);
+std::string BacktraceToString(int size = 64, int skip = 2, const std::string& prefix = "");
+
+//时钟 日志、定时器、统计都从这里取时间，不要各自调用time()/gettimeofday()
+//clock_gettime走vDSO，不陷入内核
+
+//单调时钟，纳秒
+uint64_t GetMonotonicNS();
+//进程启动以来经过的毫秒数
+uint64_t GetElapsedMS();
+//墙上时间，精确到纳秒
+void GetRealTime(struct timespec& ts);
+//粗粒度墙上时间，精度为一个内核tick(1~4ms)，只读一次内核共享页
+void GetCoarseRealTime(struct timespec& ts);
+//粗粒度的当前时间，毫秒
+uint64_t GetCurrentMS();
+//当前时间，微秒
+uint64_t GetCurrentUS();
+
+//基于TSC的高精度计时器，第一次使用时用单调时钟校准(约10ms)
+//CPU不支持constant_tsc或者不是x86_64时退化为GetMonotonicNS
+class TscClock {
+public:
+    static bool IsAvailable();
+    //时钟周期数，只能用来计算时间差
+    static uint64_t Now();
+    static uint64_t ToNS(uint64_t cycles);
+    static uint64_t NowNS() { return ToNS(Now()); }
+};
+
 }
 
 
-#endif // !__LCH_UTIL_H__
\ No newline at end of file
+#endif // !__LCH_UTIL_H__
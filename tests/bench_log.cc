@@ -0,0 +1,204 @@
+#include "lch/lch.h"
+#include <algorithm>
+#include <chrono>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+//日志性能测试 输出ns/event、events/sec和单条日志的p50/p99/p999延迟
+//用法: bench_log [-n 每个线程的条数] [-t 最大线程数] [-o 结果文件]
+//结果以JSON数组写入结果文件(默认bench_log.json)，表格输出到stderr
+
+static const char* s_dir = "./bench_log_data";
+
+struct BenchResult {
+    std::string name;
+    std::string pattern;
+    int threads = 0;
+    uint64_t events = 0;
+    double nsPerEvent = 0;
+    double eventsPerSec = 0;
+    uint64_t p50 = 0;
+    uint64_t p99 = 0;
+    uint64_t p999 = 0;
+};
+
+//每个场景创建自己的Logger和Appender，Appender为空表示测试被级别过滤掉的日志
+struct BenchCase {
+    std::string name;
+    std::function<lch::LogAppender::ptr()> appender;
+    std::function<void(lch::Logger::ptr)> setup;
+};
+
+//与LCH_LOG_INFO的展开相同，只是调用点由每次run提供：
+//LogCallSite只缓存第一次遇到的Logger，所有场景共用一个静态调用点时只有第一个场景走缓存
+static void log_one(lch::LogCallSite& site, const lch::Logger::ptr& logger, int i) {
+    if (lch::LogCallSite* lch_log_site = site.check(logger, lch::LogLevel::INFO))
+        lch::LogEventWrap(lch::LogEvent::Create(logger, lch::LogLevel::INFO, __FILE__, __LINE__
+                    , lch::GetElapsedMS(), lch::GetThreadId(), lch::GetFiberId(), lch_log_site)).getSS()
+            << "bench log message i=" << i << " value=" << 3.14 << " name=" << "lch";
+}
+
+static uint64_t percentile(const std::vector<uint64_t>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t idx = std::min(sorted.size() - 1, (size_t)(sorted.size() * p));
+    return sorted[idx];
+}
+
+static BenchResult run(const BenchCase& c, const std::string& pattern, int threads, int events) {
+    lch::Logger::ptr logger(new lch::Logger("bench_" + c.name));
+    logger->setFormatter(pattern);
+    lch::LogAppender::ptr appender = c.appender ? c.appender() : nullptr;
+    if (appender) {
+        logger->addAppender(appender);
+    }
+    if (c.setup) {
+        c.setup(logger);
+    }
+
+    //每次run都是新的Logger，各用一个调用点，所有线程共用
+    lch::LogCallSite site;
+    std::vector<std::vector<uint64_t> > latency(threads);
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<lch::Thread::ptr> thrs;
+    for (int t = 0; t < threads; ++t) {
+        std::vector<uint64_t>& lat = latency[t];
+        lat.reserve(events);
+        thrs.push_back(lch::Thread::ptr(new lch::Thread([&lat, &ready, &go, &logger, &site, events]() {
+            ++ready;
+            while (!go) {
+                sched_yield();
+            }
+            for (int i = 0; i < events; ++i) {
+                auto begin = std::chrono::steady_clock::now();
+                log_one(site, logger, i);
+                auto end = std::chrono::steady_clock::now();
+                lat.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+            }
+        }, "bench_" + std::to_string(t))));
+    }
+    while (ready != threads) {
+        sched_yield();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    go = true;
+    for (auto& i : thrs) {
+        i->join();
+    }
+    //异步和二进制模式要等数据真正写出去
+    logger->stopAsync();
+    logger->stopBinary();
+    auto end = std::chrono::steady_clock::now();
+
+    std::vector<uint64_t> all;
+    all.reserve((size_t)threads * events);
+    for (auto& i : latency) {
+        all.insert(all.end(), i.begin(), i.end());
+    }
+    std::sort(all.begin(), all.end());
+
+    BenchResult r;
+    r.name = c.name;
+    r.pattern = pattern;
+    r.threads = threads;
+    r.events = all.size();
+    double total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count();
+    r.nsPerEvent = total_ns / r.events;
+    r.eventsPerSec = r.events / (total_ns / 1e9);
+    r.p50 = percentile(all, 0.5);
+    r.p99 = percentile(all, 0.99);
+    r.p999 = percentile(all, 0.999);
+    return r;
+}
+
+static std::string to_json(const std::vector<BenchResult>& results) {
+    std::stringstream ss;
+    ss << "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const BenchResult& r = results[i];
+        char buf[512];
+        snprintf(buf, sizeof(buf), "  {\"name\": \"%s\", \"pattern\": \"%s\", \"threads\": %d, \"events\": %lu"
+                ", \"ns_per_event\": %.1f, \"events_per_sec\": %.0f"
+                ", \"p50_ns\": %lu, \"p99_ns\": %lu, \"p999_ns\": %lu}%s\n"
+                , r.name.c_str(), r.pattern.c_str(), r.threads, (unsigned long)r.events
+                , r.nsPerEvent, r.eventsPerSec, (unsigned long)r.p50, (unsigned long)r.p99
+                , (unsigned long)r.p999, i + 1 < results.size() ? "," : "");
+        ss << buf;
+    }
+    ss << "]";
+    return ss.str();
+}
+
+int main(int argc, char** argv) {
+    int events = 100000;
+    int max_threads = 4;
+    std::string out_file = "bench_log.json";
+    int opt;
+    while ((opt = getopt(argc, argv, "n:t:o:")) != -1) {
+        switch (opt) {
+            case 'n': events = atoi(optarg); break;
+            case 't': max_threads = atoi(optarg); break;
+            case 'o': out_file = optarg; break;
+            default:
+                std::cerr << "usage: " << argv[0] << " [-n events] [-t threads] [-o file]" << std::endl;
+                return 1;
+        }
+    }
+
+    //StdoutLogAppender的输出丢进/dev/null
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, STDOUT_FILENO);
+    close(null_fd);
+    mkdir(s_dir, 0755);
+    std::string dir = s_dir;
+
+    std::vector<BenchCase> cases = {
+        {"disabled", nullptr, [](lch::Logger::ptr l) { l->setLevel(lch::LogLevel::ERROR); }},
+        {"stdout", []() { return lch::LogAppender::ptr(new lch::StdoutLogAppender); }, nullptr},
+        {"file", [dir]() { return lch::LogAppender::ptr(new lch::FileLogAppender(dir + "/file.log")); }, nullptr},
+        //同一个格式器的两个appender只格式化一次
+        {"file_stdout", [dir]() { return lch::LogAppender::ptr(new lch::FileLogAppender(dir + "/fan_out.log")); }
+            , [](lch::Logger::ptr l) { l->addAppender(lch::LogAppender::ptr(new lch::StdoutLogAppender)); }},
+        {"rotating_file", [dir]() { return lch::LogAppender::ptr(new lch::RotatingFileLogAppender(
+                dir + "/rotate.log", 64 * 1024 * 1024, lch::RotatingFileLogAppender::NONE, 2)); }, nullptr},
+        {"mmap_file", [dir]() { return lch::LogAppender::ptr(new lch::MmapFileLogAppender(dir + "/mmap.log")); }, nullptr},
+        {"uring_file", [dir]() { return lch::LogAppender::ptr(new lch::UringFileLogAppender(dir + "/uring.log")); }, nullptr},
+        {"async_file", [dir]() { return lch::LogAppender::ptr(new lch::FileLogAppender(dir + "/async.log")); }
+            , [](lch::Logger::ptr l) { l->startAsync(); }},
+        {"binary", nullptr, [dir](lch::Logger::ptr l) { l->startBinary(dir + "/binary.bin"); }}
+    };
+    std::vector<std::string> patterns = {
+        "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n",
+        "%m%n",
+        "%d{%H:%M:%S.%6} %p %c %m%n"
+    };
+
+    std::vector<BenchResult> results;
+    fprintf(stderr, "%-14s %-8s %8s %12s %14s %8s %8s %8s\n"
+            , "case", "pattern", "threads", "ns/event", "events/sec", "p50", "p99", "p999");
+    for (auto& c : cases) {
+        //被过滤掉的日志与格式无关，只跑一种
+        size_t npatterns = c.name == "disabled" ? 1 : patterns.size();
+        for (size_t p = 0; p < npatterns; ++p) {
+            for (int t = 1; t <= max_threads; t *= 2) {
+                BenchResult r = run(c, patterns[p], t, events);
+                fprintf(stderr, "%-14s %-8zu %8d %12.1f %14.0f %8lu %8lu %8lu\n", r.name.c_str(), p
+                        , r.threads, r.nsPerEvent, r.eventsPerSec
+                        , (unsigned long)r.p50, (unsigned long)r.p99, (unsigned long)r.p999);
+                results.push_back(r);
+            }
+        }
+    }
+
+    std::ofstream ofs(out_file);
+    ofs << to_json(results) << std::endl;
+    if (!ofs) {
+        std::cerr << "write " << out_file << " failed" << std::endl;
+        return 1;
+    }
+    std::cerr << "results written to " << out_file << std::endl;
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "lch/lch.h"
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("async");
+
+void producer() {
+    for (int i = 0; i < 10000; ++i) {
+        LCH_LOG_INFO(g_logger) << "async log " << lch::Thread::GetName() << " i=" << i;
+    }
+}
+
+int main(int argc, char** argv) {
+    lch::FileLogAppender::ptr file_appender(new lch::FileLogAppender("./async_log.txt"));
+    g_logger->addAppender(file_appender);
+    g_logger->startAsync(1024, lch::AsyncLogDispatcher::BLOCK);
+
+    std::vector<lch::Thread::ptr> thrs;
+    for (int i = 0; i < 4; ++i) {
+        thrs.push_back(lch::Thread::ptr(new lch::Thread(&producer, "producer_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    g_logger->stopAsync();
+
+    //丢弃模式下队列满时不阻塞，由后台线程报告丢弃条数
+    g_logger->startAsync(16, lch::AsyncLogDispatcher::DROP_COUNT);
+    auto async = g_logger->getAsync();
+    producer();
+    g_logger->stopAsync();
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "dropped=" << async->getDropped();
+
+    YAML::Node root = YAML::Load("logs:\n"
+                                 "    - name: async_yaml\n"
+                                 "      level: info\n"
+                                 "      async: true\n"
+                                 "      queue_size: 256\n"
+                                 "      overflow: drop_newest\n"
+                                 "      appenders:\n"
+                                 "          - type: StdoutLogAppender\n");
+    lch::Config::LoadYamlFile(root);
+    auto l = LCH_LOG_NAME("async_yaml");
+    LCH_LOG_INFO(l) << "async from yaml, isAsync=" << l->isAsync();
+    std::cout << lch::LoggerMgr::GetInstance()->toYamlString() << std::endl;
+    return 0;
+}
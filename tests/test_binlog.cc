@@ -0,0 +1,77 @@
+#include "lch/lch.h"
+#include <fstream>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("binlog");
+
+//写入二进制日志后读回来，检查还原出的文本与直接格式化一致
+int main(int argc, char** argv) {
+    const char* file = "./binlog_test.bin";
+    lch::Thread::SetName("binlog_main");
+    unlink(file);
+    if (!g_logger->startBinary(file)) {
+        std::cout << "open " << file << " failed" << std::endl;
+        return 1;
+    }
+
+    std::string name("lch");
+    const int count = argc > 1 ? atoi(argv[1]) : 1000;
+    std::vector<std::string> expect;
+    for (int i = 0; i < count; ++i) {
+        LCH_LOG_FMT_INFO(g_logger, "i=%d u=%lu d=%.3f s=%s c=%c %5s|%-4d|%x|%.2s", i
+                , (unsigned long)i * 3, i / 7.0, name.c_str(), 'a' + i % 26, "ab", i % 100, i, name.c_str());
+        char buf[256];
+        snprintf(buf, sizeof(buf), "i=%d u=%lu d=%.3f s=%s c=%c %5s|%-4d|%x|%.2s", i
+                , (unsigned long)i * 3, i / 7.0, name.c_str(), 'a' + i % 26, "ab", i % 100, i, name.c_str());
+        expect.push_back(buf);
+        LCH_LOG_WARN(g_logger) << "stream " << i << " " << name;
+        expect.push_back("stream " + std::to_string(i) + " " + name);
+    }
+    LCH_LOG_FMT_ERROR(g_logger, "string=%s width=%*d", name, 6, 42);
+    expect.push_back("string=lch width=    42");
+    g_logger->stopBinary();
+
+    std::ifstream in(file, std::ios::binary);
+    lch::BinLogReader reader(in);
+    lch::LogEvent::ptr event;
+    size_t n = 0;
+    int rt = 0;
+    while (reader.next(event)) {
+        std::string content(event->getContentData(), event->getContentSize());
+        if (n >= expect.size() || content != expect[n]
+                || event->getThreadName() != lch::Thread::GetName()) {
+            std::cout << "mismatch at " << n << ": " << content << std::endl;
+            rt = 1;
+            break;
+        }
+        ++n;
+    }
+    if (reader.isError() || n != expect.size()) {
+        std::cout << "decoded " << n << " of " << expect.size() << " events" << std::endl;
+        rt = 1;
+    }
+    //文本模式下std::string参数的结果与二进制模式相同
+    {
+        lch::Logger::ptr text(new lch::Logger("binlog.text"));
+        lch::LogEventWrap wrap(lch::LogEvent::Create(text, lch::LogLevel::ERROR, __FILE__, __LINE__, 0, 0, 0));
+        wrap.format("string=%s width=%*d", name, 6, 42);
+        if (wrap.getEvent()->getContent() != "string=lch width=    42") {
+            std::cout << "text format: " << wrap.getEvent()->getContent() << std::endl;
+            rt = 1;
+        }
+    }
+    //解码到定长缓冲区时按缓冲区大小截断
+    {
+        lch::LogStream os;
+        lch::BinLogArgs::Encode(os, 12345, name, 2.5);
+        char buf[12];
+        size_t len = lch::BinLogArgs::Decode("n=%d s=%s d=%.1f", os.data(), os.size(), buf, sizeof(buf));
+        if (std::string(buf, len) != "n=12345 s=lc") {
+            std::cout << "buffer decode: " << std::string(buf, len) << std::endl;
+            rt = 1;
+        }
+    }
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "binlog decoded " << n << " events, "
+        << (rt ? "failed" : "ok");
+    return rt;
+}
@@ -0,0 +1,185 @@
+#include "test_helper.h"
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("compress");
+
+//读出所有完好的块，返回解压后的内容
+static std::string read_all(const std::string& file, uint64_t& blocks, uint64_t& skipped, bool& truncated) {
+    lch::CompressedLogReader reader(file);
+    lch::CompressedLogBlock block;
+    uint64_t offset = 0;
+    std::string out;
+    blocks = 0;
+    while (reader.next(block, offset)) {
+        if (reader.read(out)) {
+            ++blocks;
+        }
+    }
+    skipped = reader.getSkipped();
+    truncated = reader.isTruncated();
+    return out;
+}
+
+static void copy_file(const std::string& from, const std::string& to, size_t len) {
+    std::ifstream in(from, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    std::ofstream out(to, std::ios::binary | std::ios::trunc);
+    out.write(data.data(), std::min(len, data.size()));
+}
+
+static off_t file_size(const std::string& file) {
+    struct stat st;
+    return stat(file.c_str(), &st) == 0 ? st.st_size : 0;
+}
+
+//多个线程写，块很小，按顺序读回
+static int test_threads(const std::string& file) {
+    unlink(file.c_str());
+    const int threads = 4;
+    const int count = 20000;
+    uint64_t raw = 0;
+    uint64_t compressed = 0;
+    {
+        lch::CompressedFileLogAppender::ptr appender(new lch::CompressedFileLogAppender(file
+                    , lch::CompressedLog::ZLIB, -1, 16 * 1024, 1000, 2));
+        lch::Logger::ptr logger = make_logger("compress.threads", appender);
+        std::vector<lch::Thread::ptr> ths;
+        for (int t = 0; t < threads; ++t) {
+            ths.push_back(lch::Thread::ptr(new lch::Thread([logger]() {
+                for (int i = 0; i < count; ++i) {
+                    LCH_LOG_INFO(logger) << "compressed line " << i;
+                }
+            }, "compress_" + std::to_string(t))));
+        }
+        for (auto& t : ths) {
+            t->join();
+        }
+        appender->flush();
+        raw = appender->getRawBytes();
+        compressed = appender->getCompressedBytes();
+    }
+    uint64_t blocks = 0;
+    uint64_t skipped = 0;
+    bool truncated = false;
+    std::vector<std::string> lines = split_lines(read_all(file, blocks, skipped, truncated));
+    std::map<std::string, int> next;
+    for (auto& line : lines) {
+        size_t sp = line.find(' ');
+        std::string tid = line.substr(0, sp);
+        if (line.substr(sp + 1) != "compressed line " + std::to_string(next[tid]++)) {
+            std::cout << "bad line: " << line << std::endl;
+            return 1;
+        }
+    }
+    if (lines.size() != (size_t)threads * count || next.size() != (size_t)threads
+            || skipped || truncated || blocks < 10) {
+        std::cout << "lines " << lines.size() << " blocks " << blocks << std::endl;
+        return 1;
+    }
+    if (compressed == 0 || compressed * 3 > raw || (off_t)compressed != file_size(file)) {
+        std::cout << "raw " << raw << " compressed " << compressed << " file " << file_size(file) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//损坏的块跳过，后面的块照常读；最后没写完的块忽略
+static int test_recover(const std::string& file) {
+    uint64_t blocks = 0;
+    uint64_t skipped = 0;
+    bool truncated = false;
+    size_t total = split_lines(read_all(file, blocks, skipped, truncated)).size();
+
+    //改掉第一块压缩数据中的一个字节
+    std::string broken = file + ".broken";
+    copy_file(file, broken, (size_t)-1);
+    {
+        std::fstream f(broken, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(sizeof(lch::CompressedLogBlock) + 10);
+        f.put('\xff');
+    }
+    uint64_t broken_blocks = 0;
+    std::vector<std::string> lines = split_lines(read_all(broken, broken_blocks, skipped, truncated));
+    if (broken_blocks != blocks - 1 || skipped == 0 || truncated || lines.size() >= total) {
+        std::cout << "broken blocks " << broken_blocks << " of " << blocks << " skipped " << skipped << std::endl;
+        return 1;
+    }
+
+    //最后一块只写了一半
+    copy_file(file, broken, file_size(file) - 20);
+    lines = split_lines(read_all(broken, broken_blocks, skipped, truncated));
+    if (broken_blocks != blocks - 1 || skipped || !truncated) {
+        std::cout << "truncated blocks " << broken_blocks << " of " << blocks << std::endl;
+        return 1;
+    }
+    unlink(broken.c_str());
+    return 0;
+}
+
+//没写满的块按flush_interval写出，reopen后写新文件
+static int test_flush_reopen(const std::string& file) {
+    unlink(file.c_str());
+    lch::CompressedFileLogAppender::ptr appender(new lch::CompressedFileLogAppender(file
+                , lch::CompressedLog::ZLIB, 9, 64 * 1024, 20));
+    lch::Logger::ptr logger = make_logger("compress.flush", appender);
+    LCH_LOG_INFO(logger) << "timed";
+    for (int i = 0; i < 100 && appender->getBlocks() == 0; ++i) {
+        usleep(10 * 1000);
+    }
+    uint64_t blocks = 0;
+    uint64_t skipped = 0;
+    bool truncated = false;
+    std::string content = read_all(file, blocks, skipped, truncated);
+    if (blocks != 1 || content.find("timed") == std::string::npos) {
+        std::cout << "timed flush blocks " << blocks << std::endl;
+        return 1;
+    }
+
+    std::string moved = file + ".1";
+    rename(file.c_str(), moved.c_str());
+    if (!appender->reopen()) {
+        std::cout << "reopen failed" << std::endl;
+        return 1;
+    }
+    LCH_LOG_INFO(logger) << "reopened";
+    appender->flush();
+    content = read_all(file, blocks, skipped, truncated);
+    if (blocks != 1 || content.find("reopened") == std::string::npos) {
+        std::cout << "reopen blocks " << blocks << std::endl;
+        return 1;
+    }
+    unlink(file.c_str());
+    unlink(moved.c_str());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string file = "/tmp/test_compress_log.lcz";
+    int rt = 0;
+    rt |= test_threads(file);
+    if (rt == 0) {
+        rt |= test_recover(file);
+    }
+    rt |= test_flush_reopen(file);
+
+    //没有编译进来的算法退回zlib
+    for (auto c : {lch::CompressedLog::ZSTD, lch::CompressedLog::LZ4}) {
+        lch::CompressedFileLogAppender appender(file, c);
+        if (appender.getCodec() != (lch::CompressedLog::IsSupported(c) ? c : lch::CompressedLog::ZLIB)) {
+            std::cout << "codec " << lch::CompressedLog::ToString(c) << " fallback failed" << std::endl;
+            rt = 1;
+        }
+    }
+    if (lch::CompressedLog::FromString("lz4") != lch::CompressedLog::LZ4
+            || std::string(lch::CompressedLog::ToString(lch::CompressedLog::NONE)) != "none") {
+        std::cout << "codec string failed" << std::endl;
+        rt = 1;
+    }
+    unlink(file.c_str());
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_compress_log ok";
+    }
+    return rt;
+}
@@ -0,0 +1,85 @@
+#include "test_helper.h"
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("console");
+
+//读出管道里现有的全部数据
+static std::string drain(int fd) {
+    std::string data;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        data.append(buf, n);
+    }
+    return data;
+}
+
+static int count_lines(const std::string& data) {
+    return std::count(data.begin(), data.end(), '\n');
+}
+
+int main(int argc, char** argv) {
+    int fds[2];
+    if (pipe(fds)) {
+        std::cout << "pipe failed" << std::endl;
+        return 1;
+    }
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    int rt = 0;
+
+    //管道不是终端，AUTO解析为块缓冲
+    lch::ConsoleLogAppender::ptr appender(new lch::ConsoleLogAppender(fds[1]
+                , lch::ConsoleLogAppender::AUTO, 4096, 200));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    g_logger->addAppender(appender);
+    rt |= check("line_buffered", appender->isLineBuffered(), 0);
+
+    for (int i = 0; i < 10; ++i) {
+        LCH_LOG_INFO(g_logger) << "block i=" << i;
+    }
+    rt |= check("buffered", count_lines(drain(fds[0])), 0);
+
+    //ERROR强制刷新，连同之前缓冲的一起写出
+    LCH_LOG_ERROR(g_logger) << "error";
+    rt |= check("error_flush", count_lines(drain(fds[0])), 11);
+
+    //超过缓冲区大小直接写出
+    std::string big(100, 'x');
+    for (int i = 0; i < 100; ++i) {
+        LCH_LOG_INFO(g_logger) << big;
+    }
+    int written = count_lines(drain(fds[0]));
+    appender->flush();
+    rt |= check("size_flush", written > 0 && written < 100, 1);
+    rt |= check("size_total", written + count_lines(drain(fds[0])), 100);
+
+    //按时间刷新
+    LCH_LOG_INFO(g_logger) << "interval";
+    usleep(500 * 1000);
+    rt |= check("interval_flush", count_lines(drain(fds[0])), 1);
+
+    //行缓冲每条都写出
+    g_logger->clearAppender();
+    appender.reset(new lch::ConsoleLogAppender(fds[1], lch::ConsoleLogAppender::LINE));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    g_logger->addAppender(appender);
+    LCH_LOG_INFO(g_logger) << "line";
+    rt |= check("line_flush", count_lines(drain(fds[0])), 1);
+
+    //析构时写出剩下的数据
+    g_logger->clearAppender();
+    appender.reset(new lch::ConsoleLogAppender(fds[1], lch::ConsoleLogAppender::BLOCK, 4096, 0));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    g_logger->addAppender(appender);
+    LCH_LOG_INFO(g_logger) << "destroy";
+    rt |= check("before_destroy", count_lines(drain(fds[0])), 0);
+    g_logger->clearAppender();
+    appender.reset();
+    lch::Rcu::Synchronize();
+    rt |= check("after_destroy", count_lines(drain(fds[0])), 1);
+
+    std::cout << (rt ? "test_console_log failed" : "test_console_log ok") << std::endl;
+    return rt;
+}
@@ -0,0 +1,77 @@
+#include "test_helper.h"
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("flight");
+
+static int count_match(const std::vector<std::string>& lines, const std::string& sub) {
+    int n = 0;
+    for (auto& i : lines) {
+        if (i.find(sub) != std::string::npos) {
+            ++n;
+        }
+    }
+    return n;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    std::string file = "flight_recorder.log";
+    unlink(file.c_str());
+    g_logger->setLevel(lch::LogLevel::INFO);
+
+    //关闭时DEBUG日志不生成事件
+    rt |= check("enabled_before", LCH_LOG_ENABLED(g_logger, lch::LogLevel::DEBUG), 0);
+    lch::FlightRecorder::Enable(file, 16);
+    rt |= check("enabled_after", LCH_LOG_ENABLED(g_logger, lch::LogLevel::DEBUG), 1);
+
+    for (int i = 0; i < 40; ++i) {
+        LCH_LOG_DEBUG(g_logger) << "debug i=" << i;
+    }
+    LCH_LOG_INFO(g_logger) << "info";
+    rt |= check("dump", lch::FlightRecorder::Dump(), 16);
+    auto lines = read_lines(file);
+    //只保留最近的16条
+    rt |= check("debug_lines", count_match(lines, "[DEBUG]"), 15);
+    rt |= check("oldest_dropped", count_match(lines, "debug i=24"), 0);
+    rt |= check("newest_kept", count_match(lines, "debug i=39"), 1);
+    rt |= check("info_lines", count_match(lines, "[INFO] [flight]"), 1);
+
+    //其他线程的记录分开输出
+    lch::Thread::ptr thr(new lch::Thread([]() {
+        LCH_LOG_DEBUG(g_logger) << "from worker";
+    }, "fr_worker"));
+    thr->join();
+
+    //FATAL时自动写文件
+    unlink(file.c_str());
+    LCH_LOG_FATAL(g_logger) << "fatal";
+    lines = read_lines(file);
+    rt |= check("fatal_dump", count_match(lines, "[FATAL] [flight]"), 1);
+    rt |= check("worker_title", count_match(lines, " fr_worker ----"), 1);
+    rt |= check("worker_lines", count_match(lines, "from worker"), 1);
+
+    //崩溃时由信号处理函数写文件，之后进程仍然按原信号退出
+    std::string crash_file = "flight_recorder_crash.log";
+    unlink(crash_file.c_str());
+    pid_t pid = fork();
+    if (pid == 0) {
+        lch::FlightRecorder::Enable(crash_file, 16);
+        LCH_LOG_DEBUG(g_logger) << "before crash";
+        volatile int* p = nullptr;
+        *p = 1;
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    rt |= check("crash_signal", WIFSIGNALED(status) ? WTERMSIG(status) : 0, SIGSEGV);
+    lines = read_lines(crash_file);
+    rt |= check("crash_dump", count_match(lines, "before crash"), 1);
+
+    lch::FlightRecorder::Disable();
+    rt |= check("enabled_disable", LCH_LOG_ENABLED(g_logger, lch::LogLevel::DEBUG), 0);
+
+    std::cout << (rt ? "test_flight_recorder failed" : "test_flight_recorder ok") << std::endl;
+    return rt;
+}
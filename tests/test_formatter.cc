@@ -0,0 +1,172 @@
+#include "lch/lch.h"
+#include <chrono>
+#include <unistd.h>
+
+static const char* s_patterns[] = {
+    "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n",
+    "%d%T%p%T%m%n",
+    "%m %p %r %c %t %N %n %d %f %l %T %F %%",
+    "[%p] %c - %m%n",
+    "%d{%Y-%m-%d %H:%M:%S.%3}%T%d{%H:%M:%S.%6}%T%d{%S.%9 %%}%T%m%n"
+};
+
+//记录收到的格式化结果和它的地址，地址相同说明多个appender共用了一次格式化
+class TextAppender : public lch::LogAppender {
+public:
+    typedef std::shared_ptr<TextAppender> ptr;
+    TextAppender() : lch::LogAppender(true) {}
+    void log(std::shared_ptr<lch::Logger> logger, lch::LogLevel::Level level, lch::LogEvent::ptr event) override {
+        addr = nullptr;
+        text = formatter()->format(logger, level, event);
+    }
+    void logFormatted(const std::shared_ptr<lch::Logger>& logger, lch::LogLevel::Level level
+                      , const lch::LogEvent::ptr& event, const std::string& t) override {
+        addr = &t;
+        text = t;
+    }
+    std::string toYamlString() override { return ""; }
+
+    const std::string* addr = nullptr;
+    std::string text;
+};
+
+static int check_fan_out() {
+    lch::Logger::ptr logger(new lch::Logger("fan_out"));
+    logger->setFormatter("%p %m%n");
+    TextAppender::ptr a(new TextAppender), b(new TextAppender), c(new TextAppender);
+    c->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    logger->addAppender(a);
+    logger->addAppender(b);
+    logger->addAppender(c);
+    LCH_LOG_INFO(logger) << "fan out";
+    int rt = 0;
+    if (!a->addr || a->addr != b->addr || a->text != "INFO fan out\n" || b->text != a->text) {
+        std::cout << "shared format mismatch: " << a->text << b->text << std::endl;
+        rt = 1;
+    }
+    if (!c->addr || c->addr == a->addr || c->text != "fan out\n") {
+        std::cout << "own format mismatch: " << c->text << std::endl;
+        rt = 1;
+    }
+    //级别被过滤掉的appender不格式化也不输出
+    b->setLevel(lch::LogLevel::ERROR);
+    b->text.clear();
+    LCH_LOG_WARN(logger) << "warn";
+    if (!b->text.empty() || a->text != "WARN warn\n") {
+        std::cout << "appender level mismatch: " << b->text << std::endl;
+        rt = 1;
+    }
+    return rt;
+}
+
+//改写前(基线版本)的格式化结果，编译后和ostream两种输出都要和它一致
+static const char* s_golden[][2] = {
+    {"%d{%Y-%m-%d %H:%M:%S}%T%t%T%N%T%F%T[%p]%T[%c]%T%f:%l%T%m%n",
+     "2023-11-14 22:13:20\t1234\tgolden_th\t5\t[WARN]\t[golden]\tgolden.cc:42\thello golden 42 3.14\n"},
+    {"%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n",
+     "2023-11-14 22:13:20\t1234\t5\t[WARN]\t[golden]\tgolden.cc:42\thello golden 42 3.14\n"},
+    {"%d%T%p%T%m%n", "2023:11:14 22:13:20\tWARN\thello golden 42 3.14\n"},
+    {"%m %p %r %c %t %n %d %f %l %T %F", "hello golden 42 3.14 WARN 12 golden 1234 \n 2023:11:14 22:13:20 golden.cc 42 \t 5"},
+    {"[%p] %c - %m%n", "[WARN] golden - hello golden 42 3.14\n"},
+    {"%d{%H:%M:%S}|%r|%q|%m", "22:13:20|12|<<error_format %q>>|hello golden 42 3.14"}
+};
+
+static int check_golden() {
+    lch::Logger::ptr logger(new lch::Logger("golden"));
+    lch::LogEvent::ptr event(new lch::LogEvent(logger, lch::LogLevel::WARN, "golden.cc", 42, 12,
+                1234, 5, 1700000000, 123456789));
+    event->setThreadName("golden_th");
+    event->getSS() << "hello golden " << 42 << " " << 3.14;
+    int rt = 0;
+    for (auto& i : s_golden) {
+        lch::LogFormatter fmt(i[0]);
+        std::stringstream ss;
+        fmt.format(ss, logger, lch::LogLevel::WARN, event);
+        std::string buf;
+        fmt.format(buf, logger, lch::LogLevel::WARN, event);
+        if (buf != i[1] || ss.str() != i[1]) {
+            std::cout << "golden mismatch pattern=" << i[0] << "\n  expect: " << i[1]
+                      << "\n  ostream: " << ss.str() << "\n  compiled: " << buf << std::endl;
+            rt = 1;
+        }
+    }
+    return rt;
+}
+
+//比较ostream逐项输出与编译后输出是否一致，并统计两种方式的ns/event
+int main(int argc, char** argv) {
+    //golden中的时间按UTC计算
+    setenv("TZ", "UTC", 1);
+    tzset();
+    lch::Logger::ptr logger(new lch::Logger("formatter"));
+    lch::LogEvent::ptr event(new lch::LogEvent(logger, lch::LogLevel::INFO, __FILE__, __LINE__, 12,
+                lch::GetThreadId(), lch::GetFiberId(), time(0), 123456789));
+    event->getSS() << "hello formatter " << 42 << " " << 3.14;
+
+    const int count = argc > 1 ? atoi(argv[1]) : 200000;
+    int rt = check_fan_out();
+    rt |= check_golden();
+
+    std::string sub;
+    lch::LogFormatter("%d{%3|%6|%9}").format(sub, logger, lch::LogLevel::INFO, event);
+    if (sub != "123|123456|123456789") {
+        std::cout << "sub-second mismatch: " << sub << std::endl;
+        rt = 1;
+    }
+    //%r是进程启动以来的毫秒数
+    usleep(20 * 1000);
+    lch::LogEvent::ptr elapse_event = lch::LogEvent::Create(logger, lch::LogLevel::INFO, __FILE__, __LINE__,
+                lch::GetElapsedMS(), lch::GetThreadId(), lch::GetFiberId());
+    std::string elapse;
+    lch::LogFormatter("%r").format(elapse, logger, lch::LogLevel::INFO, elapse_event);
+    if (atoi(elapse.c_str()) < 20) {
+        std::cout << "elapse mismatch: " << elapse << "ms" << std::endl;
+        rt = 1;
+    }
+    //TSC换算的时间和单调时钟大致相符；cpuinfo中没有constant_tsc/nonstop_tsc时
+    //TscClock直接用单调时钟，不用比较。虚拟机和调频会带来误差，放宽到±25%
+    if (lch::TscClock::IsAvailable()) {
+        uint64_t t0 = lch::TscClock::NowNS();
+        uint64_t m0 = lch::GetMonotonicNS();
+        usleep(200 * 1000);
+        uint64_t tsc_ns = lch::TscClock::NowNS() - t0;
+        uint64_t mono_ns = lch::GetMonotonicNS() - m0;
+        std::cout << "tsc_ns=" << tsc_ns << " mono_ns=" << mono_ns << std::endl;
+        if (tsc_ns < mono_ns * 3 / 4 || tsc_ns > mono_ns * 5 / 4) {
+            rt = 1;
+        }
+    }
+
+    for (auto pattern : s_patterns) {
+        lch::LogFormatter::ptr fmt(new lch::LogFormatter(pattern));
+
+        std::stringstream ss;
+        fmt->format(ss, logger, lch::LogLevel::INFO, event);
+        std::string buf;
+        fmt->format(buf, logger, lch::LogLevel::INFO, event);
+        if (ss.str() != buf) {
+            std::cout << "mismatch pattern=" << pattern << "\n  ostream: " << ss.str()
+                      << "\n  compiled: " << buf << std::endl;
+            rt = 1;
+        }
+
+        auto begin = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            std::stringstream os;
+            fmt->format(os, logger, lch::LogLevel::INFO, event);
+            std::string s = os.str();
+        }
+        auto mid = std::chrono::steady_clock::now();
+        for (int i = 0; i < count; ++i) {
+            buf.clear();
+            fmt->format(buf, logger, lch::LogLevel::INFO, event);
+        }
+        auto end = std::chrono::steady_clock::now();
+
+        double ostream_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(mid - begin).count() / (double)count;
+        double compiled_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - mid).count() / (double)count;
+        std::cout << "pattern=\"" << pattern << "\" ostream=" << ostream_ns
+                  << "ns/event compiled=" << compiled_ns << "ns/event" << std::endl;
+    }
+    return rt;
+}
@@ -0,0 +1,91 @@
+#ifndef __LCH_TESTS_TEST_HELPER_H__
+#define __LCH_TESTS_TEST_HELPER_H__
+
+//tests下各个测试共用的小工具
+
+#include "lch/lch.h"
+#include <fstream>
+
+//收集格式化后的每一行
+class LinesAppender : public lch::LogAppender {
+public:
+    typedef std::shared_ptr<LinesAppender> ptr;
+    void log(std::shared_ptr<lch::Logger> logger, lch::LogLevel::Level level, lch::LogEvent::ptr event) override {
+        std::string text = formatter()->format(logger, level, event);
+        lch::Mutex::Lock lock(m_mutex);
+        lines.push_back(text);
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::vector<std::string> getLines() {
+        lch::Mutex::Lock lock(m_mutex);
+        return lines;
+    }
+
+    //取出并清空
+    std::vector<std::string> take() {
+        lch::Mutex::Lock lock(m_mutex);
+        std::vector<std::string> rt;
+        rt.swap(lines);
+        return rt;
+    }
+private:
+    std::vector<std::string> lines;
+};
+
+inline LinesAppender::ptr make_lines(const std::string& pattern) {
+    LinesAppender::ptr lines(new LinesAppender);
+    lines->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter(pattern)));
+    return lines;
+}
+
+//只有appender一个输出的Logger，不经过LoggerManager
+inline lch::Logger::ptr make_logger(const std::string& name, lch::LogAppender::ptr appender
+                                    , const std::string& pattern = "%t %m%n") {
+    lch::Logger::ptr logger(new lch::Logger(name));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter(pattern)));
+    logger->addAppender(appender);
+    return logger;
+}
+
+inline std::vector<std::string> split_lines(const std::string& str) {
+    std::vector<std::string> lines;
+    std::stringstream ss(str);
+    std::string line;
+    while (std::getline(ss, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+inline std::vector<std::string> read_lines(const std::string& file) {
+    std::vector<std::string> lines;
+    std::ifstream in(file);
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    return lines;
+}
+
+//输出数值，和期望不同时返回1
+inline int check(const char* name, int64_t value, int64_t expect) {
+    std::cout << name << " = " << value << std::endl;
+    if (value != expect) {
+        std::cout << name << " expect " << expect << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//字符串和期望不同时输出并返回1
+inline int check(const char* name, const std::string& value, const std::string& expect) {
+    if (value != expect) {
+        std::cout << name << " = " << value << std::endl;
+        std::cout << name << " expect " << expect << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#endif // !__LCH_TESTS_TEST_HELPER_H__
@@ -0,0 +1,106 @@
+#include "test_helper.h"
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("json");
+
+//逐字节转义，用来对照向量化的实现
+static std::string escape_ref(const std::string& str) {
+    std::string out;
+    for (unsigned char c : str) {
+        char tmp[8];
+        switch (c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            case '\b': out += "\\b"; break;
+            case '\f': out += "\\f"; break;
+            default:
+                if (c < 0x20) {
+                    snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+                    out += tmp;
+                } else {
+                    out.push_back(c);
+                }
+        }
+    }
+    return out;
+}
+
+static bool contains(const std::string& str, const std::string& sub) {
+    return str.find(sub) != std::string::npos;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+
+    //特殊字符放在各个位置上，覆盖32/16字节块和剩余部分
+    const char specials[] = {'"', '\\', '\n', '\t', '\x01', '\x1f', '\x7f', (char)0xe4};
+    for (size_t len = 0; len < 80; ++len) {
+        for (size_t pos = 0; pos < len; ++pos) {
+            for (char c : specials) {
+                std::string str(len, 'a');
+                str[pos] = c;
+                std::string out;
+                lch::JsonLogAppender::Escape(out, str.data(), str.size());
+                rt |= check("escape", out, escape_ref(str));
+            }
+        }
+    }
+
+    std::string file = "json_log.json";
+    unlink(file.c_str());
+    lch::JsonLogAppender::ptr appender(new lch::JsonLogAppender(file));
+    g_logger->addAppender(appender);
+
+    //不是LogStream的流直接输出 key=value
+    std::stringstream ss;
+    ss << lch::kv("k", 1);
+    rt |= check("ostream_kv", ss.str(), "k=1");
+
+    LCH_LOG_INFO(g_logger) << "user \"login\"" << lch::kv("user", "bob") << lch::kv("cost_ms", 12)
+        << lch::kv("ok", true) << lch::kv("ratio", 0.5) << lch::kv("bytes", (uint64_t)1 << 40)
+        << lch::kv("path", std::string("C:\\tmp\n"));
+    {
+        lch::LogEventWrap wrap(lch::LogEvent::Create(g_logger, lch::LogLevel::WARN, __FILE__, __LINE__
+                    , 0, lch::GetThreadId(), lch::GetFiberId()));
+        wrap.getEvent()->addField("retry", -3).addField("nan", 0.0 / 0.0);
+        wrap.getSS() << "add field";
+    }
+    g_logger->clearAppender();
+    appender.reset();
+    lch::Rcu::Synchronize();
+
+    std::ifstream in(file);
+    std::vector<std::string> lines;
+    std::string line;
+    while (std::getline(in, line)) {
+        lines.push_back(line);
+    }
+    if (lines.size() != 2) {
+        std::cout << "lines = " << lines.size() << " expect 2" << std::endl;
+        return 1;
+    }
+    std::cout << lines[0] << std::endl << lines[1] << std::endl;
+    const std::string& l0 = lines[0];
+    rt |= !contains(l0, "\"level\":\"INFO\",\"logger\":\"json\"");
+    rt |= !contains(l0, "\"msg\":\"user \\\"login\\\"\"");
+    rt |= !contains(l0, ",\"user\":\"bob\",\"cost_ms\":12,\"ok\":true,\"ratio\":0.5"
+                        ",\"bytes\":1099511627776,\"path\":\"C:\\\\tmp\\n\"}");
+    rt |= !contains(lines[1], "\"level\":\"WARN\"");
+    rt |= !contains(lines[1], "\"msg\":\"add field\",\"retry\":-3,\"nan\":null}");
+
+    //文本格式用%K输出字段
+    lch::LogFormatter::ptr fmt(new lch::LogFormatter("%m %K"));
+    lch::LogEvent::ptr event = lch::LogEvent::Create(g_logger, lch::LogLevel::INFO, __FILE__, __LINE__
+                    , 0, lch::GetThreadId(), lch::GetFiberId());
+    event->getSS() << "text" << lch::kv("a", 1) << lch::kv("b", "x y");
+    rt |= check("text", fmt->format(g_logger, lch::LogLevel::INFO, event), "text a=1 b=x y");
+    std::stringstream os;
+    fmt->format(os, g_logger, lch::LogLevel::INFO, event);
+    rt |= check("text_stream", os.str(), "text a=1 b=x y");
+
+    std::cout << (rt ? "test_json_log failed" : "test_json_log ok") << std::endl;
+    return rt;
+}
@@ -0,0 +1,136 @@
+#include "test_helper.h"
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("dedup");
+
+static lch::Logger::ptr make_dedup(const std::string& name, LinesAppender::ptr& lines, uint32_t timeout) {
+    lines.reset(new LinesAppender);
+    lch::Logger::ptr logger = make_logger(name, lines, "%p %l %m%n");
+    logger->startDedup(timeout);
+    return logger;
+}
+
+//"last message repeated N times"中的N，不是汇总行时返回0
+static uint64_t repeated(const std::string& line) {
+    size_t pos = line.find("last message repeated ");
+    return pos == std::string::npos ? 0 : strtoull(line.c_str() + pos + 22, nullptr, 10);
+}
+
+static void error_loop(lch::Logger::ptr logger, int count) {
+    for (int i = 0; i < count; ++i) {
+        LCH_LOG_ERROR(logger) << "connect failed";
+    }
+}
+
+//内容变化时先输出重复次数
+static int test_change() {
+    LinesAppender::ptr lines;
+    lch::Logger::ptr logger = make_dedup("dedup.change", lines, 10000);
+    error_loop(logger, 100);
+    LCH_LOG_INFO(logger) << "recovered";
+    //同一个调用点内容不同不合并
+    for (int i = 0; i < 3; ++i) {
+        LCH_LOG_INFO(logger) << "i=" << i;
+    }
+    std::vector<std::string> all = lines->take();
+    if (all.size() != 6 || all[0].find("ERROR") != 0 || all[0].find("connect failed") == std::string::npos
+            || repeated(all[1]) != 99 || all[1].find("ERROR") != 0
+            || all[1].substr(0, all[1].find(" last")) != all[0].substr(0, all[0].find(" connect"))
+            || all[2].find("recovered") == std::string::npos || all[5].find("i=2") == std::string::npos) {
+        std::cout << "change lines " << all.size() << std::endl;
+        for (auto& i : all) {
+            std::cout << i;
+        }
+        return 1;
+    }
+    if (logger->getDedup()->getSuppressed() != 99) {
+        std::cout << "suppressed " << logger->getDedup()->getSuppressed() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//没有新日志时由后台线程按时输出，停止合并时输出剩下的
+static int test_timeout() {
+    LinesAppender::ptr lines;
+    lch::Logger::ptr logger = make_dedup("dedup.timeout", lines, 30);
+    error_loop(logger, 10);
+    std::vector<std::string> all;
+    for (int i = 0; i < 100 && all.size() < 2; ++i) {
+        usleep(10 * 1000);
+        std::vector<std::string> more = lines->take();
+        all.insert(all.end(), more.begin(), more.end());
+    }
+    if (all.size() != 2 || repeated(all[1]) != 9) {
+        std::cout << "timeout lines " << all.size() << std::endl;
+        return 1;
+    }
+    //之后的重复重新计数
+    error_loop(logger, 5);
+    logger->stopDedup();
+    all = lines->take();
+    if (all.size() != 1 || repeated(all[0]) != 5 || logger->isDedup()) {
+        std::cout << "stop lines " << all.size() << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//多个线程一直重复，按时输出的次数加上输出的条数等于总条数
+static int test_threads() {
+    LinesAppender::ptr lines;
+    lch::Logger::ptr logger = make_dedup("dedup.threads", lines, 20);
+    const int threads = 4;
+    const int count = 20000;
+    std::vector<lch::Thread::ptr> ths;
+    for (int t = 0; t < threads; ++t) {
+        ths.push_back(lch::Thread::ptr(new lch::Thread([logger]() {
+            for (int i = 0; i < count; ++i) {
+                error_loop(logger, 1);
+                if (i % 1000 == 0) {
+                    usleep(1000);
+                }
+            }
+        }, "dedup_" + std::to_string(t))));
+    }
+    for (auto& t : ths) {
+        t->join();
+    }
+    logger->stopDedup();
+    std::vector<std::string> all = lines->take();
+    uint64_t total = 0;
+    size_t summaries = 0;
+    for (auto& line : all) {
+        uint64_t n = repeated(line);
+        total += n ? n : 1;
+        summaries += n ? 1 : 0;
+    }
+    if (total != (uint64_t)threads * count || summaries < 2 || all.size() > 1000) {
+        std::cout << "threads total " << total << " lines " << all.size() << " summaries " << summaries << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    rt |= test_change();
+    rt |= test_timeout();
+    rt |= test_threads();
+
+    //相同内容、不同调用点的hash不同
+    lch::Logger::ptr logger(new lch::Logger("dedup.hash"));
+    lch::LogEvent::ptr a(new lch::LogEvent(logger, lch::LogLevel::INFO, __FILE__, 1, 0, 0, 0, 0));
+    lch::LogEvent::ptr b(new lch::LogEvent(logger, lch::LogLevel::INFO, __FILE__, 2, 0, 0, 0, 0));
+    a->getSS() << "same";
+    b->getSS() << "same";
+    if (lch::LogDeduplicator::Hash(lch::LogLevel::INFO, *a) == lch::LogDeduplicator::Hash(lch::LogLevel::INFO, *b)
+            || lch::LogDeduplicator::Hash(lch::LogLevel::INFO, *a) == lch::LogDeduplicator::Hash(lch::LogLevel::WARN, *a)) {
+        std::cout << "hash failed" << std::endl;
+        rt = 1;
+    }
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_log_dedup ok";
+    }
+    return rt;
+}
@@ -0,0 +1,131 @@
+#include "lch/lch.h"
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("index");
+
+static const uint64_t s_base = 1700000000;
+
+//每秒100条，每50条有一条ERROR，一半来自idx.a一半来自idx.b，每100条有一条带两行的
+static void write_logs(lch::FileLogAppender::ptr appender, int begin, int end) {
+    lch::Logger::ptr a(new lch::Logger("idx.a"));
+    lch::Logger::ptr b(new lch::Logger("idx.b"));
+    a->addAppender(appender);
+    b->addAppender(appender);
+    for (int i = begin; i < end; ++i) {
+        lch::Logger::ptr logger = i % 2 ? b : a;
+        lch::LogLevel::Level level = i % 50 == 0 ? lch::LogLevel::ERROR : lch::LogLevel::INFO;
+        lch::LogEvent::ptr event(new lch::LogEvent(logger, level, __FILE__, __LINE__, 0
+                    , lch::GetThreadId(), 0, s_base + i / 100, 0));
+        event->getSS() << "record " << i;
+        if (i % 100 == 1) {
+            event->getSS() << "\n  second line";
+        }
+        logger->log(level, event);
+    }
+}
+
+static uint64_t query(lch::LogIndexReader& reader, const lch::LogIndexReader::Query& q, std::vector<std::string>& out) {
+    out.clear();
+    return reader.query(q, [&out](const char* data, size_t len) {
+        out.push_back(std::string(data, len));
+    });
+}
+
+static int check(const char* name, uint64_t matched, const std::vector<std::string>& out, size_t expect) {
+    if (matched != expect || out.size() != expect) {
+        std::cout << name << " matched " << matched << " expect " << expect << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    std::string file = "/tmp/test_log_index.log";
+    unlink(file.c_str());
+    unlink(lch::LogIndex::IndexFile(file).c_str());
+    {
+        lch::FileLogAppender::ptr appender(new lch::FileLogAppender(file, 200, 16 * 1024));
+        write_logs(appender, 0, 10000);
+        //reopen后从文件末尾接着记
+        appender->reopen();
+        write_logs(appender, 10000, 12000);
+    }
+
+    int rt = 0;
+    lch::LogIndexReader reader(file);
+    std::vector<std::string> out;
+    if (!reader.isValid() || !reader.hasIndex() || reader.getBlocks() < 60) {
+        std::cout << "index blocks " << reader.getBlocks() << std::endl;
+        return 1;
+    }
+
+    //5秒500条，只扫描很小的一部分
+    lch::LogIndexReader::Query q;
+    q.start = s_base + 40;
+    q.end = s_base + 44;
+    rt |= check("range", query(reader, q, out), out, 500);
+    if (out.size() == 500 && (out[0].find("record 4000") == std::string::npos
+                || out[1].find("second line") == std::string::npos
+                || out.back().find("record 4499") == std::string::npos)) {
+        std::cout << "range first " << out[0] << " last " << out.back();
+        rt = 1;
+    }
+    if (reader.getScanned() * 10 > reader.getSize()) {
+        std::cout << "range scanned " << reader.getScanned() << " of " << reader.getSize() << std::endl;
+        rt = 1;
+    }
+
+    //reopen之后的部分
+    q.start = s_base + 110;
+    q.end = s_base + 200;
+    rt |= check("after reopen", query(reader, q, out), out, 1000);
+
+    //级别和Logger
+    q.start = s_base + 10;
+    q.end = s_base + 19;
+    q.level = lch::LogLevel::ERROR;
+    rt |= check("level", query(reader, q, out), out, 20);
+    q.level = lch::LogLevel::UNKNOW;
+    q.logger = "idx.b";
+    rt |= check("logger", query(reader, q, out), out, 500);
+    q.logger = "idx.c";
+    rt |= check("no logger", query(reader, q, out), out, 0);
+
+    //没有索引时整个文件扫描，结果一样
+    unlink(lch::LogIndex::IndexFile(file).c_str());
+    lch::LogIndexReader plain(file);
+    q.logger.clear();
+    q.start = s_base + 40;
+    q.end = s_base + 44;
+    rt |= check("no index", query(plain, q, out), out, 500);
+    if (plain.hasIndex() || plain.getScanned() != plain.getSize()) {
+        std::cout << "no index scanned " << plain.getScanned() << std::endl;
+        rt = 1;
+    }
+
+    //appender在上级Logger上，索引里记的是写日志的下级Logger
+    unlink(file.c_str());
+    {
+        lch::FileLogAppender::ptr appender(new lch::FileLogAppender(file, 20));
+        lch::Logger::ptr parent = LCH_LOG_NAME("idx_tree");
+        lch::Logger::ptr child = LCH_LOG_NAME("idx_tree.child");
+        parent->addAppender(appender);
+        for (int i = 0; i < 100; ++i) {
+            LCH_LOG_INFO(child) << "child " << i;
+        }
+        parent->clearAppender();
+    }
+    lch::LogIndexReader tree(file);
+    q = lch::LogIndexReader::Query();
+    q.logger = "idx_tree.child";
+    rt |= check("child logger", query(tree, q, out), out, 100);
+    q.logger = "idx_tree";
+    rt |= check("parent logger", query(tree, q, out), out, 0);
+
+    unlink(file.c_str());
+    unlink(lch::LogIndex::IndexFile(file).c_str());
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_log_index ok";
+    }
+    return rt;
+}
@@ -0,0 +1,85 @@
+#include "lch/lch.h"
+#include <unistd.h>
+
+//只记录条数和最后一条内容
+class CountAppender : public lch::LogAppender {
+public:
+    typedef std::shared_ptr<CountAppender> ptr;
+    void log(std::shared_ptr<lch::Logger> logger, lch::LogLevel::Level level, lch::LogEvent::ptr event) override {
+        ++count;
+        last.assign(event->getContentData(), event->getContentSize());
+    }
+    std::string toYamlString() override { return ""; }
+
+    std::atomic<int> count{0};
+    std::string last;
+};
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("limit");
+
+//同一个调用点，令牌桶状态在多次调用之间共享
+static void token_bucket(int count) {
+    for (int i = 0; i < count; ++i) {
+        LCH_LOG_RATE_LIMIT(g_logger, lch::LogLevel::ERROR, 100, 10) << "token_bucket i=" << i;
+    }
+}
+
+static int check(const char* name, int count, int expect, const std::string& last) {
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << name << " count=" << count << " last=" << last;
+    if (count != expect) {
+        std::cout << name << " expect " << expect << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    CountAppender::ptr appender(new CountAppender);
+    g_logger->addAppender(appender);
+    int rt = 0;
+
+    for (int i = 0; i < 1000; ++i) {
+        LCH_LOG_EVERY_N(g_logger, lch::LogLevel::ERROR, 100) << "every_n i=" << i;
+    }
+    rt |= check("every_n", appender->count, 10, appender->last);
+    if (appender->last != "[99 suppressed] every_n i=900") {
+        rt = 1;
+    }
+
+    appender->count = 0;
+    for (int i = 0; i < 1000; ++i) {
+        LCH_LOG_FIRST_N(g_logger, lch::LogLevel::ERROR, 5) << "first_n i=" << i;
+    }
+    rt |= check("first_n", appender->count, 5, appender->last);
+
+    appender->count = 0;
+    for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < 1000; ++j) {
+            LCH_LOG_EVERY_MS(g_logger, lch::LogLevel::ERROR, 50) << "every_ms i=" << i << " j=" << j;
+        }
+        usleep(60 * 1000);
+    }
+    rt |= check("every_ms", appender->count, 3, appender->last);
+
+    //突发10条，之后每秒100条
+    appender->count = 0;
+    token_bucket(1000);
+    int burst = appender->count;
+    usleep(100 * 1000);
+    token_bucket(1000);
+    int refill = appender->count - burst;
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "token_bucket burst=" << burst << " refill=" << refill
+        << " last=" << appender->last;
+    if (burst < 10 || burst > 11 || refill < 8 || refill > 12) {
+        rt = 1;
+    }
+
+    //级别关闭时不计数
+    g_logger->setLevel(lch::LogLevel::FATAL);
+    appender->count = 0;
+    for (int i = 0; i < 10; ++i) {
+        LCH_LOG_EVERY_N(g_logger, lch::LogLevel::ERROR, 2) << "disabled";
+    }
+    rt |= check("disabled", appender->count, 0, appender->last);
+    return rt;
+}
@@ -0,0 +1,79 @@
+#include "test_helper.h"
+#include <unistd.h>
+#include <set>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("reload.child");
+
+//两个文件appender都有自己的formatter，每次切换Logger的formatter，保证配置有变化而输出不变
+static YAML::Node make_config(int n) {
+    return YAML::Load(std::string(
+        "logs:\n"
+        "  - name: reload.child\n"
+        "    level: debug\n"
+        "    formatter: '") + (n % 2 ? "%p %m%n" : "%m%n") + "'\n"
+        "    appenders:\n"
+        "      - type: FileLogAppender\n"
+        "        file: ./reload_a.log\n"
+        "        formatter: '%m%n'\n"
+        "      - type: FileLogAppender\n"
+        "        file: ./reload_b.log\n"
+        "        formatter: '%m%n'\n");
+}
+
+//每条日志在两个文件中都恰好出现一次
+static int check_file(const char* file, size_t expect) {
+    std::vector<std::string> lines = read_lines(file);
+    std::set<std::string> uniq(lines.begin(), lines.end());
+    if (lines.size() != expect || uniq.size() != expect) {
+        std::cout << file << " lines=" << lines.size() << " unique=" << uniq.size()
+                  << " expect " << expect << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//多个线程写日志的同时反复重新加载配置，日志既不能丢失也不能交给上级
+int main(int argc, char** argv) {
+    unlink("./reload_a.log");
+    unlink("./reload_b.log");
+    LinesAppender::ptr parent = make_lines("%m%n");
+    LCH_LOG_NAME("reload")->addAppender(parent);
+    //每次重新加载root都会输出一行INFO，测试期间先关掉
+    lch::LogLevel::Level root_level = LCH_LOG_ROOT()->getLevel();
+    LCH_LOG_ROOT()->setLevel(lch::LogLevel::WARN);
+    lch::Config::LoadYamlFile(make_config(0));
+
+    const int threads = 4;
+    const int count = argc > 1 ? atoi(argv[1]) : 100000;
+    std::atomic<int> done(0);
+    std::vector<lch::Thread::ptr> ths;
+    for (int t = 0; t < threads; ++t) {
+        ths.push_back(lch::Thread::ptr(new lch::Thread([t, count, &done]() {
+            for (int i = 0; i < count; ++i) {
+                LCH_LOG_ERROR(g_logger) << t << "-" << i;
+            }
+            ++done;
+        }, "reload_" + std::to_string(t))));
+    }
+    int reloads = 1;
+    while (reloads < 20 || done < threads) {
+        lch::Config::LoadYamlFile(make_config(reloads++));
+    }
+    for (auto& t : ths) {
+        t->join();
+    }
+
+    int rt = 0;
+    rt |= check_file("./reload_a.log", threads * count);
+    rt |= check_file("./reload_b.log", threads * count);
+    rt |= check("parent", parent->getLines().size(), 0);
+    lch::Config::LoadYamlFile(YAML::Load("logs: []\n"));
+    LCH_LOG_ROOT()->setLevel(root_level);
+    if (rt == 0) {
+        unlink("./reload_a.log");
+        unlink("./reload_b.log");
+    }
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "test_log_reload " << reloads << " reloads, "
+        << (rt ? "failed" : "ok");
+    return rt;
+}
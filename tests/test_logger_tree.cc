@@ -0,0 +1,178 @@
+#include "test_helper.h"
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("tree");
+
+static bool expect(LinesAppender::ptr lines, const std::vector<std::string>& want, const char* what) {
+    std::vector<std::string> all = lines->take();
+    if (all == want) {
+        return true;
+    }
+    std::cout << what << " lines " << all.size() << std::endl;
+    for (auto& i : all) {
+        std::cout << i;
+    }
+    return false;
+}
+
+//同一个展开处只查找一次
+static const lch::Logger::ptr& cached() {
+    return LCH_LOG_CACHED("tree.cached");
+}
+
+//级别和appender从最近的上级继承，上级变化后下级跟着变
+static int test_inherit() {
+    lch::Logger::ptr server = LCH_LOG_NAME("tree.net.http.server");
+    lch::Logger::ptr net = LCH_LOG_NAME("tree.net");
+    LinesAppender::ptr lines = make_lines("%p %c %m%n");
+    net->addAppender(lines);
+    net->setLevel(lch::LogLevel::WARN);
+
+    //中间的tree.net.http在tree.net配置之后才创建
+    lch::Logger::ptr http = LCH_LOG_NAME("tree.net.http");
+    if (server->getLevel() != lch::LogLevel::WARN || http->getLevel() != lch::LogLevel::WARN
+            || server->isLevelSet() || !net->isLevelSet()) {
+        std::cout << "inherit level " << lch::LogLevel::ToString(server->getLevel()) << std::endl;
+        return 1;
+    }
+    LCH_LOG_INFO(server) << "dropped";
+    LCH_LOG_ERROR(server) << "server error";
+    LCH_LOG_WARN(http) << "http warn";
+    if (!expect(lines, {"ERROR tree.net.http.server server error\n", "WARN tree.net.http http warn\n"}, "inherit")) {
+        return 1;
+    }
+
+    //中间一级单独设置级别，输出仍然交给tree.net的appender
+    http->setLevel(lch::LogLevel::DEBUG);
+    LCH_LOG_DEBUG(server) << "debug";
+    net->setLevel(lch::LogLevel::FATAL);
+    LCH_LOG_DEBUG(server) << "still debug";
+    LCH_LOG_ERROR(net) << "dropped";
+    if (!expect(lines, {"DEBUG tree.net.http.server debug\n", "DEBUG tree.net.http.server still debug\n"}, "middle")) {
+        return 1;
+    }
+
+    //有自己的appender时不再交给上级
+    LinesAppender::ptr own = make_lines("%p %c %m%n");
+    server->addAppender(own);
+    LCH_LOG_INFO(server) << "own";
+    if (!expect(own, {"INFO tree.net.http.server own\n"}, "own") || !expect(lines, {}, "own parent")) {
+        return 1;
+    }
+    server->clearAppender();
+
+    //恢复继承后跟随root
+    http->inheritLevel();
+    net->inheritLevel();
+    net->clearAppender();
+    if (server->getLevel() != LCH_LOG_ROOT()->getLevel() || http->isLevelSet()) {
+        std::cout << "root level " << lch::LogLevel::ToString(server->getLevel()) << std::endl;
+        return 1;
+    }
+    LCH_LOG_ERROR(server) << "to root";
+    return expect(lines, {}, "root") ? 0 : 1;
+}
+
+//配置文件中的层级
+static int test_yaml() {
+    lch::Logger::ptr leaf = LCH_LOG_NAME("tree.yaml.a.b");
+    YAML::Node node = YAML::Load(
+        "logs:\n"
+        "  - name: tree.yaml\n"
+        "    level: error\n"
+        "  - name: tree.yaml.a\n"
+        "    appenders:\n"
+        "      - type: StdoutLogAppender\n");
+    lch::Config::LoadYamlFile(node);
+    lch::Logger::ptr a = LCH_LOG_NAME("tree.yaml.a");
+    if (leaf->getLevel() != lch::LogLevel::ERROR || a->getLevel() != lch::LogLevel::ERROR || a->isLevelSet()) {
+        std::cout << "yaml level " << lch::LogLevel::ToString(leaf->getLevel()) << std::endl;
+        return 1;
+    }
+    //没有变化的配置项不会把下一项的设置用到自己的Logger上
+    lch::Config::LoadYamlFile(YAML::Load(
+        "logs:\n"
+        "  - name: tree.yaml\n"
+        "    level: error\n"
+        "  - name: tree.yaml.a\n"
+        "    level: fatal\n"));
+    if (LCH_LOG_NAME("tree.yaml")->getLevel() != lch::LogLevel::ERROR || a->getLevel() != lch::LogLevel::FATAL
+            || leaf->getLevel() != lch::LogLevel::FATAL) {
+        std::cout << "yaml unchanged " << lch::LogLevel::ToString(LCH_LOG_NAME("tree.yaml")->getLevel()) << std::endl;
+        return 1;
+    }
+    //删除配置后恢复继承
+    lch::Config::LoadYamlFile(YAML::Load("logs: []\n"));
+    if (leaf->getLevel() != LCH_LOG_ROOT()->getLevel() || LCH_LOG_NAME("tree.yaml")->isLevelSet()) {
+        std::cout << "yaml removed " << lch::LogLevel::ToString(leaf->getLevel()) << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//从配置中删除的Logger不再像以前那样被禁用，级别和输出都交给最近的上级
+static int test_delete() {
+    const char* file = "./tree_del.log";
+    lch::Logger::ptr parent = LCH_LOG_NAME("tree.del");
+    LinesAppender::ptr lines = make_lines("%p %c %m%n");
+    parent->addAppender(lines);
+    lch::Config::LoadYamlFile(YAML::Load(
+        "logs:\n"
+        "  - name: tree.del.child\n"
+        "    level: fatal\n"
+        "    appenders:\n"
+        "      - type: FileLogAppender\n"
+        "        file: ./tree_del.log\n"));
+    lch::Logger::ptr child = LCH_LOG_NAME("tree.del.child");
+    LCH_LOG_ERROR(child) << "dropped";
+    LCH_LOG_FATAL(child) << "to file";
+    lch::Config::LoadYamlFile(YAML::Load("logs: []\n"));
+    LCH_LOG_ERROR(child) << "to parent";
+    parent->clearAppender();
+
+    int rt = check("delete_file", read_lines(file).size(), 1);
+    unlink(file);
+    if (!expect(lines, {"ERROR tree.del.child to parent\n"}, "delete")) {
+        rt = 1;
+    }
+    return rt;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    rt |= test_inherit();
+    rt |= test_yaml();
+    rt |= test_delete();
+
+    if (&cached() != &cached() || cached() != LCH_LOG_NAME("tree.cached")) {
+        std::cout << "cached handle failed" << std::endl;
+        rt = 1;
+    }
+
+    //多个线程同时创建同名Logger得到同一个
+    const int threads = 8;
+    std::vector<lch::Logger::ptr> got(threads);
+    std::vector<lch::Thread::ptr> ths;
+    for (int t = 0; t < threads; ++t) {
+        ths.push_back(lch::Thread::ptr(new lch::Thread([&got, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                LCH_LOG_NAME("tree.threads." + std::to_string(i));
+            }
+            got[t] = LCH_LOG_NAME("tree.threads.999");
+        }, "tree_" + std::to_string(t))));
+    }
+    for (auto& t : ths) {
+        t->join();
+    }
+    for (auto& i : got) {
+        if (i != got[0]) {
+            std::cout << "threads got different loggers" << std::endl;
+            rt = 1;
+            break;
+        }
+    }
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_logger_tree ok";
+    }
+    return rt;
+}
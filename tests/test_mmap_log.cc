@@ -0,0 +1,57 @@
+#include "lch/lch.h"
+#include <fstream>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("mmap");
+
+void producer() {
+    for (int i = 0; i < 20000; ++i) {
+        LCH_LOG_INFO(g_logger) << "mmap log " << lch::Thread::GetName() << " i=" << i;
+    }
+}
+
+//小块大小让写入频繁跨块，检查关闭后文件行数正确、没有预分配留下的空洞
+int main(int argc, char** argv) {
+    const char* file = "./mmap_log.txt";
+    unlink(file);
+    lch::MmapFileLogAppender::ptr appender(new lch::MmapFileLogAppender(file
+                , argc > 1 ? atoi(argv[1]) : 64 * 1024));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%t %m%n")));
+    g_logger->addAppender(appender);
+
+    std::vector<lch::Thread::ptr> thrs;
+    for (int i = 0; i < 4; ++i) {
+        thrs.push_back(lch::Thread::ptr(new lch::Thread(&producer, "producer_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    //reopen会截断旧文件，之后的日志追加在后面
+    appender->reopen();
+    LCH_LOG_INFO(g_logger) << "after reopen";
+    //Appender析构时截断文件，Logger里旧的appender列表要等RCU回收
+    g_logger->clearAppender();
+    appender.reset();
+    lch::Rcu::Synchronize();
+
+    std::ifstream in(file);
+    std::string line;
+    int lines = 0;
+    int rt = 0;
+    while (std::getline(in, line)) {
+        if (line.find('\0') != std::string::npos || line.find("mmap log producer_") == std::string::npos) {
+            if (line.find("after reopen") == std::string::npos) {
+                std::cout << "bad line " << lines << ": " << line << std::endl;
+                rt = 1;
+                break;
+            }
+        }
+        ++lines;
+    }
+    if (lines != 4 * 20000 + 1) {
+        std::cout << "lines=" << lines << std::endl;
+        rt = 1;
+    }
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "mmap lines=" << lines << (rt ? " failed" : " ok");
+    return rt;
+}
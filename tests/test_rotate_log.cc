@@ -0,0 +1,72 @@
+#include "lch/lch.h"
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("rotate");
+
+static std::vector<std::string> list_archives(const std::string& dir, const std::string& prefix) {
+    std::vector<std::string> rt;
+    DIR* d = opendir(dir.c_str());
+    while (d) {
+        struct dirent* e = readdir(d);
+        if (!e) {
+            break;
+        }
+        std::string name = e->d_name;
+        if (name.compare(0, prefix.size(), prefix) == 0) {
+            rt.push_back(name);
+        }
+    }
+    if (d) {
+        closedir(d);
+    }
+    return rt;
+}
+
+void producer() {
+    for (int i = 0; i < 20000; ++i) {
+        LCH_LOG_INFO(g_logger) << "rotate log " << lch::Thread::GetName() << " i=" << i;
+    }
+}
+
+//按大小切分，最多保留3个归档文件
+int main(int argc, char** argv) {
+    const std::string dir = "./rotate_test";
+    mkdir(dir.c_str(), 0755);
+    for (auto& i : list_archives(dir, "rotate.log")) {
+        unlink((dir + "/" + i).c_str());
+    }
+
+    lch::RotatingFileLogAppender::ptr appender(new lch::RotatingFileLogAppender(
+                dir + "/rotate.log", 256 * 1024, lch::RotatingFileLogAppender::DAILY, 3));
+    g_logger->addAppender(appender);
+
+    std::vector<lch::Thread::ptr> thrs;
+    for (int i = 0; i < 4; ++i) {
+        thrs.push_back(lch::Thread::ptr(new lch::Thread(&producer, "producer_" + std::to_string(i))));
+    }
+    for (auto& i : thrs) {
+        i->join();
+    }
+    appender->waitRotate();
+
+    auto files = list_archives(dir, "rotate.log.");
+    LCH_LOG_INFO(LCH_LOG_ROOT()) << "archives=" << files.size();
+    if (files.empty() || files.size() > 3) {
+        std::cout << "unexpected archive count " << files.size() << std::endl;
+        return 1;
+    }
+
+    YAML::Node root = YAML::Load("logs:\n"
+                                 "    - name: rotate_yaml\n"
+                                 "      appenders:\n"
+                                 "          - type: RotatingFileLogAppender\n"
+                                 "            file: ./rotate_test/yaml.log\n"
+                                 "            max_size: 1048576\n"
+                                 "            interval: hourly\n"
+                                 "            max_files: 24\n");
+    lch::Config::LoadYamlFile(root);
+    std::cout << LCH_LOG_NAME("rotate_yaml")->toYamlString() << std::endl;
+    return 0;
+}
@@ -0,0 +1,268 @@
+#include "test_helper.h"
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("shm");
+
+static lch::Logger::ptr make_target(LinesAppender::ptr& lines) {
+    lines = make_lines("%c|%t|%m|%K%n");
+    lch::Logger::ptr logger(new lch::Logger("collector"));
+    logger->addAppender(lines);
+    return logger;
+}
+
+static bool wait_received(lch::ShmLogCollector& collector, uint64_t count) {
+    for (int i = 0; i < 500 && collector.getReceived() < count; ++i) {
+        usleep(10 * 1000);
+    }
+    return collector.getReceived() == count;
+}
+
+//多个进程同时写，由本进程的后台线程收集
+static int test_processes() {
+    const char* name = "/lch_test_shm_log";
+    const int procs = 4;
+    const int count = 2000;
+    lch::ShmLogCollector::Unlink(name);
+    LinesAppender::ptr lines;
+    lch::ShmLogCollector collector(name, make_target(lines), 1024);
+    if (!collector.isValid()) {
+        std::cout << "collector open failed" << std::endl;
+        return 1;
+    }
+    lch::ShmLogCollector other(name, nullptr);
+    if (other.isValid()) {
+        std::cout << "second collector should fail" << std::endl;
+        return 1;
+    }
+    collector.start();
+
+    std::vector<pid_t> pids;
+    for (int p = 0; p < procs; ++p) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            lch::Logger::ptr logger(new lch::Logger("worker" + std::to_string(p)));
+            lch::ShmLogAppender::ptr appender(new lch::ShmLogAppender(name));
+            logger->addAppender(appender);
+            for (int i = 0; i < count; ++i) {
+                //队列满时等一下再写，这里要验证不丢
+                uint64_t dropped = appender->getDropped();
+                LCH_LOG_INFO(logger) << "line " << i;
+                if (appender->getDropped() != dropped) {
+                    usleep(1000);
+                    --i;
+                }
+            }
+            _exit(0);
+        }
+        pids.push_back(pid);
+    }
+    for (auto pid : pids) {
+        waitpid(pid, nullptr, 0);
+    }
+    bool ok = wait_received(collector, procs * count);
+    collector.stop();
+    std::vector<std::string> all = lines->getLines();
+
+    //每个进程的日志按顺序到达
+    std::map<std::string, int> next;
+    int rt = 0;
+    for (auto& line : all) {
+        if (line.find("shm log channel") != std::string::npos) {
+            continue;
+        }
+        size_t bar = line.find('|');
+        std::string worker = line.substr(0, bar);
+        std::string expect = "|line " + std::to_string(next[worker]++) + "|pid=";
+        if (worker.compare(0, 6, "worker") != 0 || line.find(expect) == std::string::npos) {
+            std::cout << "bad line: " << line;
+            rt = 1;
+            break;
+        }
+    }
+    if (!ok || next.size() != (size_t)procs) {
+        std::cout << "received " << collector.getReceived() << " lines " << all.size()
+                  << " workers " << next.size() << std::endl;
+        rt = 1;
+    }
+    lch::ShmLogCollector::Unlink(name);
+    return rt;
+}
+
+//队列满时丢弃，收集者输出丢弃条数
+static int test_drop() {
+    const char* name = "/lch_test_shm_log_drop";
+    lch::ShmLogCollector::Unlink(name);
+    lch::Logger::ptr logger(new lch::Logger("drop"));
+    lch::ShmLogAppender::ptr appender(new lch::ShmLogAppender(name, 16, 256));
+    logger->addAppender(appender);
+    //超过槽位大小的内容被截断
+    LCH_LOG_INFO(logger) << std::string(1000, 'x');
+    for (int i = 1; i < 100; ++i) {
+        LCH_LOG_INFO(logger) << "line " << i;
+    }
+    LinesAppender::ptr lines;
+    //以已经存在的通道为准
+    lch::ShmLogCollector collector(name, make_target(lines), 1024, 1024);
+    size_t n = collector.drain();
+    std::vector<std::string> all = lines->getLines();
+    int rt = 0;
+    if (n != 16 || appender->getDropped() != 84 || collector.getDropped() != 84 || all.size() != 17
+            || all.back().find("dropped 84 records") == std::string::npos) {
+        std::cout << "drop n=" << n << " dropped=" << appender->getDropped() << " lines=" << all.size() << std::endl;
+        rt = 1;
+    } else if (all[0].size() >= 256 || all[0].find("drop|") != 0) {
+        std::cout << "truncate: " << all[0] << std::endl;
+        rt = 1;
+    }
+    lch::ShmLogCollector::Unlink(name);
+    return rt;
+}
+
+//模拟写入者占到槽位后崩溃，按shm_log.cc中的布局直接改共享内存
+static void claim_slot(const char* name, int32_t owner) {
+    int fd = shm_open(name, O_RDWR, 0);
+    void* data = mmap(nullptr, 256 + 256 * 16, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    std::atomic<uint64_t>* enqueue = (std::atomic<uint64_t>*)((char*)data + 64);
+    uint64_t pos = enqueue->load();
+    std::atomic<int32_t>* slot_owner = (std::atomic<int32_t>*)((char*)data + 256 + (pos & 15) * 256 + 8);
+    slot_owner->store(owner);
+    enqueue->store(pos + 1);
+    munmap(data, 256 + 256 * 16);
+    close(fd);
+}
+
+//模拟卡住的写入者恢复后写完，把被跳过的槽位交给下一圈
+static void release_slot(const char* name, uint64_t pos) {
+    int fd = shm_open(name, O_RDWR, 0);
+    void* data = mmap(nullptr, 256 + 256 * 16, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    std::atomic<uint64_t>* seq = (std::atomic<uint64_t>*)((char*)data + 256 + (pos & 15) * 256);
+    uint64_t expect = pos + 15;
+    seq->compare_exchange_strong(expect, pos + 16);
+    munmap(data, 256 + 256 * 16);
+    close(fd);
+}
+
+static int test_crashed_writer() {
+    const char* name = "/lch_test_shm_log_crash";
+    lch::ShmLogCollector::Unlink(name);
+    LinesAppender::ptr lines;
+    lch::ShmLogCollector collector(name, make_target(lines), 16, 256);
+    lch::Logger::ptr logger(new lch::Logger("crash"));
+    lch::ShmLogAppender::ptr appender(new lch::ShmLogAppender(name));
+    logger->addAppender(appender);
+
+    //已经退出的进程占着槽位，立即跳过
+    pid_t pid = fork();
+    if (pid == 0) {
+        _exit(0);
+    }
+    waitpid(pid, nullptr, 0);
+    claim_slot(name, pid);
+    LCH_LOG_INFO(logger) << "after dead";
+    size_t n = collector.drain();
+    if (n != 2 || collector.getAbandoned() != 1 || collector.getReceived() != 1) {
+        std::cout << "dead writer n=" << n << " abandoned=" << collector.getAbandoned() << std::endl;
+        return 1;
+    }
+
+    //写入者还活着但一直没写完，超时后跳过
+    collector.setStallTimeout(50);
+    claim_slot(name, getpid());
+    LCH_LOG_INFO(logger) << "after stall";
+    uint64_t begin = lch::GetMonotonicNS();
+    if (collector.drain() != 0) {
+        std::cout << "stalled slot should block" << std::endl;
+        return 1;
+    }
+    while (collector.getReceived() < 2 && lch::GetMonotonicNS() - begin < 2000000000ull) {
+        collector.drain();
+        usleep(10 * 1000);
+    }
+    std::vector<std::string> all = lines->getLines();
+    int rt = 0;
+    if (collector.getReceived() != 2 || collector.getAbandoned() != 2
+            || all.size() != 4 || all[2].find("after stall") == std::string::npos) {
+        std::cout << "stalled writer received=" << collector.getReceived()
+                  << " abandoned=" << collector.getAbandoned() << " lines=" << all.size() << std::endl;
+        rt = 1;
+    }
+
+    //跳过的槽位在卡住的写入者结束前不给下一圈使用，这一圈写到那里时当作队列满
+    for (int i = 0; i < 14; ++i) {
+        LCH_LOG_INFO(logger) << "lap " << i;
+    }
+    uint64_t dropped = appender->getDropped();
+    LCH_LOG_INFO(logger) << "blocked";
+    if (collector.drain() != 14 || appender->getDropped() != dropped + 1) {
+        std::cout << "abandoned slot reused, dropped=" << appender->getDropped() << std::endl;
+        rt = 1;
+    }
+    release_slot(name, 2);
+    LCH_LOG_INFO(logger) << "after release";
+    if (collector.drain() != 1 || collector.getReceived() != 17
+            || lines->getLines().back().find("after release") == std::string::npos) {
+        std::cout << "released slot received=" << collector.getReceived() << std::endl;
+        rt = 1;
+    }
+    lch::ShmLogCollector::Unlink(name);
+    return rt;
+}
+
+//写入者占到槽位后、记下owner之前就崩溃了，跳过的槽位超时后也要收回
+static int test_lost_owner() {
+    const char* name = "/lch_test_shm_log_lost";
+    lch::ShmLogCollector::Unlink(name);
+    LinesAppender::ptr lines;
+    lch::ShmLogCollector collector(name, make_target(lines), 16, 256);
+    collector.setStallTimeout(50);
+    lch::Logger::ptr logger(new lch::Logger("lost"));
+    lch::ShmLogAppender::ptr appender(new lch::ShmLogAppender(name));
+    logger->addAppender(appender);
+
+    claim_slot(name, 0);
+    LCH_LOG_INFO(logger) << "first";
+    uint64_t begin = lch::GetMonotonicNS();
+    while (collector.getReceived() < 1 && lch::GetMonotonicNS() - begin < 2000000000ull) {
+        collector.drain();
+        usleep(10 * 1000);
+    }
+    for (int i = 0; i < 14; ++i) {
+        LCH_LOG_INFO(logger) << "lap " << i;
+    }
+    collector.drain();
+
+    //下一圈写到跳过的槽位时先当作队列满，超时后恢复
+    uint64_t dropped = appender->getDropped();
+    LCH_LOG_INFO(logger) << "blocked";
+    collector.drain();
+    usleep(100 * 1000);
+    collector.drain();
+    LCH_LOG_INFO(logger) << "after timeout";
+    collector.drain();
+    int rt = 0;
+    if (appender->getDropped() != dropped + 1 || collector.getReceived() != 16
+            || collector.getAbandoned() != 1
+            || lines->getLines().back().find("after timeout") == std::string::npos) {
+        std::cout << "lost owner received=" << collector.getReceived()
+                  << " abandoned=" << collector.getAbandoned()
+                  << " dropped=" << appender->getDropped() << std::endl;
+        rt = 1;
+    }
+    lch::ShmLogCollector::Unlink(name);
+    return rt;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    rt |= test_processes();
+    rt |= test_drop();
+    rt |= test_crashed_writer();
+    rt |= test_lost_owner();
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_shm_log ok";
+    }
+    return rt;
+}
@@ -0,0 +1,249 @@
+#include "lch/lch.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <stddef.h>
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("socket");
+
+static int bind_unix(const std::string& path, int type) {
+    unlink(path.c_str());
+    int fd = socket(AF_UNIX, type | SOCK_CLOEXEC, 0);
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (bind(fd, (struct sockaddr*)&addr, offsetof(struct sockaddr_un, sun_path) + path.size() + 1)) {
+        std::cout << "bind " << path << " failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return -1;
+    }
+    if (type == SOCK_STREAM) {
+        listen(fd, 4);
+    }
+    return fd;
+}
+
+//收数据报直到超时没有新的数据
+static std::vector<std::string> recv_datagrams(int fd) {
+    std::vector<std::string> out;
+    char buf[65536];
+    while (true) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 500) <= 0) {
+            break;
+        }
+        ssize_t n = recv(fd, buf, sizeof(buf), 0);
+        if (n < 0) {
+            break;
+        }
+        out.push_back(std::string(buf, n));
+    }
+    return out;
+}
+
+static void log_lines(lch::Logger::ptr logger, int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+        LCH_LOG_INFO(logger) << "line " << i;
+    }
+}
+
+//unix数据报 + syslog格式
+static int test_unix_dgram() {
+    std::string path = "/tmp/test_socket_log.dgram";
+    int fd = bind_unix(path, SOCK_DGRAM);
+    if (fd < 0) {
+        return 1;
+    }
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    lch::Logger::ptr logger(new lch::Logger("socket.dgram"));
+    lch::SocketLogAppender::ptr appender(new lch::SocketLogAppender("unix://" + path));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    log_lines(logger, 0, 100);
+    //unix数据报的接收队列很短(max_dgram_qlen)，要边收边等
+    std::vector<std::string> msgs = recv_datagrams(fd);
+    bool flushed = appender->flush(3000);
+    close(fd);
+    unlink(path.c_str());
+
+    int rt = 0;
+    if (!flushed || msgs.size() != 100 || appender->getSent() != 100) {
+        std::cout << "dgram flushed=" << flushed << " received=" << msgs.size()
+                  << " sent=" << appender->getSent() << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        const std::string& msg = msgs[i];
+        std::string tail = " socket.dgram - line " + std::to_string(i);
+        if (msg.compare(0, 6, "<14>1 ") != 0 || msg.size() < tail.size()
+                || msg.compare(msg.size() - tail.size(), tail.size(), tail) != 0) {
+            std::cout << "dgram bad message: " << msg << std::endl;
+            rt = 1;
+            break;
+        }
+    }
+    return rt;
+}
+
+//从流式连接里按4字节长度拆出count条
+static std::vector<std::string> recv_length_frames(int conn, size_t count) {
+    std::vector<std::string> out;
+    std::string buf;
+    char tmp[4096];
+    while (out.size() < count) {
+        struct pollfd pfd = {conn, POLLIN, 0};
+        if (poll(&pfd, 1, 3000) <= 0) {
+            break;
+        }
+        ssize_t n = read(conn, tmp, sizeof(tmp));
+        if (n <= 0) {
+            break;
+        }
+        buf.append(tmp, n);
+        while (buf.size() >= 4) {
+            const unsigned char* p = (const unsigned char*)buf.data();
+            size_t len = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+            if (buf.size() < 4 + len) {
+                break;
+            }
+            out.push_back(buf.substr(4, len));
+            buf.erase(0, 4 + len);
+        }
+    }
+    return out;
+}
+
+//unix流 + 长度前缀，收集端后启动，验证重连
+static int test_unix_stream() {
+    std::string path = "/tmp/test_socket_log.stream";
+    unlink(path.c_str());
+    lch::Logger::ptr logger(new lch::Logger("socket.stream"));
+    lch::SocketLogAppender::ptr appender(new lch::SocketLogAppender("unix-stream://" + path
+                , lch::SocketLogAppender::LENGTH));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+
+    //此时还没有人监听，日志留在缓冲区里
+    log_lines(logger, 0, 50);
+    if (appender->flush(100) || appender->isConnected()) {
+        std::cout << "stream should not be connected" << std::endl;
+        return 1;
+    }
+    int fd = bind_unix(path, SOCK_STREAM);
+    if (fd < 0) {
+        return 1;
+    }
+    log_lines(logger, 50, 100);
+    struct pollfd pfd = {fd, POLLIN, 0};
+    if (poll(&pfd, 1, 5000) <= 0) {
+        std::cout << "stream no connection" << std::endl;
+        close(fd);
+        return 1;
+    }
+    int conn = accept(fd, nullptr, nullptr);
+    std::vector<std::string> msgs = recv_length_frames(conn, 100);
+    bool flushed = appender->flush(3000);
+    close(conn);
+    close(fd);
+    unlink(path.c_str());
+
+    if (!flushed || msgs.size() != 100) {
+        std::cout << "stream flushed=" << flushed << " received=" << msgs.size() << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        if (msgs[i] != "line " + std::to_string(i)) {
+            std::cout << "stream bad message " << i << ": " << msgs[i] << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//没有收集端时缓冲区满了要丢弃并计数，不能阻塞调用者
+static int test_drop() {
+    std::string path = "/tmp/test_socket_log.none";
+    unlink(path.c_str());
+    lch::Logger::ptr logger(new lch::Logger("socket.drop"));
+    lch::SocketLogAppender::ptr appender(new lch::SocketLogAppender("unix://" + path
+                , lch::SocketLogAppender::LENGTH, 1024, lch::AsyncLogDispatcher::DROP_NEWEST));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    uint64_t begin = lch::GetMonotonicNS();
+    log_lines(logger, 0, 1000);
+    uint64_t ms = (lch::GetMonotonicNS() - begin) / 1000000;
+    //"line N"加4字节长度不超过14字节，1024字节至少放得下73条
+    uint64_t dropped = appender->getDropped();
+    if (dropped < 900 || dropped > 1000 - 73 || ms > 1000) {
+        std::cout << "drop dropped=" << dropped << " ms=" << ms << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+//UDP发到本机的临时端口
+static int test_udp() {
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    if (bind(fd, (struct sockaddr*)&addr, len) || getsockname(fd, (struct sockaddr*)&addr, &len)) {
+        std::cout << "udp bind failed: " << strerror(errno) << std::endl;
+        close(fd);
+        return 1;
+    }
+    std::string address = "udp://127.0.0.1:" + std::to_string(ntohs(addr.sin_port));
+    lch::Logger::ptr logger(new lch::Logger("socket.udp"));
+    lch::SocketLogAppender::ptr appender(new lch::SocketLogAppender(address
+                , lch::SocketLogAppender::LENGTH));
+    appender->setFormatter(lch::LogFormatter::ptr(new lch::LogFormatter("%m%n")));
+    logger->addAppender(appender);
+    log_lines(logger, 0, 20);
+    std::vector<std::string> msgs = recv_datagrams(fd);
+    bool flushed = appender->flush(3000);
+    close(fd);
+    if (!flushed || msgs.size() != 20) {
+        std::cout << "udp flushed=" << flushed << " received=" << msgs.size() << std::endl;
+        return 1;
+    }
+    for (size_t i = 0; i < msgs.size(); ++i) {
+        std::string expect = "line " + std::to_string(i);
+        if (msgs[i].size() != expect.size() + 4 || msgs[i].substr(4) != expect) {
+            std::cout << "udp bad message " << i << ": " << msgs[i].substr(4) << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    rt |= test_unix_dgram();
+    rt |= test_unix_stream();
+    rt |= test_drop();
+    rt |= test_udp();
+
+    lch::SocketLogAppender::ptr invalid(new lch::SocketLogAppender("tcp://127.0.0.1:514"));
+    if (invalid->isValid()) {
+        std::cout << "tcp address should be invalid" << std::endl;
+        rt = 1;
+    }
+    if (lch::SocketLogAppender::FromString("length") != lch::SocketLogAppender::LENGTH
+            || std::string(lch::SocketLogAppender::ToString(lch::SocketLogAppender::SYSLOG)) != "syslog") {
+        std::cout << "framing string failed" << std::endl;
+        rt = 1;
+    }
+
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_socket_log ok";
+    }
+    return rt;
+}
@@ -0,0 +1,126 @@
+#include "test_helper.h"
+#include <unistd.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_NAME("uring");
+
+//多个线程写，缓冲区很小，反复用完所有缓冲区
+static int test_threads() {
+    std::string file = "/tmp/test_uring_log.log";
+    unlink(file.c_str());
+    const int threads = 4;
+    const int count = 20000;
+    uint64_t submits = 0;
+    {
+        lch::UringFileLogAppender::ptr appender(new lch::UringFileLogAppender(file
+                    , lch::UringFileLogAppender::NONE, 1000, 4096, 4));
+        lch::Logger::ptr logger = make_logger("uring.threads", appender);
+        std::cout << "io_uring: " << appender->isUring() << std::endl;
+        std::vector<lch::Thread::ptr> ths;
+        for (int t = 0; t < threads; ++t) {
+            ths.push_back(lch::Thread::ptr(new lch::Thread([logger]() {
+                for (int i = 0; i < count; ++i) {
+                    LCH_LOG_INFO(logger) << "line " << i;
+                }
+            }, "uring_" + std::to_string(t))));
+        }
+        for (auto& t : ths) {
+            t->join();
+        }
+        submits = appender->getSubmits();
+    }
+    //每个线程的日志按顺序写出
+    std::vector<std::string> lines = read_lines(file);
+    std::map<std::string, int> next;
+    for (auto& line : lines) {
+        size_t sp = line.find(' ');
+        std::string tid = line.substr(0, sp);
+        if (line.substr(sp + 1) != "line " + std::to_string(next[tid]++)) {
+            std::cout << "bad line: " << line << std::endl;
+            return 1;
+        }
+    }
+    if (lines.size() != (size_t)threads * count || next.size() != (size_t)threads) {
+        std::cout << "lines " << lines.size() << " threads " << next.size() << std::endl;
+        return 1;
+    }
+    //每次提交都写出多个缓冲区，调用次数远少于日志条数
+    if (submits == 0 || submits > lines.size() / 10) {
+        std::cout << "submits " << submits << std::endl;
+        return 1;
+    }
+    unlink(file.c_str());
+    return 0;
+}
+
+//没写满的缓冲区按flush_interval写出，flush(true)同步
+static int test_flush_sync() {
+    std::string file = "/tmp/test_uring_log_sync.log";
+    unlink(file.c_str());
+    lch::UringFileLogAppender::ptr appender(new lch::UringFileLogAppender(file
+                , lch::UringFileLogAppender::FDATASYNC, 0, 64 * 1024, 4, 20));
+    lch::Logger::ptr logger = make_logger("uring.sync", appender);
+    LCH_LOG_INFO(logger) << "timed";
+    std::vector<std::string> lines;
+    for (int i = 0; i < 100 && lines.empty(); ++i) {
+        usleep(10 * 1000);
+        lines = read_lines(file);
+    }
+    //等这一批的同步完成
+    appender->flush();
+    if (lines.size() != 1 || appender->getSyncs() == 0) {
+        std::cout << "timed flush lines " << lines.size() << " syncs " << appender->getSyncs() << std::endl;
+        return 1;
+    }
+    uint64_t syncs = appender->getSyncs();
+    LCH_LOG_INFO(logger) << "flushed";
+    appender->flush(true);
+    lines = read_lines(file);
+    if (lines.size() != 2 || appender->getSyncs() <= syncs) {
+        std::cout << "flush lines " << lines.size() << " syncs " << appender->getSyncs() << std::endl;
+        return 1;
+    }
+
+    //比缓冲区大的日志整条写出
+    LCH_LOG_INFO(logger) << std::string(100000, 'b');
+    appender->flush();
+    lines = read_lines(file);
+    if (lines.size() != 3 || lines[2].size() < 100000 || lines[2].find(std::string(100000, 'b')) == std::string::npos) {
+        std::cout << "big line lines " << lines.size() << std::endl;
+        return 1;
+    }
+
+    //改名后reopen，之后的日志写进新文件
+    std::string moved = file + ".1";
+    rename(file.c_str(), moved.c_str());
+    if (!appender->reopen()) {
+        std::cout << "reopen failed" << std::endl;
+        return 1;
+    }
+    LCH_LOG_INFO(logger) << "reopened";
+    appender->flush();
+    lines = read_lines(file);
+    std::vector<std::string> old_lines = read_lines(moved);
+    if (lines.size() != 1 || lines[0].find("reopened") == std::string::npos || old_lines.size() != 3) {
+        std::cout << "reopen lines " << lines.size() << " old " << old_lines.size() << std::endl;
+        return 1;
+    }
+    unlink(file.c_str());
+    unlink(moved.c_str());
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    rt |= test_threads();
+    rt |= test_flush_sync();
+
+    if (lch::UringFileLogAppender::FromString("fdatasync") != lch::UringFileLogAppender::FDATASYNC
+            || std::string(lch::UringFileLogAppender::ToString(lch::UringFileLogAppender::FSYNC)) != "fsync") {
+        std::cout << "sync policy string failed" << std::endl;
+        rt = 1;
+    }
+    if (rt == 0) {
+        LCH_LOG_INFO(g_logger) << "test_uring_log ok";
+    }
+    return rt;
+}
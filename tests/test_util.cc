@@ -0,0 +1,58 @@
+#include "lch/lch.h"
+#include <chrono>
+#include <signal.h>
+#include <sys/wait.h>
+
+lch::Logger::ptr g_logger = LCH_LOG_ROOT();
+
+//不能是static，否则动态符号表里没有名字
+void test_backtrace_inner(std::vector<std::string>& bt) {
+    lch::Backtrace(bt, 16);
+}
+
+int main(int argc, char** argv) {
+    int rt = 0;
+    std::vector<std::string> bt;
+    test_backtrace_inner(bt);
+    LCH_LOG_INFO(g_logger) << "backtrace:\n" << lch::BacktraceToString(16, 2, "    ");
+    if (bt.empty() || bt[0].find("test_backtrace_inner") == std::string::npos) {
+        std::cout << "first frame mismatch: " << (bt.empty() ? "" : bt[0]) << std::endl;
+        rt = 1;
+    }
+
+    void* frames[16];
+    int n = lch::BacktraceRaw(frames, 16);
+    if (n <= 0 || lch::Symbolize(frames[0]) != lch::Symbolize(frames[0])) {
+        std::cout << "raw backtrace failed n=" << n << std::endl;
+        rt = 1;
+    }
+
+    //地址已经解析过，之后只查缓存
+    const int count = 10000;
+    auto begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        lch::BacktraceToString(16);
+    }
+    auto end = std::chrono::steady_clock::now();
+    LCH_LOG_INFO(g_logger) << "BacktraceToString "
+        << std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count() / count << "ns";
+
+    LCH_ASSERT(n > 0);
+    LCH_ASSERT2(rt == 0, "rt=" << rt);
+
+#ifndef NDEBUG
+    pid_t pid = fork();
+    if (pid == 0) {
+        LCH_ASSERT2(n == 0, "expected failure");
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFSIGNALED(status) || WTERMSIG(status) != SIGABRT) {
+        std::cout << "assert did not abort, status=" << status << std::endl;
+        rt = 1;
+    }
+#endif
+    std::cout << (rt ? "test_util failed" : "test_util ok") << std::endl;
+    return rt;
+}
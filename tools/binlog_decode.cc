@@ -0,0 +1,36 @@
+#include "lch/lch.h"
+#include <fstream>
+
+//把二进制日志还原成文本
+//用法: binlog_decode <file> [pattern]
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <file> [pattern]" << std::endl;
+        return 1;
+    }
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+        std::cerr << "open " << argv[1] << " failed" << std::endl;
+        return 1;
+    }
+    lch::LogFormatter formatter(argc > 2 ? argv[2]
+            : "%d{%Y-%m-%d %H:%M:%S}%T%t%T%F%T[%p]%T[%c]%T%f:%l%T%m%n");
+    if (formatter.isError()) {
+        std::cerr << "invalid pattern: " << argv[2] << std::endl;
+        return 1;
+    }
+
+    lch::BinLogReader reader(in);
+    lch::LogEvent::ptr event;
+    std::string buf;
+    while (reader.next(event)) {
+        buf.clear();
+        formatter.format(buf, event->getLogger(), event->getLevel(), event);
+        std::cout.write(buf.data(), buf.size());
+    }
+    if (reader.isError()) {
+        std::cerr << argv[1] << ": corrupted record" << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,277 @@
+#include "lch/lch.h"
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+
+//接收SocketLogAppender发来的日志，每条一行写到标准输出或文件
+//用法: log_collector [-f syslog|length] [-o 输出文件] [-n 收到多少条后退出] [-d 每条延迟微秒] <address>
+//address与SocketLogAppender相同: udp://host:port、unix:///path、unix-stream:///path
+//-d用来模拟处理慢的收集端；退出时把收到的条数和耗时输出到stderr
+
+static volatile sig_atomic_t s_stop = 0;
+
+static void on_signal(int) {
+    s_stop = 1;
+}
+
+struct Options {
+    lch::SocketLogAppender::Framing framing = lch::SocketLogAppender::SYSLOG;
+    uint64_t limit = 0;
+    uint32_t delay = 0;
+    int out = STDOUT_FILENO;
+};
+
+static int open_socket(const std::string& address, bool& stream) {
+    struct sockaddr_storage addr;
+    socklen_t len = 0;
+    int family = AF_UNIX;
+    memset(&addr, 0, sizeof(addr));
+    stream = false;
+    std::string path;
+    if (address.compare(0, 7, "unix://") == 0) {
+        path = address.substr(7);
+    } else if (address.compare(0, 14, "unix-stream://") == 0) {
+        path = address.substr(14);
+        stream = true;
+    } else if (address.compare(0, 6, "udp://") == 0) {
+        std::string hostport = address.substr(6);
+        size_t pos = hostport.rfind(':');
+        if (pos == std::string::npos) {
+            return -1;
+        }
+        std::string host = hostport.substr(0, pos);
+        if (host.size() > 2 && host.front() == '[' && host.back() == ']') {
+            host = host.substr(1, host.size() - 2);
+        }
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_DGRAM;
+        hints.ai_flags = AI_PASSIVE;
+        struct addrinfo* res = nullptr;
+        if (getaddrinfo(host.c_str(), hostport.substr(pos + 1).c_str(), &hints, &res) || !res) {
+            return -1;
+        }
+        memcpy(&addr, res->ai_addr, res->ai_addrlen);
+        len = res->ai_addrlen;
+        family = res->ai_family;
+        freeaddrinfo(res);
+    } else {
+        return -1;
+    }
+    if (family == AF_UNIX) {
+        struct sockaddr_un* un = (struct sockaddr_un*)&addr;
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            return -1;
+        }
+        un->sun_family = AF_UNIX;
+        memcpy(un->sun_path, path.c_str(), path.size());
+        len = offsetof(struct sockaddr_un, sun_path) + path.size() + 1;
+        unlink(path.c_str());
+    }
+    int fd = socket(family, (stream ? SOCK_STREAM : SOCK_DGRAM) | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (bind(fd, (struct sockaddr*)&addr, len) || (stream && listen(fd, 16))) {
+        close(fd);
+        return -1;
+    }
+    //大一点的接收缓冲区，减少突发时的丢包
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    return fd;
+}
+
+class Collector {
+public:
+    Collector(const Options& opt) : m_opt(opt) {}
+
+    //处理一条记录，到达-n的条数时返回false
+    bool record(const char* data, size_t len) {
+        m_out.append(data, len);
+        m_out.push_back('\n');
+        if (m_out.size() >= 64 * 1024) {
+            flush();
+        }
+        if (m_opt.delay) {
+            usleep(m_opt.delay);
+        }
+        ++m_count;
+        return !m_opt.limit || m_count < m_opt.limit;
+    }
+
+    //解析流式连接上收到的数据，剩下不完整的部分留在buf里
+    bool parse(std::string& buf) {
+        size_t pos = 0;
+        bool more = true;
+        while (more) {
+            size_t len = 0;
+            size_t head = 0;
+            if (m_opt.framing == lch::SocketLogAppender::LENGTH) {
+                if (buf.size() - pos < 4) {
+                    break;
+                }
+                const unsigned char* p = (const unsigned char*)buf.data() + pos;
+                len = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+                head = 4;
+            } else {
+                size_t sp = buf.find(' ', pos);
+                if (sp == std::string::npos) {
+                    break;
+                }
+                len = strtoul(buf.c_str() + pos, nullptr, 10);
+                head = sp + 1 - pos;
+            }
+            if (buf.size() - pos - head < len) {
+                break;
+            }
+            more = record(buf.data() + pos + head, len);
+            pos += head + len;
+        }
+        buf.erase(0, pos);
+        return more;
+    }
+
+    void flush() {
+        size_t off = 0;
+        while (off < m_out.size()) {
+            ssize_t n = write(m_opt.out, m_out.data() + off, m_out.size() - off);
+            if (n <= 0) {
+                break;
+            }
+            off += n;
+        }
+        m_out.clear();
+    }
+
+    uint64_t getCount() const { return m_count; }
+private:
+    Options m_opt;
+    std::string m_out;
+    uint64_t m_count = 0;
+};
+
+static void run_datagram(int fd, Collector& collector, const Options& opt) {
+    const int batch = 64;
+    const size_t size = 64 * 1024;
+    std::vector<char> bufs(batch * size);
+    struct mmsghdr msgs[batch];
+    struct iovec iovs[batch];
+    while (!s_stop) {
+        struct pollfd pfd = {fd, POLLIN, 0};
+        if (poll(&pfd, 1, 100) <= 0) {
+            collector.flush();
+            continue;
+        }
+        memset(msgs, 0, sizeof(msgs));
+        for (int i = 0; i < batch; ++i) {
+            iovs[i].iov_base = &bufs[i * size];
+            iovs[i].iov_len = size;
+            msgs[i].msg_hdr.msg_iov = &iovs[i];
+            msgs[i].msg_hdr.msg_iovlen = 1;
+        }
+        int n = recvmmsg(fd, msgs, batch, MSG_DONTWAIT, nullptr);
+        for (int i = 0; i < n; ++i) {
+            const char* data = &bufs[i * size];
+            size_t len = msgs[i].msg_len;
+            if (opt.framing == lch::SocketLogAppender::LENGTH && len >= 4) {
+                data += 4;
+                len -= 4;
+            }
+            if (!collector.record(data, len)) {
+                return;
+            }
+        }
+    }
+}
+
+static void run_stream(int fd, Collector& collector) {
+    std::vector<struct pollfd> pfds;
+    std::vector<std::string> bufs;
+    pfds.push_back({fd, POLLIN, 0});
+    bufs.push_back("");
+    char tmp[64 * 1024];
+    while (!s_stop) {
+        if (poll(&pfds[0], pfds.size(), 100) <= 0) {
+            collector.flush();
+            continue;
+        }
+        if (pfds[0].revents & POLLIN) {
+            int c = accept4(fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (c >= 0) {
+                pfds.push_back({c, POLLIN, 0});
+                bufs.push_back("");
+            }
+        }
+        for (size_t i = 1; i < pfds.size(); ++i) {
+            if (!(pfds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                continue;
+            }
+            ssize_t n = read(pfds[i].fd, tmp, sizeof(tmp));
+            if (n <= 0) {
+                close(pfds[i].fd);
+                pfds.erase(pfds.begin() + i);
+                bufs.erase(bufs.begin() + i);
+                --i;
+                continue;
+            }
+            bufs[i].append(tmp, n);
+            if (!collector.parse(bufs[i])) {
+                return;
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "f:o:n:d:")) != -1) {
+        switch (c) {
+            case 'f': opt.framing = lch::SocketLogAppender::FromString(optarg); break;
+            case 'o':
+                opt.out = open(optarg, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+                if (opt.out < 0) {
+                    std::cerr << "open " << optarg << " failed: " << strerror(errno) << std::endl;
+                    return 1;
+                }
+                break;
+            case 'n': opt.limit = strtoull(optarg, nullptr, 10); break;
+            case 'd': opt.delay = atoi(optarg); break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1) {
+        std::cerr << "usage: " << argv[0]
+                  << " [-f syslog|length] [-o file] [-n count] [-d delay_us] <address>" << std::endl;
+        return 1;
+    }
+    bool stream = false;
+    int fd = open_socket(argv[optind], stream);
+    if (fd < 0) {
+        std::cerr << "listen " << argv[optind] << " failed: " << strerror(errno) << std::endl;
+        return 1;
+    }
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    Collector collector(opt);
+    uint64_t begin = lch::GetMonotonicNS();
+    if (stream) {
+        run_stream(fd, collector);
+    } else {
+        run_datagram(fd, collector, opt);
+    }
+    collector.flush();
+    uint64_t ms = (lch::GetMonotonicNS() - begin) / 1000000;
+    std::cerr << "received " << collector.getCount() << " records in " << ms << "ms" << std::endl;
+    close(fd);
+    return 0;
+}
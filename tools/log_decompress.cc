@@ -0,0 +1,80 @@
+#include "lch/lch.h"
+#include <unistd.h>
+
+//把CompressedFileLogAppender写的分块压缩日志还原成文本
+//用法: log_decompress [-s 开始时间] [-e 结束时间] [-l] [-v] <file>
+//-s/-e为秒级时间戳，按块头中的时间跳过整块(块内不再过滤)；-l只列出块不解压
+//损坏的块跳过，文件末尾没写完的块忽略，都会在stderr提示
+int main(int argc, char** argv) {
+    uint64_t start = 0;
+    uint64_t end = UINT64_MAX;
+    bool list = false;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:e:lv")) != -1) {
+        switch (opt) {
+            case 's':
+                start = strtoull(optarg, nullptr, 10) * 1000000;
+                break;
+            case 'e':
+                end = (strtoull(optarg, nullptr, 10) + 1) * 1000000 - 1;
+                break;
+            case 'l':
+                list = true;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1) {
+        std::cerr << "usage: " << argv[0] << " [-s start] [-e end] [-l] [-v] <file>" << std::endl;
+        return 1;
+    }
+    lch::CompressedLogReader reader(argv[optind]);
+    if (!reader.isValid()) {
+        std::cerr << "open " << argv[optind] << " failed" << std::endl;
+        return 1;
+    }
+
+    lch::CompressedLogBlock block;
+    uint64_t offset = 0;
+    uint64_t blocks = 0;
+    uint64_t records = 0;
+    uint64_t failed = 0;
+    std::string buf;
+    while (reader.next(block, offset)) {
+        if (block.maxTime < start || block.minTime > end) {
+            continue;
+        }
+        ++blocks;
+        records += block.count;
+        if (list) {
+            std::cout << offset << "\t" << lch::CompressedLog::ToString((lch::CompressedLog::Codec)block.codec)
+                      << "\t" << block.count << "\t" << block.rawSize << "\t" << block.size
+                      << "\t" << block.minTime / 1000000 << "\t" << block.maxTime / 1000000 << std::endl;
+            continue;
+        }
+        buf.clear();
+        if (!reader.read(buf)) {
+            std::cerr << argv[optind] << ": block at " << offset << " cannot be decompressed" << std::endl;
+            ++failed;
+            continue;
+        }
+        std::cout.write(buf.data(), buf.size());
+    }
+    std::cout.flush();
+    if (reader.getSkipped()) {
+        std::cerr << argv[optind] << ": skipped " << reader.getSkipped() << " corrupted bytes" << std::endl;
+    }
+    if (reader.isTruncated()) {
+        std::cerr << argv[optind] << ": last block is incomplete" << std::endl;
+    }
+    if (verbose) {
+        std::cerr << "blocks " << blocks << ", records " << records << std::endl;
+    }
+    return failed ? 1 : 0;
+}
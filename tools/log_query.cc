@@ -0,0 +1,98 @@
+#include "lch/lch.h"
+#include <unistd.h>
+
+//按时间范围从FileLogAppender写的日志文件中取日志，有.idx索引时只扫描时间对得上的块
+//用法: log_query [-s 开始时间] [-e 结束时间] [-l 最低级别] [-c logger] [-t 时间格式] [-v] <file>
+//时间可以是time_format格式的本地时间(默认"%Y-%m-%d %H:%M:%S")或者秒级时间戳，都包含在范围内
+//-v把匹配条数、扫描字节数输出到stderr
+
+static bool parse_time(const char* str, const std::string& format, uint64_t& t) {
+    char* end = nullptr;
+    unsigned long long v = strtoull(str, &end, 10);
+    if (*str && end && !*end) {
+        t = v;
+        return true;
+    }
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    const char* p = strptime(str, format.c_str(), &tm);
+    if (!p || *p) {
+        return false;
+    }
+    tm.tm_isdst = -1;
+    time_t r = mktime(&tm);
+    if (r < 0) {
+        return false;
+    }
+    t = r;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    lch::LogIndexReader::Query q;
+    const char* start = nullptr;
+    const char* end = nullptr;
+    bool verbose = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "s:e:l:c:t:v")) != -1) {
+        switch (opt) {
+            case 's':
+                start = optarg;
+                break;
+            case 'e':
+                end = optarg;
+                break;
+            case 'l':
+                q.level = lch::LogLevel::FromString(optarg);
+                if (q.level == lch::LogLevel::UNKNOW) {
+                    std::cerr << "invalid level: " << optarg << std::endl;
+                    return 1;
+                }
+                break;
+            case 'c':
+                q.logger = optarg;
+                break;
+            case 't':
+                q.timeFormat = optarg;
+                break;
+            case 'v':
+                verbose = true;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != argc - 1) {
+        std::cerr << "usage: " << argv[0] << " [-s start] [-e end] [-l level] [-c logger]"
+                  << " [-t time_format] [-v] <file>" << std::endl;
+        return 1;
+    }
+    if ((start && !parse_time(start, q.timeFormat, q.start))
+            || (end && !parse_time(end, q.timeFormat, q.end))) {
+        std::cerr << "invalid time: " << (start ? start : "") << " " << (end ? end : "") << std::endl;
+        return 1;
+    }
+
+    lch::LogIndexReader reader(argv[optind]);
+    if (!reader.isValid()) {
+        std::cerr << "open " << argv[optind] << " failed" << std::endl;
+        return 1;
+    }
+    //输出量大时攒一批再写
+    std::string buf;
+    uint64_t matched = reader.query(q, [&buf](const char* data, size_t len) {
+        buf.append(data, len);
+        if (buf.size() >= 64 * 1024) {
+            std::cout.write(buf.data(), buf.size());
+            buf.clear();
+        }
+    });
+    std::cout.write(buf.data(), buf.size());
+    std::cout.flush();
+    if (verbose) {
+        std::cerr << "matched " << matched << " records, scanned " << reader.getScanned()
+                  << " of " << reader.getSize() << " bytes, index blocks " << reader.getBlocks() << std::endl;
+    }
+    return 0;
+}